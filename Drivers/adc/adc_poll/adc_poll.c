@@ -1,6 +1,7 @@
 #include "adc_poll.h"
 
-#define ADC_DMA_CH 1u /* F070: ADC usa DMA1 Channel 1 */
+/* F070: ADC usa DMA1 Channel 1 (ou Channel 2 com SYSCFG remap, se o 1 tiver dono) */
+#define ADC_DMA_OWNER ((const void*)ADC1)
 
 #ifndef ADC_BM_TIMEOUT
 #define ADC_BM_TIMEOUT  (2000000u)
@@ -21,6 +22,13 @@ static uint8_t        s_seq_idx = 0;
 /* DMA */
 static adc_bm_dma_cb_t s_dma_cb  = NULL;
 static void           *s_dma_ctx = NULL;
+static uint8_t         s_dma_ch  = 0;    /* canal reservado no dma_router (0 = nenhum) */
+
+static bool adc_dma_claim(void){
+  dma_router_init(/*prio*/1);
+  if (!s_dma_ch) s_dma_ch = dma_router_claim_req(DMA_REQ_ADC, ADC_DMA_OWNER);
+  return s_dma_ch != 0;
+}
 
 /* ===== Utils ===== */
 static inline uint8_t popcount32(uint32_t x){
@@ -235,9 +243,9 @@ bool adc_bm_dma_start_oneshot(uint16_t *dst, uint16_t count,
 
   s_dma_cb = cb; s_dma_ctx = ctx;
 
-  dma_router_init(/*prio*/1);
-  dma_router_attach(ADC_DMA_CH, adc_dma_router_cb, NULL);
-  dma_router_stop(ADC_DMA_CH);
+  if (!adc_dma_claim()) return false;
+  dma_router_attach(s_dma_ch, adc_dma_router_cb, NULL);
+  dma_router_stop(s_dma_ch);
 
   /* Habilita DMA no ADC e garante one-shot */
   ADC1->CFGR1 |= ADC_CFGR1_DMAEN;
@@ -248,7 +256,7 @@ bool adc_bm_dma_start_oneshot(uint16_t *dst, uint16_t count,
     .msize_bits=1, .psize_bits=1, .priority=(dma_priority&3),
     .irq_tc=1, .irq_ht=0, .irq_te= te_irq ? 1u : 0u
   };
-  if (!dma_router_start(ADC_DMA_CH, (uint32_t)&ADC1->DR, (uint32_t)dst, count, &c))
+  if (!dma_router_start(s_dma_ch, (uint32_t)&ADC1->DR, (uint32_t)dst, count, &c))
     return false;
 
   /* limpa flags, habilita ADC; start SW só se não houver trigger externo */
@@ -268,9 +276,9 @@ bool adc_bm_dma_start_circular(uint16_t *ring, uint16_t length,
 
   s_dma_cb = cb; s_dma_ctx = ctx;
 
-  dma_router_init(/*prio*/1);
-  dma_router_attach(ADC_DMA_CH, adc_dma_router_cb, NULL);
-  dma_router_stop(ADC_DMA_CH);
+  if (!adc_dma_claim()) return false;
+  dma_router_attach(s_dma_ch, adc_dma_router_cb, NULL);
+  dma_router_stop(s_dma_ch);
 
   ADC1->CFGR1 |= ADC_CFGR1_DMAEN | ADC_CFGR1_DMACFG;
 
@@ -279,7 +287,33 @@ bool adc_bm_dma_start_circular(uint16_t *ring, uint16_t length,
     .msize_bits=1, .psize_bits=1, .priority=(dma_priority&3),
     .irq_tc= tc_irq?1u:0u, .irq_ht= ht_irq?1u:0u, .irq_te= te_irq?1u:0u
   };
-  if (!dma_router_start(ADC_DMA_CH, (uint32_t)&ADC1->DR, (uint32_t)ring, length, &c))
+  if (!dma_router_start(s_dma_ch, (uint32_t)&ADC1->DR, (uint32_t)ring, length, &c))
+    return false;
+
+  /* habilita ADC; start SW só se não houver trigger externo */
+  ADC1->ISR = ADC_ISR_ADRDY | ADC_ISR_EOC | ADC_ISR_EOS | ADC_ISR_OVR;
+  ADC1->CR  |= ADC_CR_ADEN;
+  if (s_extedge_cfg == ADC_BM_EXT_DISABLED) {
+    ADC1->CR  |= ADC_CR_ADSTART;
+  }
+  return true;
+}
+
+/* Streaming ping-pong (dma_stream sobre o canal circular) */
+bool adc_bm_dma_start_stream(dma_stream_t *st, uint16_t *ring, uint16_t length,
+                             uint8_t dma_priority, dma_stream_cb_t cb, void *ctx){
+  if (!st || !ring || length < 2) return false;
+
+  if (!adc_dma_claim()) return false;
+
+  ADC1->CFGR1 |= ADC_CFGR1_DMAEN | ADC_CFGR1_DMACFG;
+
+  dma_router_chan_cfg_t c = {
+    .mem_to_periph=0, .circular=1, .minc=1, .pinc=0,
+    .msize_bits=1, .psize_bits=1, .priority=(dma_priority&3),
+    .irq_tc=1, .irq_ht=1, .irq_te=1
+  };
+  if (!dma_stream_start(st, s_dma_ch, (uint32_t)&ADC1->DR, ring, length, &c, cb, ctx))
     return false;
 
   /* habilita ADC; start SW só se não houver trigger externo */
@@ -292,7 +326,9 @@ bool adc_bm_dma_start_circular(uint16_t *ring, uint16_t length,
 }
 
 void adc_bm_dma_stop(void){
-  dma_router_stop(ADC_DMA_CH);
-  dma_router_detach(ADC_DMA_CH);
+  if (s_dma_ch) dma_router_release(s_dma_ch, ADC_DMA_OWNER);   /* stop + detach */
+  s_dma_ch = 0;
   ADC1->CFGR1 &= ~(ADC_CFGR1_DMAEN | ADC_CFGR1_DMACFG);
 }
+
+uint8_t adc_bm_dma_channel(void){ return s_dma_ch; }
@@ -2,6 +2,7 @@
 #define ADC_BM_H
 
 #include "stm32f070xx.h"
+#include "dma_stream.h"
 
 
 /* ========= Resolução / alinhamento / scan ========= */
@@ -105,8 +106,17 @@ bool adc_bm_dma_start_circular(uint16_t *ring, uint16_t length,
                                uint8_t dma_priority, bool ht_irq, bool tc_irq, bool te_irq,
                                adc_bm_dma_cb_t cb, void *ctx);
 
+/* Streaming ping-pong: ring de 'length' amostras (par) dividido em duas metades;
+   cb recebe "metade N pronta" (ponteiro + nº de amostras) a partir de HT/TC.
+   Devolva cada metade com dma_stream_release(st, half); atrasos contam em st->overruns. */
+bool adc_bm_dma_start_stream(dma_stream_t *st, uint16_t *ring, uint16_t length,
+                             uint8_t dma_priority, dma_stream_cb_t cb, void *ctx);
+
 void adc_bm_dma_stop(void);
 
+/* Canal DMA em uso (1, ou 2 se remapeado; 0 = nenhum). Use com DMA_TCIF(ch) etc. no callback. */
+uint8_t adc_bm_dma_channel(void);
+
 /* ========= Utilidades ========= */
 void  gpio_to_analog(GPIO_TypeDef *GPIOx, uint8_t pin);
 int8_t adc_bm_channel_from_gpio(GPIO_TypeDef *GPIOx, uint8_t pin);
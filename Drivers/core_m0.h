@@ -8,16 +8,26 @@
 #ifndef __CORE_M0_H__
 #define __CORE_M0_H__
 
+/* System Control Space (0xE000E000); no build HOST_SIM é RAM do simulador */
+#ifndef SCS_BASE
+#ifdef HOST_SIM
+extern uint32_t sim_scs_mem[];
+#define SCS_BASE            ((uintptr_t)sim_scs_mem)
+#else
+#define SCS_BASE            0xE000E000UL
+#endif
+#endif
+
 /* NVIC (Cortex-M0) — acesso direto, sem helpers */
-#define NVIC_ISER           (*(volatile uint32_t*)0xE000E100UL)
-#define NVIC_ICER           (*(volatile uint32_t*)0xE000E180UL)
-#define NVIC_IPR_BASE       ((volatile uint8_t*)0xE000E400UL) // 8-bit per IRQ on M0
+#define NVIC_ISER           (*(volatile uint32_t*)(SCS_BASE + 0x100UL))
+#define NVIC_ICER           (*(volatile uint32_t*)(SCS_BASE + 0x180UL))
+#define NVIC_IPR_BASE       ((volatile uint8_t*)(SCS_BASE + 0x400UL)) // 8-bit per IRQ on M0
 
 /* ===== SysTick (ARMv6-M) ===== */
-#define SYST_CSR   (*(volatile uint32_t*)0xE000E010UL) /* CTRL */
-#define SYST_RVR   (*(volatile uint32_t*)0xE000E014UL) /* LOAD (24 bits) */
-#define SYST_CVR   (*(volatile uint32_t*)0xE000E018UL) /* VAL (write any clears) */
-#define SYST_CALIB (*(volatile uint32_t*)0xE000E01CUL) /* CALIB (opcional) */
+#define SYST_CSR   (*(volatile uint32_t*)(SCS_BASE + 0x010UL)) /* CTRL */
+#define SYST_RVR   (*(volatile uint32_t*)(SCS_BASE + 0x014UL)) /* LOAD (24 bits) */
+#define SYST_CVR   (*(volatile uint32_t*)(SCS_BASE + 0x018UL)) /* VAL (write any clears) */
+#define SYST_CALIB (*(volatile uint32_t*)(SCS_BASE + 0x01CUL)) /* CALIB (opcional) */
 
 /* CTRL bits */
 #define SYST_CSR_ENABLE      (1u << 0)   /* contador ON */
@@ -27,7 +37,7 @@
 
 /* ===== System Handler Priority Register 3 (Cortex-M0) =====
    SysTick (exceção 15) usa o byte [31:24] de SHPR3 (0xE000ED20). */
-#define SCB_SHPR3 (*(volatile uint32_t*)0xE000ED20UL)
+#define SCB_SHPR3 (*(volatile uint32_t*)(SCS_BASE + 0xD20UL))
 
 typedef enum {
     WWDG_IRQn                     = 0,
@@ -58,6 +68,7 @@ typedef enum {
     SPI2_IRQn                     = 26,
     USART1_IRQn                   = 27,
     USART2_IRQn                   = 28,
+    USART3_4_IRQn                 = 29,   /* vetor compartilhado USART3/USART4 */
     CEC_CAN_IRQn                  = 30,
     USB_IRQn                      = 31
 } IRQn_Type;
@@ -66,11 +77,46 @@ typedef enum {
 static inline void nvic_enable_irq(IRQn_Type irqn, uint8_t priority) {
     /* Cortex-M0 usa apenas os 2 MSBs do campo de prioridade (0..3 efetivo) */
     NVIC_IPR_BASE[(uint32_t)irqn] = (uint8_t)(priority << 6);
+#ifdef HOST_SIM
+    NVIC_ISER |= (1u << ((uint32_t)irqn & 0x1F));   /* RAM: escrever 0 não desabilita, então acumula */
+#else
     NVIC_ISER = (1u << ((uint32_t)irqn & 0x1F));
+#endif
 }
 
 static inline void nvic_disable_irq(IRQn_Type irqn) {
+#ifdef HOST_SIM
+    NVIC_ISER &= ~(1u << ((uint32_t)irqn & 0x1F));
+#else
     NVIC_ICER = (1u << ((uint32_t)irqn & 0x1F));
+#endif
+}
+
+/* ======= Seção crítica curta (PRIMASK) =======
+   Cortex-M0 não tem LDREX/STREX: read-modify-write compartilhado com ISR
+   precisa mascarar IRQs por poucos ciclos. Aninhável (restaura o estado anterior). */
+#ifdef HOST_SIM
+/* host: o simulador só entrega "IRQs" com sim_primask == 0 */
+extern volatile uint32_t sim_primask;
+static inline uint32_t irq_lock(void) {
+    uint32_t primask = sim_primask;
+    sim_primask = 1u;
+    return primask;
+}
+
+static inline void irq_unlock(uint32_t primask) {
+    sim_primask = primask;
+}
+#else
+static inline uint32_t irq_lock(void) {
+    uint32_t primask;
+    __asm volatile ("mrs %0, primask\n\tcpsid i" : "=r"(primask) :: "memory");
+    return primask;
+}
+
+static inline void irq_unlock(uint32_t primask) {
+    __asm volatile ("msr primask, %0" :: "r"(primask) : "memory");
 }
+#endif
 
 #endif /* __CORE_M0_H__ */
@@ -0,0 +1,42 @@
+/*
+ * crc.h
+ *
+ *  CRC-32 pela unidade de CRC do F0x0 e CRC-16 em software.
+ *  - CRC-32/ISO-HDLC (zlib/Ethernet): refletido, init 0xFFFFFFFF, xorout 0xFFFFFFFF.
+ *    O F070 tem polinômio fixo (0x04C11DB7); REV_IN por byte + REV_OUT dão a
+ *    forma refletida. Palavras alinhadas entram com 32 bits, o resto byte a byte.
+ *  - CRC-16/CCITT-FALSE (0x1021, init 0xFFFF, sem reflexão): a unidade do F0x0
+ *    não programa polinômio, então é por tabela de nibble (32 bytes em flash).
+ *  - CRC-16/MODBUS (0xA001 refletido, init 0xFFFF): tabela de byte (512 bytes).
+ *  - A unidade é única: crc32_calc mascara IRQs durante o cálculo, para poder
+ *    ser chamada da ISR e do loop (latência de IRQ ~ len/4 escritas em DR).
+ *  - HOST_SIM: CRC-32 em software (o modelo não observa escritas sucessivas em DR).
+ */
+
+#ifndef __CRC_H__
+#define __CRC_H__
+
+#include "stm32f070xx.h"
+
+#ifndef CRC_USE_HW
+#ifdef HOST_SIM
+#define CRC_USE_HW   0
+#else
+#define CRC_USE_HW   1
+#endif
+#endif
+
+/* Liga o clock da unidade de CRC (AHB) */
+void     crc_init(void);
+
+/* CRC-32 de um bloco; ex.: "123456789" → 0xCBF43926 */
+uint32_t crc32_calc(const void *data, uint32_t len);
+
+/* CRC-16/CCITT-FALSE encadeável: comece com crc = 0xFFFF; "123456789" → 0x29B1 */
+uint16_t crc16_ccitt(uint16_t crc, const void *data, uint32_t len);
+
+/* CRC-16/MODBUS encadeável: comece com crc = 0xFFFF; "123456789" → 0x4B37.
+   Vai no fio LSB primeiro; o CRC de um frame incluindo o próprio CRC dá 0. */
+uint16_t crc16_modbus(uint16_t crc, const void *data, uint32_t len);
+
+#endif /* __CRC_H__ */
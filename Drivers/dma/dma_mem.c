@@ -0,0 +1,193 @@
+#include "dma_mem.h"
+
+/* ===== Fila de pedidos ===== */
+typedef struct {
+  uint8_t       *dst;
+  const uint8_t *src;
+  uint32_t       len;
+  uint8_t        is_set;
+  uint8_t        value;
+  dma_mem_cb_t   cb;
+  void          *ctx;
+} mem_job_t;
+
+static mem_job_t s_q[DMA_MEM_QUEUE_LEN];
+static volatile uint8_t s_head = 0, s_count = 0;
+static volatile bool    s_active = false;   /* job da cabeça em execução */
+
+static uint8_t  s_ch   = 0;
+static uint8_t  s_prio = 0;
+
+/* segmento DMA em andamento (job da cabeça) */
+static uint8_t       *s_dst;
+static const uint8_t *s_src;
+static uint32_t       s_left;     /* unidades restantes */
+static uint8_t        s_shift;    /* 0:8b, 1:16b, 2:32b */
+static uint32_t       s_pattern;  /* origem fixa do memset */
+
+#define DMA_MEM_OWNER ((const void*)s_q)
+
+/* ===== CPU ===== */
+static void cpu_run(uint8_t *d, const uint8_t *src, uint8_t value, uint8_t is_set, uint32_t n){
+  if (is_set) memset(d, value, n);
+  else        memcpy(d, src, n);
+}
+
+/* Faz cabeça/cauda desalinhadas na CPU e prepara o miolo para o DMA */
+static void job_prepare(const mem_job_t *j){
+  uint8_t *d = j->dst;
+  const uint8_t *src = j->src;
+  uint32_t n = j->len;
+
+  if (j->is_set) {
+    s_shift = 2;                                       /* só o destino precisa alinhar */
+  } else {
+    uint32_t rel = (uint32_t)d ^ (uint32_t)src;
+    s_shift = ((rel & 3u) == 0u) ? 2u : ((rel & 1u) == 0u) ? 1u : 0u;
+  }
+  uint32_t a = (1u << s_shift) - 1u;
+
+  /* cabeça até alinhar o destino */
+  uint32_t head = (uint32_t)(-(uint32_t)d) & a;
+  if (head > n) head = n;
+  if (head) {
+    cpu_run(d, src, j->value, j->is_set, head);
+    d += head; n -= head;
+    if (!j->is_set) src += head;
+  }
+
+  /* cauda que não fecha uma unidade */
+  uint32_t tail = n & a;
+  n -= tail;
+  if (tail) cpu_run(d + n, j->is_set ? src : src + n, j->value, j->is_set, tail);
+
+  s_dst  = d;
+  s_src  = j->is_set ? (const uint8_t*)&s_pattern : src;
+  s_left = n >> s_shift;
+  if (j->is_set) s_pattern = (uint32_t)j->value * 0x01010101u;
+}
+
+static void seg_start(bool is_set){
+  uint32_t units = (s_left > 0xFFFFu) ? 0xFFFFu : s_left;
+
+  dma_router_chan_cfg_t c = {
+    .mem_to_periph = 0, .circular = 0, .minc = 1, .pinc = is_set ? 0u : 1u,
+    .msize_bits = s_shift, .psize_bits = s_shift, .priority = (s_prio & 3u),
+    .irq_tc = 1, .irq_ht = 0, .irq_te = 1, .mem2mem = 1
+  };
+  (void)dma_router_start(s_ch, (uint32_t)s_src, (uint32_t)s_dst, (uint16_t)units, &c);
+
+  s_left -= units;
+  s_dst  += units << s_shift;
+  if (!is_set) s_src += units << s_shift;
+}
+
+/* Executa jobs a partir da cabeça até um deles ficar em voo no DMA (ou a fila esvaziar) */
+static void run_queue(void){
+  for (;;) {
+    uint32_t pm = irq_lock();
+    if (s_count == 0u) { s_active = false; irq_unlock(pm); return; }
+    mem_job_t *j = &s_q[s_head];
+    irq_unlock(pm);
+
+    job_prepare(j);
+    if (s_left) { seg_start(j->is_set); return; }
+
+    /* tudo resolvido na CPU (pedido pequeno/desalinhado) */
+    dma_mem_cb_t cb = j->cb; void *ctx = j->ctx;
+    pm = irq_lock();
+    s_head = (uint8_t)((s_head + 1u) % DMA_MEM_QUEUE_LEN);
+    s_count--;
+    irq_unlock(pm);
+    if (cb) cb(ctx);
+  }
+}
+
+/* ===== dma_router callback ===== */
+static void dma_mem_cb(uint32_t flags, void *ctx){
+  (void)ctx;
+  mem_job_t *j = &s_q[s_head];
+
+  /* só TC/TE contam: o HTIF sobe mesmo sem HTIE e chega aqui pelo vetor
+     compartilhado (ex.: canal 4 interrompe com HT5 pendente) */
+  if (!(flags & (DMA_TCIF(s_ch) | DMA_TEIF(s_ch)))) return;
+
+  if (!(flags & DMA_TEIF(s_ch)) && s_left) {   /* próximo bloco de 65535 unidades */
+    seg_start(j->is_set);
+    return;
+  }
+  /* TC final ou erro: encerra o job (em erro, o restante é descartado) */
+  dma_router_stop(s_ch);
+
+  dma_mem_cb_t cb = j->cb; void *cctx = j->ctx;
+  uint32_t pm = irq_lock();
+  s_head = (uint8_t)((s_head + 1u) % DMA_MEM_QUEUE_LEN);
+  s_count--;
+  irq_unlock(pm);
+  if (cb) cb(cctx);
+
+  run_queue();
+}
+
+/* ===== API ===== */
+bool dma_mem_init(uint8_t ch, uint8_t priority){
+  if (s_ch) return true;
+
+  if (ch) {
+    if (!dma_router_claim(ch, DMA_MEM_OWNER)) return false;
+  } else {
+    for (uint8_t c = 5; c >= 1 && !ch; c--) {
+      if (dma_router_claim(c, DMA_MEM_OWNER)) ch = c;
+    }
+    if (!ch) return false;
+  }
+
+  s_ch = ch; s_prio = priority;
+  s_head = s_count = 0; s_active = false;
+  RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+  return dma_router_attach(s_ch, dma_mem_cb, NULL);
+}
+
+void dma_mem_deinit(void){
+  if (!s_ch) return;
+  dma_router_release(s_ch, DMA_MEM_OWNER);
+  s_ch = 0; s_count = 0; s_active = false;
+}
+
+static bool enqueue(void *dst, const void *src, uint8_t value, uint8_t is_set,
+                    uint32_t len, dma_mem_cb_t cb, void *ctx){
+  if (!s_ch || !dst || (!is_set && !src)) return false;
+
+  uint32_t pm = irq_lock();
+  /* curto e engine ocioso: CPU na hora (mantém a ordem porque a fila está vazia) */
+  if (!s_active && len < DMA_MEM_CPU_THRESHOLD) {
+    irq_unlock(pm);
+    cpu_run((uint8_t*)dst, (const uint8_t*)src, value, is_set, len);
+    if (cb) cb(ctx);
+    return true;
+  }
+  if (s_count >= DMA_MEM_QUEUE_LEN) { irq_unlock(pm); return false; }
+
+  mem_job_t *j = &s_q[(s_head + s_count) % DMA_MEM_QUEUE_LEN];
+  j->dst = (uint8_t*)dst; j->src = (const uint8_t*)src; j->len = len;
+  j->is_set = is_set; j->value = value; j->cb = cb; j->ctx = ctx;
+  s_count++;
+  bool was_idle = !s_active;
+  s_active = true;
+  irq_unlock(pm);
+
+  if (was_idle) run_queue();
+  return true;
+}
+
+bool dma_memcpy_async(void *dst, const void *src, uint32_t len, dma_mem_cb_t cb, void *ctx){
+  return enqueue(dst, src, 0, 0, len, cb, ctx);
+}
+
+bool dma_memset_async(void *dst, uint8_t value, uint32_t len, dma_mem_cb_t cb, void *ctx){
+  return enqueue(dst, NULL, value, 1, len, cb, ctx);
+}
+
+bool dma_mem_busy(void){ return s_active; }
+
+void dma_mem_wait(void){ while (s_active) { __asm volatile("nop"); } }
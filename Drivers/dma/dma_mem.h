@@ -0,0 +1,41 @@
+/*
+ * dma_mem.h
+ *
+ *  memcpy/memset assíncronos usando o modo MEM2MEM do DMA1 em um canal livre.
+ *  - Fila fixa de pedidos (DMA_MEM_QUEUE_LEN); executados em ordem.
+ *  - Spans com o mesmo alinhamento usam 32 bits (MSIZE/PSIZE); o resto 16/8 bits.
+ *    Bytes de cabeça/cauda desalinhados são copiados pela CPU.
+ *  - Pedidos curtos (< DMA_MEM_CPU_THRESHOLD bytes) com a fila vazia são feitos
+ *    pela CPU na hora (cb chamado antes de retornar).
+ *  - cb roda na ISR do DMA.
+ */
+
+#ifndef __DMA_MEM_H__
+#define __DMA_MEM_H__
+
+#include "stm32f070xx.h"
+
+#ifndef DMA_MEM_QUEUE_LEN
+#define DMA_MEM_QUEUE_LEN      8u
+#endif
+
+#ifndef DMA_MEM_CPU_THRESHOLD
+#define DMA_MEM_CPU_THRESHOLD  32u   /* bytes */
+#endif
+
+typedef void (*dma_mem_cb_t)(void *ctx);
+
+/* ch = 0: escolhe o canal livre de maior número (5..1). priority 0..3 (CCR.PL).
+   Requer dma_router_init() antes. Retorna false se não houver canal livre. */
+bool dma_mem_init(uint8_t ch, uint8_t priority);
+void dma_mem_deinit(void);
+
+/* Enfileira; false se a fila estiver cheia ou o engine não iniciado.
+   Os buffers devem continuar válidos até o cb. */
+bool dma_memcpy_async(void *dst, const void *src, uint32_t len, dma_mem_cb_t cb, void *ctx);
+bool dma_memset_async(void *dst, uint8_t value, uint32_t len, dma_mem_cb_t cb, void *ctx);
+
+bool dma_mem_busy(void);
+void dma_mem_wait(void);
+
+#endif /* __DMA_MEM_H__ */
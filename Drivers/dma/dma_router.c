@@ -4,33 +4,180 @@
 typedef struct {
 	dma_router_cb_t cb;
 	void *ctx;
+	/* cadeia de descritores em andamento (NULL = sem próximo segmento) */
+	const dma_router_desc_t *next;
+	uint32_t ccr;              /* CCR base da cadeia (sem EN) */
+	const void *owner;         /* dono do canal (NULL = livre) */
+#if DMA_ROUTER_STATS
+	uint32_t seg_bytes;        /* bytes do segmento em voo (CNDTR*MSIZE) */
+	dma_router_stats_t st;
+#endif
 } slot_t;
 static slot_t s_slots[8]; /* indexa 1..7 */
 
+/* ========= mapa de requisições do F070 (RM0360; ajuste se seu RM diferir) ========= */
+typedef struct {
+	uint8_t  ch;        /* canal padrão */
+	uint8_t  rmp_ch;    /* canal alternativo (0 = sem remap) */
+	uint32_t rmp_bit;   /* bit em SYSCFG_CFGR1 */
+} req_map_t;
+
+static const req_map_t s_req_map[DMA_REQ_COUNT] = {
+	[DMA_REQ_ADC]       = { 1, 2, SYSCFG_CFGR1_ADC_DMA_RMP },
+	[DMA_REQ_SPI1_RX]   = { 2, 0, 0 },
+	[DMA_REQ_SPI1_TX]   = { 3, 0, 0 },
+	[DMA_REQ_SPI2_RX]   = { 4, 0, 0 },
+	[DMA_REQ_SPI2_TX]   = { 5, 0, 0 },
+	[DMA_REQ_USART1_TX] = { 2, 4, SYSCFG_CFGR1_USART1TX_DMA_RMP },
+	[DMA_REQ_USART1_RX] = { 3, 5, SYSCFG_CFGR1_USART1RX_DMA_RMP },
+	[DMA_REQ_USART2_TX] = { 4, 0, 0 },
+	[DMA_REQ_USART2_RX] = { 5, 0, 0 },
+	[DMA_REQ_USART3_TX] = { 2, 0, 0 },
+	[DMA_REQ_USART3_RX] = { 3, 0, 0 },
+	[DMA_REQ_USART4_TX] = { 4, 0, 0 },
+	[DMA_REQ_USART4_RX] = { 5, 0, 0 },
+	[DMA_REQ_I2C1_TX]   = { 2, 0, 0 },
+	[DMA_REQ_I2C1_RX]   = { 3, 0, 0 },
+	[DMA_REQ_I2C2_TX]   = { 4, 0, 0 },
+	[DMA_REQ_I2C2_RX]   = { 5, 0, 0 },
+	[DMA_REQ_TIM16]     = { 3, 4, SYSCFG_CFGR1_TIM16_DMA_RMP },
+	[DMA_REQ_TIM17]     = { 1, 2, SYSCFG_CFGR1_TIM17_DMA_RMP },
+};
+
 /* ========= helpers internos ========= */
+/* ch já validado pelo chamador (1..5) */
 static inline DMA_Channel_TypeDef* dma_ch_ptr(uint8_t ch){
-    switch (ch){
-        case 1: return DMA1_Channel1;
-        case 2: return DMA1_Channel2;
-        case 3: return DMA1_Channel3;
-        case 4: return DMA1_Channel4;
-        case 5: return DMA1_Channel5;
-        default: return DMA1_Channel1;
-    }
+    return DMA1_CHANNEL(ch);
 }
 static inline void dma_router_clear_all_flags(uint8_t ch){
     DMA1->IFCR = DMA_GIF(ch) | DMA_TCIF(ch) | DMA_HTIF(ch) | DMA_TEIF(ch);
 }
 
+#if DMA_ROUTER_STATS
+/* Ticks decorridos do SysTick (contador decrescente de 24 bits) */
+static inline uint32_t dma_stats_now(void){ return SYST_CVR; }
+static inline uint32_t dma_stats_elapsed(uint32_t t0, uint32_t t1){
+    uint32_t d = t0 - t1;
+    if (t1 > t0) d += (SYST_RVR & 0x00FFFFFFu) + 1u;   /* deu a volta */
+    return d;
+}
+static inline void dma_stats_seg(uint8_t ch, uint32_t ccr, uint16_t count){
+    s_slots[ch].seg_bytes = (uint32_t)count << ((ccr >> DMA_CCR_MSIZE_Pos) & 3u);
+}
+#define DMA_STATS(x)  do { x; } while (0)
+#else
+#define DMA_STATS(x)  do { } while (0)
+#endif
+
+/* Monta CCR (sem EN) conforme cfg */
+static uint32_t dma_ccr_from_cfg(const dma_router_chan_cfg_t *cfg){
+    uint32_t ccr = DMA_ROUTER_CCR(cfg->mem_to_periph, cfg->circular, cfg->minc, cfg->pinc,
+                                  cfg->msize_bits, cfg->psize_bits, cfg->priority,
+                                  cfg->irq_tc, cfg->irq_ht, cfg->irq_te);
+    if (cfg->mem2mem) ccr |= DMA_CCR_MEM2MEM;
+    return ccr;
+}
+
+/* Caminho rápido comum: só CCR (EN=0), CMAR, CNDTR e EN */
+static inline void dma_restart_ccr(uint8_t ch, uint32_t cmar, uint16_t count, uint32_t ccr){
+    DMA_Channel_TypeDef *CH = dma_ch_ptr(ch);
+    CH->CCR   = ccr;              /* EN=0 */
+    CH->CMAR  = cmar;
+    CH->CNDTR = count;
+    s_slots[ch].next = 0;
+    DMA_STATS(dma_stats_seg(ch, ccr, count); s_slots[ch].st.started++);
+    CH->CCR   = ccr | DMA_CCR_EN;
+}
+
+/* Programa um segmento da cadeia e habilita o canal */
+static inline void dma_load_desc(uint8_t ch, const dma_router_desc_t *d){
+    DMA_Channel_TypeDef *CH = dma_ch_ptr(ch);
+    uint32_t ccr = s_slots[ch].ccr;
+    if (d->fixed_mem) ccr &= ~DMA_CCR_MINC;
+
+    CH->CCR = ccr;                 /* EN=0 */
+    if (d->cpar) CH->CPAR = d->cpar;
+    CH->CMAR  = d->cmar;
+    CH->CNDTR = d->count;
+    s_slots[ch].next = d->next;
+    DMA_STATS(dma_stats_seg(ch, ccr, d->count));
+    CH->CCR = ccr | DMA_CCR_EN;
+}
+
 /* ==== dispatcher: mantém sua ordem cb(flags, ctx) ==== */
-static inline void dispatch_ch(uint8_t ch, uint32_t isr_mask_tc, uint32_t isr_mask_ht, uint32_t isr_mask_te)
+/* Eventos (TC/HT/TE, sem GIF) de cada grupo de vetor */
+#define DMA_EVT(n)       (DMA_TCIF(n) | DMA_HTIF(n) | DMA_TEIF(n))
+#define DMA_GRP_CH1      (DMA_EVT(1))
+#define DMA_GRP_CH2_3    (DMA_EVT(2) | DMA_EVT(3))
+#define DMA_GRP_CH4_5    (DMA_EVT(4) | DMA_EVT(5))
+
+/* Índice do bit menos significativo (Cortex-M0 não tem CLZ/RBIT): De Bruijn */
+static inline uint32_t dma_ctz(uint32_t x){
+    static const uint8_t k_debruijn[32] = {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+    };
+    return k_debruijn[((x & (0u - x)) * 0x077CB531u) >> 27];
+}
+
+/* flags já lidas e limpas pelo dma_dispatch() */
+static inline void dispatch_ch(uint8_t ch, uint32_t flags)
 {
-    uint32_t isr = DMA1->ISR;
-    uint32_t flags = 0;
-    if (isr & isr_mask_tc) { DMA1->IFCR = isr_mask_tc; flags |= isr_mask_tc; }
-    if (isr & isr_mask_ht) { DMA1->IFCR = isr_mask_ht; flags |= isr_mask_ht; }
-    if (isr & isr_mask_te) { DMA1->IFCR = isr_mask_te; flags |= isr_mask_te; }
+    const uint32_t isr_mask_tc = DMA_TCIF(ch);
+#if DMA_ROUTER_STATS
+    const uint32_t isr_mask_ht = DMA_HTIF(ch);
+#endif
+    const uint32_t isr_mask_te = DMA_TEIF(ch);
+#if DMA_ROUTER_STATS
+    uint32_t t0 = dma_stats_now();
+    dma_router_stats_t *st = &s_slots[ch].st;
+#endif
+
+#if DMA_ROUTER_STATS
+    if (flags & isr_mask_tc) { st->tc++; st->bytes += s_slots[ch].seg_bytes; }
+    if (flags & isr_mask_ht) st->ht++;
+    if (flags & isr_mask_te) st->te++;
+#endif
+
+    /* cadeia: TE aborta; TC intermediário recarrega o próximo segmento e é engolido */
+    if (s_slots[ch].next) {
+        if (flags & isr_mask_te) {
+            s_slots[ch].next = 0;
+        } else if (flags & isr_mask_tc) {
+            dma_load_desc(ch, s_slots[ch].next);
+            flags &= ~isr_mask_tc;
+        }
+    }
+
+#if DMA_ROUTER_STATS
+    if (flags & isr_mask_tc) st->completed++;
+#endif
+
     if (flags && s_slots[ch].cb) s_slots[ch].cb(flags, s_slots[ch].ctx);
+
+#if DMA_ROUTER_STATS
+    uint32_t dt = dma_stats_elapsed(t0, dma_stats_now());
+    st->isr_count++;
+    st->isr_cycles_total += dt;
+    if (dt > st->isr_cycles_max) st->isr_cycles_max = dt;
+#endif
+}
+
+/* Um acesso de leitura ao ISR e uma escrita no IFCR por interrupção;
+   percorre só os canais do grupo que têm evento pendente.
+   Não escreve GIF: isso limparia eventos que chegassem entre a leitura e a escrita. */
+static void dma_dispatch(uint32_t grp)
+{
+    uint32_t pend = DMA1->ISR & grp;
+    if (!pend) return;
+    DMA1->IFCR = pend;
+
+    while (pend) {
+        uint32_t sh = dma_ctz(pend) & ~3u;          /* início do nibble do canal */
+        uint32_t f  = pend & (0xFu << sh);
+        pend &= ~f;
+        dispatch_ch((uint8_t)((sh >> 2) + 1u), f);
+    }
 }
 
 /* ============================================================
@@ -38,8 +185,8 @@ static inline void dispatch_ch(uint8_t ch, uint32_t isr_mask_tc, uint32_t isr_ma
    ============================================================ */
 void dma_router_init(uint8_t prio)
 {
-    for (int i=0;i<8;i++){ s_slots[i].cb = 0; s_slots[i].ctx = 0; }
-
+    /* Não mexe na tabela (já nasce zerada em .bss): drivers chamam init de
+       novo (ex.: ADC) e claim/attach podem vir antes do 1º init. */
     /* Liga clock do DMA1 */
     RCC->AHBENR |= RCC_AHBENR_DMA1EN;
 
@@ -63,54 +210,132 @@ void dma_router_detach(uint8_t ch)
     s_slots[ch].cb = 0; s_slots[ch].ctx = 0;
 }
 
+/* ============================================================
+   NOVO: alocação de canais (dono + remap SYSCFG)
+   ============================================================ */
+bool dma_router_claim(uint8_t ch, const void *owner)
+{
+    if (ch < 1 || ch > 5 || !owner) return false;
+    uint32_t pm = irq_lock();
+    bool ok = (s_slots[ch].owner == 0) || (s_slots[ch].owner == owner);
+    if (ok) s_slots[ch].owner = owner;
+    irq_unlock(pm);
+    return ok;
+}
+
+void dma_router_release(uint8_t ch, const void *owner)
+{
+    if (ch < 1 || ch > 5) return;
+    if (s_slots[ch].owner != owner) return;
+    dma_router_stop(ch);
+    dma_router_detach(ch);
+    s_slots[ch].owner = 0;
+}
+
+const void *dma_router_owner(uint8_t ch)
+{
+    if (ch < 1 || ch > 7) return 0;
+    return s_slots[ch].owner;
+}
+
+uint8_t dma_router_claim_req(dma_req_t req, const void *owner)
+{
+    if ((unsigned)req >= DMA_REQ_COUNT) return 0;
+    const req_map_t *m = &s_req_map[req];
+
+    if (dma_router_claim(m->ch, owner)) {
+        /* garante roteamento padrão */
+        if (m->rmp_bit) {
+            RCC->APB2ENR |= RCC_APB2ENR_SYSCFGCOMPEN;
+            SYSCFG->CFGR1 &= ~m->rmp_bit;
+        }
+        return m->ch;
+    }
+    if (m->rmp_ch && dma_router_claim(m->rmp_ch, owner)) {
+        RCC->APB2ENR |= RCC_APB2ENR_SYSCFGCOMPEN;
+        SYSCFG->CFGR1 |= m->rmp_bit;
+        return m->rmp_ch;
+    }
+    return 0;
+}
+
 /* ============================================================
    NOVO: configuração de canal (start/stop/util)
    ============================================================ */
-bool dma_router_start(uint8_t ch, uint32_t cpar, uint32_t cmar,
-                      uint16_t count, const dma_router_chan_cfg_t *cfg)
+bool dma_router_prepare_ccr(uint8_t ch, uint32_t cpar, uint32_t ccr)
 {
-    if (ch < 1 || ch > 5 || !cfg) return false;
+    if (ch < 1 || ch > 5) return false;
 
     DMA_Channel_TypeDef *CH = dma_ch_ptr(ch);
 
-    /* Desabilita antes de mexer */
+    /* Desabilita antes de mexer e limpa flags pendentes */
     CH->CCR &= ~DMA_CCR_EN;
-
-    /* Limpa flags pendentes */
+    s_slots[ch].next = 0;
     dma_router_clear_all_flags(ch);
 
-    /* Programa endereços e tamanho */
-    CH->CPAR  = cpar;
-    CH->CMAR  = cmar;
-    CH->CNDTR = count;
+    /* CPAR fica fixo no canal; CCR vai para o cache (sem EN) */
+    CH->CPAR = cpar;
+    s_slots[ch].ccr = ccr & ~DMA_CCR_EN;
+    CH->CCR  = s_slots[ch].ccr;
+    return true;
+}
 
-    /* Monta CCR conforme cfg */
-    uint32_t ccr = 0;
-    if (cfg->mem_to_periph) ccr |= DMA_CCR_DIR;
-    if (cfg->circular)      ccr |= DMA_CCR_CIRC;
-    if (cfg->minc)          ccr |= DMA_CCR_MINC;
-    if (cfg->pinc)          ccr |= DMA_CCR_PINC;
+bool dma_router_prepare(uint8_t ch, uint32_t cpar, const dma_router_chan_cfg_t *cfg)
+{
+    if (!cfg) return false;
+    return dma_router_prepare_ccr(ch, cpar, dma_ccr_from_cfg(cfg));
+}
 
-    ccr |= ((uint32_t)(cfg->psize_bits & 3u) << DMA_CCR_PSIZE_Pos);
-    ccr |= ((uint32_t)(cfg->msize_bits & 3u) << DMA_CCR_MSIZE_Pos);
-    ccr |= ((uint32_t)(cfg->priority   & 3u) << DMA_CCR_PL_Pos);
+bool dma_router_restart(uint8_t ch, uint32_t cmar, uint16_t count)
+{
+    if (ch < 1 || ch > 5) return false;
+    dma_restart_ccr(ch, cmar, count, s_slots[ch].ccr);
+    return true;
+}
 
-    if (cfg->irq_tc) ccr |= DMA_CCR_TCIE;
-    if (cfg->irq_ht) ccr |= DMA_CCR_HTIE;
-    if (cfg->irq_te) ccr |= DMA_CCR_TEIE;
+bool dma_router_restart_fixed(uint8_t ch, uint32_t cmar, uint16_t count)
+{
+    if (ch < 1 || ch > 5) return false;
+    dma_restart_ccr(ch, cmar, count, s_slots[ch].ccr & ~DMA_CCR_MINC);
+    return true;
+}
 
-    CH->CCR = ccr;
+bool dma_router_start(uint8_t ch, uint32_t cpar, uint32_t cmar,
+                      uint16_t count, const dma_router_chan_cfg_t *cfg)
+{
+    if (!dma_router_prepare(ch, cpar, cfg)) return false;
+    dma_restart_ccr(ch, cmar, count, s_slots[ch].ccr);
+    return true;
+}
 
-    /* Habilita canal */
-    CH->CCR |= DMA_CCR_EN;
+bool dma_router_restart_chain(uint8_t ch, const dma_router_desc_t *first)
+{
+    if (ch < 1 || ch > 5 || !first) return false;
+    if (s_slots[ch].ccr & DMA_CCR_CIRC) return false;
+
+    /* TC é obrigatório para avançar a cadeia */
+    s_slots[ch].ccr |= DMA_CCR_TCIE;
+    DMA_STATS(s_slots[ch].st.started++);
+    dma_load_desc(ch, first);
     return true;
 }
 
+bool dma_router_start_chain(uint8_t ch, const dma_router_desc_t *first,
+                            const dma_router_chan_cfg_t *cfg)
+{
+    if (!first || !cfg || cfg->circular) return false;
+    if (!first->cpar) return false;   /* o 1º segmento define o periférico */
+
+    if (!dma_router_prepare(ch, first->cpar, cfg)) return false;
+    return dma_router_restart_chain(ch, first);
+}
+
 void dma_router_stop(uint8_t ch)
 {
     if (ch < 1 || ch > 5) return;
     DMA_Channel_TypeDef *CH = dma_ch_ptr(ch);
     CH->CCR &= ~DMA_CCR_EN;
+    s_slots[ch].next = 0;
     dma_router_clear_all_flags(ch);
 }
 
@@ -126,22 +351,47 @@ uint16_t dma_router_get_remaining(uint8_t ch)
     return (uint16_t)dma_ch_ptr(ch)->CNDTR;
 }
 
+#if DMA_ROUTER_STATS
+/* ============================================================
+   NOVO: estatísticas
+   ============================================================ */
+bool dma_router_get_stats(uint8_t ch, dma_router_stats_t *out)
+{
+    if (ch < 1 || ch > 5 || !out) return false;
+    uint32_t pm = irq_lock();
+    *out = s_slots[ch].st;
+    irq_unlock(pm);
+    return true;
+}
+
+void dma_router_reset_stats(uint8_t ch)
+{
+    uint8_t a = ch ? ch : 1u, b = ch ? ch : 5u;
+    if (a < 1 || b > 5) return;
+    uint32_t pm = irq_lock();
+    for (uint8_t i = a; i <= b; i++) memset(&s_slots[i].st, 0, sizeof(s_slots[i].st));
+    irq_unlock(pm);
+}
+#endif
+
 /* ============================ ISRs ============================ */
+/* Nomes do vetor em Startup/startup_stm32f070rbtx.s; os nomes estilo CMSIS
+   ficam como alias para quem usa outro startup. */
 void DMA1_CH1_IRQHandler(void)
 {
-    dispatch_ch(1, DMA_TCIF1, DMA_HTIF1, DMA_TEIF1);
+    dma_dispatch(DMA_GRP_CH1);
 }
-void DMA1_Channel2_3_IRQHandler(void)
+void DMA1_CH2_3_IRQHandler(void)
 {
-    dispatch_ch(2, DMA_TCIF2, DMA_HTIF2, DMA_TEIF2);
-    dispatch_ch(3, DMA_TCIF3, DMA_HTIF3, DMA_TEIF3);
+    dma_dispatch(DMA_GRP_CH2_3);
 }
-void DMA1_Channel4_5_IRQHandler(void)
+void DMA1_CH4_5_IRQHandler(void)
 {
-    dispatch_ch(4, DMA_TCIF4, DMA_HTIF4, DMA_TEIF4);
-    dispatch_ch(5, DMA_TCIF5, DMA_HTIF5, DMA_TEIF5);
+    dma_dispatch(DMA_GRP_CH4_5);
 }
-/* Se seu MCU tiver 6/7 compartilhados, acrescente aqui:
-void DMA1_Channel6_7_IRQHandler(void) { dispatch_ch(6,...); dispatch_ch(7,...); }
+void DMA1_Channel1_IRQHandler(void)   __attribute__((alias("DMA1_CH1_IRQHandler")));
+void DMA1_Channel2_3_IRQHandler(void) __attribute__((alias("DMA1_CH2_3_IRQHandler")));
+void DMA1_Channel4_5_IRQHandler(void) __attribute__((alias("DMA1_CH4_5_IRQHandler")));
+/* Se seu MCU tiver 6/7 compartilhados, acrescente DMA_EVT(6)|DMA_EVT(7) e:
+void DMA1_Channel6_7_IRQHandler(void) { dma_dispatch(DMA_EVT(6) | DMA_EVT(7)); }
 */
-
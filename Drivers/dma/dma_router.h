@@ -14,10 +14,47 @@
 typedef void (*dma_router_cb_t)(uint32_t flags, void *ctx);
 
 /* API */
+/* Clock do DMA1 e NVIC. Idempotente; não apaga donos/callbacks (claim e
+   attach podem vir antes ou depois). */
 void dma_router_init(uint8_t nvic_priority_0_to_3);
 bool dma_router_attach(uint8_t ch_index_1_to_7, dma_router_cb_t cb, void *ctx);
 void dma_router_detach(uint8_t ch_index_1_to_7);
 
+/* NOVO: alocação de canais com dono
+   - claim/release marcam o canal como de um dono (ponteiro do handle do driver);
+     um segundo dono é recusado até o primeiro liberar.
+   - claim_req escolhe o canal pela requisição do periférico: tenta o canal padrão
+     e, se ocupado e houver remap (SYSCFG_CFGR1), o alternativo. Retorna 0 se nenhum.
+   - Periféricos sem remap (SPI1, I2C1, SPI2, USART3/4...) devem reservar antes de
+     USART1/ADC para que estes sejam os relocados. */
+typedef enum {
+    DMA_REQ_ADC = 0,
+    DMA_REQ_SPI1_RX,
+    DMA_REQ_SPI1_TX,
+    DMA_REQ_SPI2_RX,
+    DMA_REQ_SPI2_TX,
+    DMA_REQ_USART1_TX,
+    DMA_REQ_USART1_RX,
+    DMA_REQ_USART2_TX,
+    DMA_REQ_USART2_RX,
+    DMA_REQ_USART3_TX,
+    DMA_REQ_USART3_RX,
+    DMA_REQ_USART4_TX,
+    DMA_REQ_USART4_RX,
+    DMA_REQ_I2C1_TX,
+    DMA_REQ_I2C1_RX,
+    DMA_REQ_I2C2_TX,
+    DMA_REQ_I2C2_RX,
+    DMA_REQ_TIM16,
+    DMA_REQ_TIM17,
+    DMA_REQ_COUNT
+} dma_req_t;
+
+bool        dma_router_claim(uint8_t ch, const void *owner);
+void        dma_router_release(uint8_t ch, const void *owner);
+const void *dma_router_owner(uint8_t ch);
+uint8_t     dma_router_claim_req(dma_req_t req, const void *owner);
+
 /* NOVO: configuração “one-shot” de um canal (1..5) e controle */
 typedef struct {
     uint8_t mem_to_periph;   /* 1: mem->periph (CCR.DIR) */
@@ -30,14 +67,88 @@ typedef struct {
     uint8_t irq_tc;          /* CCR.TCIE */
     uint8_t irq_ht;          /* CCR.HTIE */
     uint8_t irq_te;          /* CCR.TEIE */
+    uint8_t mem2mem;         /* CCR.MEM2MEM (CPAR = origem, CMAR = destino, DIR=0) */
 } dma_router_chan_cfg_t;
 
 bool     dma_router_start(uint8_t ch, uint32_t cpar, uint32_t cmar,
                           uint16_t count, const dma_router_chan_cfg_t *cfg);
+
+/* NOVO: canal preparado (caminho rápido para transferências repetidas)
+   - prepare calcula o CCR uma vez, guarda no router e grava CPAR no canal.
+   - restart só escreve CCR (EN=0), CMAR, CNDTR e EN: sem recalcular CCR nem
+     limpar flags (o dispatcher e o stop já as limpam). Continua rastreado
+     pelo router (cadeia, estatísticas).
+   - restart_fixed: idem com MINC=0 nesta rodada (dummy/discard).
+   - restart/restart_fixed devolvem false se ch estiver fora de 1..5.
+   - Para cfg constante, DMA_ROUTER_CCR() monta o CCR em tempo de compilação. */
+#define DMA_ROUTER_CCR(m2p, circ, minc, pinc, msize, psize, prio, tc, ht, te) \
+    ( ((m2p)  ? DMA_CCR_DIR  : 0u) | ((circ) ? DMA_CCR_CIRC : 0u) |          \
+      ((minc) ? DMA_CCR_MINC : 0u) | ((pinc) ? DMA_CCR_PINC : 0u) |          \
+      (((uint32_t)(psize) & 3u) << DMA_CCR_PSIZE_Pos) |                      \
+      (((uint32_t)(msize) & 3u) << DMA_CCR_MSIZE_Pos) |                      \
+      (((uint32_t)(prio)  & 3u) << DMA_CCR_PL_Pos)    |                      \
+      ((tc) ? DMA_CCR_TCIE : 0u) | ((ht) ? DMA_CCR_HTIE : 0u) |              \
+      ((te) ? DMA_CCR_TEIE : 0u) )
+
+bool     dma_router_prepare(uint8_t ch, uint32_t cpar, const dma_router_chan_cfg_t *cfg);
+bool     dma_router_prepare_ccr(uint8_t ch, uint32_t cpar, uint32_t ccr);
+bool     dma_router_restart(uint8_t ch, uint32_t cmar, uint16_t count);
+bool     dma_router_restart_fixed(uint8_t ch, uint32_t cmar, uint16_t count);
 void     dma_router_stop(uint8_t ch);
 void     dma_router_set_length(uint8_t ch, uint16_t count);
 uint16_t dma_router_get_remaining(uint8_t ch);
 
+/* NOVO: transferências encadeadas (scatter-gather por software)
+   - Cada descritor é um bloco CPAR/CMAR/CNDTR; o TC de um segmento recarrega
+     o próximo direto no dispatcher do router (sem passar pelo callback).
+   - O callback do canal recebe o TC somente no fim da cadeia; TE aborta a cadeia.
+   - Os descritores precisam continuar válidos até o TC final (não são copiados).
+   - Não combina com cfg->circular. */
+typedef struct dma_router_desc_s {
+    uint32_t cpar;                          /* 0: mantém o CPAR do segmento anterior */
+    uint32_t cmar;
+    uint16_t count;
+    uint8_t  fixed_mem;                     /* 1: MINC=0 só neste segmento (fill/discard) */
+    const struct dma_router_desc_s *next;   /* NULL: último segmento */
+} dma_router_desc_t;
+
+bool     dma_router_start_chain(uint8_t ch, const dma_router_desc_t *first,
+                                const dma_router_chan_cfg_t *cfg);
+/* Cadeia sobre canal já preparado (CPAR do prepare se first->cpar == 0) */
+bool     dma_router_restart_chain(uint8_t ch, const dma_router_desc_t *first);
+
+/* NOVO: estatísticas por canal (DMA_ROUTER_STATS=1 para compilar)
+   - started/completed: transferências iniciadas e terminadas (TC final da cadeia
+     ou cada volta no modo circular); tc/ht/te: eventos brutos vistos na ISR.
+   - bytes: soma de CNDTR*MSIZE dos segmentos que deram TC.
+   - isr_*: tempo de despacho do canal (flags + recarga de cadeia + callback),
+     em ticks do SysTick (HCLK ou HCLK/8 conforme CLKSOURCE); 0 se o SysTick
+     estiver parado. Média = isr_cycles_total / isr_count.
+   Com DMA_ROUTER_STATS=0 nada disso é compilado e get_stats retorna false. */
+#ifndef DMA_ROUTER_STATS
+#define DMA_ROUTER_STATS 0
+#endif
+
+typedef struct {
+    uint32_t started;
+    uint32_t completed;
+    uint32_t bytes;
+    uint32_t tc, ht, te;
+    uint32_t isr_count;
+    uint32_t isr_cycles_max;
+    uint32_t isr_cycles_total;
+} dma_router_stats_t;
+
+#if DMA_ROUTER_STATS
+/* Cópia consistente (com IRQs mascaradas) dos contadores do canal 1..5 */
+bool dma_router_get_stats(uint8_t ch, dma_router_stats_t *out);
+/* ch = 0 zera todos os canais */
+void dma_router_reset_stats(uint8_t ch);
+#else
+static inline bool dma_router_get_stats(uint8_t ch, dma_router_stats_t *out){ (void)ch; (void)out; return false; }
+static inline void dma_router_reset_stats(uint8_t ch){ (void)ch; }
+#endif
+
 /* Wrappers comuns */
 static inline bool dma_router_start_mem2periph_16(uint8_t ch,
         volatile void *periph_reg, const void *mem, uint16_t len,
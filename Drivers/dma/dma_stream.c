@@ -0,0 +1,102 @@
+#include "dma_stream.h"
+
+/* ===== entrega de uma metade (contexto da ISR do DMA) ===== */
+static void stream_deliver(dma_stream_t *st, uint8_t half)
+{
+  uint8_t bit = (uint8_t)(1u << half);
+
+  st->halves++;
+  if (half != st->next_half) st->dropped++;   /* perdemos o evento da outra metade */
+  st->next_half = half ^ 1u;
+
+  /* o DMA passa agora a reescrever a outra metade: overrun se o consumidor
+     ainda a segura */
+  if (st->owned & (bit ^ 3u)) st->overruns++;
+  st->owned |= bit;
+
+  void *data = st->buf + (uint32_t)half * st->half_items * st->item_size;
+  if (st->cb) st->cb(st, half, data, st->half_items, st->ctx);
+  else        st->ready |= bit;
+}
+
+static void stream_dma_cb(uint32_t flags, void *ctx)
+{
+  dma_stream_t *st = (dma_stream_t*)ctx;
+  uint8_t ch = st->ch;
+
+  if (flags & DMA_TEIF(ch)) {
+    if (st->on_error) st->on_error(flags, st->ctx);
+    return;
+  }
+
+  bool ht = (flags & DMA_HTIF(ch)) != 0;
+  bool tc = (flags & DMA_TCIF(ch)) != 0;
+
+  if (ht && tc) {
+    /* ISR atrasou mais de meia volta: entrega as duas na ordem em que foram completadas */
+    uint8_t first = st->next_half;
+    stream_deliver(st, first);
+    stream_deliver(st, first ^ 1u);
+  } else if (ht) {
+    stream_deliver(st, 0);
+  } else if (tc) {
+    stream_deliver(st, 1);
+  }
+}
+
+/* ===== API ===== */
+bool dma_stream_start(dma_stream_t *st, uint8_t ch, uint32_t cpar,
+                      void *buf, uint16_t items,
+                      const dma_router_chan_cfg_t *cfg,
+                      dma_stream_cb_t cb, void *ctx)
+{
+  if (!st || !buf || !cfg || items < 2 || (items & 1u)) return false;
+
+  uint8_t msize = cfg->msize_bits & 3u;
+  if (msize > 2) return false;
+
+  st->ch         = ch;
+  st->item_size  = (uint8_t)(1u << msize);
+  st->half_items = items / 2u;
+  st->buf        = (uint8_t*)buf;
+  st->ready = st->owned = 0;
+  st->next_half  = 0;
+  st->halves = st->overruns = st->dropped = 0;
+  st->cb  = cb;
+  st->ctx = ctx;
+
+  /* circular com HT+TC sempre; o resto vem do cfg do usuário */
+  dma_router_chan_cfg_t c = *cfg;
+  c.circular = 1;
+  c.irq_ht = 1;
+  c.irq_tc = 1;
+
+  dma_router_stop(ch);
+  if (!dma_router_attach(ch, stream_dma_cb, st)) return false;
+  return dma_router_start(ch, cpar, (uint32_t)buf, items, &c);
+}
+
+void dma_stream_stop(dma_stream_t *st)
+{
+  dma_router_stop(st->ch);
+  dma_router_detach(st->ch);
+  st->ready = 0;
+}
+
+int8_t dma_stream_get(dma_stream_t *st, void **data, uint16_t *items)
+{
+  uint32_t pm = irq_lock();
+  uint8_t ready = st->ready;
+  if (!ready) { irq_unlock(pm); return -1; }
+
+  /* com as duas prontas, a mais antiga é a que o DMA vai completar em seguida */
+  uint8_t half;
+  if (ready == 3u) half = st->next_half;
+  else             half = (ready & 1u) ? 0u : 1u;
+
+  st->ready &= (uint8_t)~(1u << half);
+  irq_unlock(pm);
+  if (data)  *data  = st->buf + (uint32_t)half * st->half_items * st->item_size;
+  if (items) *items = st->half_items;
+  return (int8_t)half;
+}
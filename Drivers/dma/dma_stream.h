@@ -0,0 +1,65 @@
+/*
+ * dma_stream.h
+ *
+ *  Double-buffer (ping-pong) sobre um canal circular do dma_router.
+ *  O buffer é dividido em duas metades: HT entrega a metade 0, TC a metade 1.
+ *  O consumidor devolve cada metade com dma_stream_release(); se, ao fim de
+ *  uma metade, a outra (que o DMA começa a reescrever) ainda não foi
+ *  devolvida, conta overrun (o conteúdo que o consumidor segura está sendo
+ *  sobrescrito).
+ */
+
+#ifndef __DMA_STREAM_H__
+#define __DMA_STREAM_H__
+
+#include "stm32f070xx.h"
+
+typedef struct dma_stream_s dma_stream_t;
+
+/* Evento "metade pronta": half = 0/1, data aponta para o início da metade,
+   items = nº de itens (na largura MSIZE do canal). Chamado no contexto da ISR. */
+typedef void (*dma_stream_cb_t)(dma_stream_t *st, uint8_t half,
+                                void *data, uint16_t items, void *ctx);
+
+struct dma_stream_s {
+  uint8_t   ch;                 /* canal do dma_router (1..5) */
+  uint8_t   item_size;          /* 1, 2 ou 4 bytes (MSIZE) */
+  uint16_t  half_items;         /* itens por metade */
+  uint8_t  *buf;
+
+  volatile uint8_t  ready;      /* bitmap: metades prontas ainda não lidas via dma_stream_get */
+  volatile uint8_t  owned;      /* bitmap: metades entregues e não devolvidas */
+  volatile uint8_t  next_half;  /* metade que o DMA deve completar em seguida */
+
+  /* estatísticas */
+  volatile uint32_t halves;     /* metades completadas pelo DMA */
+  volatile uint32_t overruns;   /* metade começou a ser reescrita antes do release */
+  volatile uint32_t dropped;    /* metades perdidas (eventos HT/TC atrasados/fora de ordem) */
+
+  dma_stream_cb_t cb;           /* NULL: consumo por dma_stream_get() no loop principal */
+  void           *ctx;
+  void          (*on_error)(uint32_t dma_flags, void *ctx);
+};
+
+/* Inicia o stream: buf com 'items' itens (par), CPAR = registrador do periférico.
+   cfg define direção/tamanhos/prioridade; circular e HT/TC são forçados aqui.
+   O canal é anexado ao dma_router (substitui callback anterior do canal). */
+bool dma_stream_start(dma_stream_t *st, uint8_t ch, uint32_t cpar,
+                      void *buf, uint16_t items,
+                      const dma_router_chan_cfg_t *cfg,
+                      dma_stream_cb_t cb, void *ctx);
+
+void dma_stream_stop(dma_stream_t *st);
+
+/* Devolve a metade ao DMA (consumidor terminou de usar os dados) */
+static inline void dma_stream_release(dma_stream_t *st, uint8_t half){
+  uint32_t pm = irq_lock();
+  st->owned &= (uint8_t)~(1u << (half & 1u));
+  irq_unlock(pm);
+}
+
+/* Consumo no loop principal (cb == NULL): retorna a metade pronta mais antiga
+   ou -1 se não houver. A metade continua "owned" até dma_stream_release(). */
+int8_t dma_stream_get(dma_stream_t *st, void **data, uint16_t *items);
+
+#endif /* __DMA_STREAM_H__ */
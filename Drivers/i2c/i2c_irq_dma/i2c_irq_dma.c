@@ -47,26 +47,15 @@ static void i2c_finish(i2c_drv_t *d, i2c_xfer_err_t err)
     if (d->on_complete) d->on_complete(d, err, d->cb_ctx);
 }
 
+/* CCR fixos (8 bits, prioridade alta, só TE); CPAR gravado em set_dma_channels */
+#define I2C_TX_DMA_CCR  DMA_ROUTER_CCR(/*m2p*/1, 0, /*minc*/1, 0, 0, 0, /*prio*/2, /*tc*/0, 0, /*te*/1)
+#define I2C_RX_DMA_CCR  DMA_ROUTER_CCR(/*m2p*/0, 0, /*minc*/1, 0, 0, 0, /*prio*/2, /*tc*/0, 0, /*te*/1)
+
 /* DMA TX: mem->periph 8-bit → TXDR */
 static bool i2c_dma_start_tx(i2c_drv_t *d, const uint8_t *buf, size_t len)
 {
-    if (d->dma_ch_tx < 1 || d->dma_ch_tx > 7) return false;
-
-    dma_router_chan_cfg_t cfg = {
-        .mem_to_periph = 1,
-        .circular = 0,
-        .minc = 1,
-        .pinc = 0,
-        .msize_bits = 0,  /* 8-bit */
-        .psize_bits = 0,  /* 8-bit */
-        .priority   = 2,  /* HIGH */
-        .irq_tc = 0, .irq_ht = 0, .irq_te = 1
-    };
-    if (!dma_router_start(d->dma_ch_tx,
-                          (uint32_t)&d->i2c->TXDR,
-                          (uint32_t)buf,
-                          (uint16_t)len, &cfg)) return false;
-
+    /* canal fora de 1..5 (F070): o router recusa e o erro sobe */
+    if (!dma_router_restart(d->dma_ch_tx, (uint32_t)buf, (uint16_t)len)) return false;
     d->i2c->CR1 |= I2C_CR1_TxDMAEN;
     return true;
 }
@@ -74,23 +63,8 @@ static bool i2c_dma_start_tx(i2c_drv_t *d, const uint8_t *buf, size_t len)
 /* DMA RX: periph->mem 8-bit ← RXDR */
 static bool i2c_dma_start_rx(i2c_drv_t *d, uint8_t *buf, size_t len)
 {
-    if (d->dma_ch_rx < 1 || d->dma_ch_rx > 7) return false;
-
-    dma_router_chan_cfg_t cfg = {
-        .mem_to_periph = 0,
-        .circular = 0,
-        .minc = 1,
-        .pinc = 0,
-        .msize_bits = 0,  /* 8-bit */
-        .psize_bits = 0,  /* 8-bit */
-        .priority   = 2,
-        .irq_tc = 0, .irq_ht = 0, .irq_te = 1
-    };
-    if (!dma_router_start(d->dma_ch_rx,
-                          (uint32_t)&d->i2c->RXDR,
-                          (uint32_t)buf,
-                          (uint16_t)len, &cfg)) return false;
-
+    /* canal fora de 1..5 (F070): o router recusa e o erro sobe */
+    if (!dma_router_restart(d->dma_ch_rx, (uint32_t)buf, (uint16_t)len)) return false;
     d->i2c->CR1 |= I2C_CR1_RxDMAEN;
     return true;
 }
@@ -130,8 +104,15 @@ void i2c_irqdma_init(i2c_drv_t *d, I2C_TypeDef *i2c,
 /* ===== Seleção de canais DMA ===== */
 void i2c_irqdma_set_dma_channels(i2c_drv_t *d, uint8_t ch_tx, uint8_t ch_rx)
 {
-    d->dma_ch_tx = ch_tx;
-    d->dma_ch_rx = ch_rx;
+    /* reserva no dma_router; canal com outro dono fica 0 (start com DMA recusa) */
+    if (d->dma_ch_tx && d->dma_ch_tx != ch_tx) dma_router_release(d->dma_ch_tx, d);
+    if (d->dma_ch_rx && d->dma_ch_rx != ch_rx) dma_router_release(d->dma_ch_rx, d);
+    d->dma_ch_tx = dma_router_claim(ch_tx, d) ? ch_tx : 0;
+    d->dma_ch_rx = dma_router_claim(ch_rx, d) ? ch_rx : 0;
+
+    /* CCR/CPAR fixos: cada transferência só recarrega CMAR/CNDTR */
+    if (d->dma_ch_tx) dma_router_prepare_ccr(d->dma_ch_tx, (uint32_t)&d->i2c->TXDR, I2C_TX_DMA_CCR);
+    if (d->dma_ch_rx) dma_router_prepare_ccr(d->dma_ch_rx, (uint32_t)&d->i2c->RXDR, I2C_RX_DMA_CCR);
 }
 
 /* ===== Start ===== */
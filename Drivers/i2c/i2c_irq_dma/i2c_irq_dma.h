@@ -64,6 +64,7 @@ void i2c_irqdma_init(i2c_drv_t *d, I2C_TypeDef *i2c,
                      uint8_t own7bit_addr_or_0,
                      uint8_t irq_prio_0to3);
 
+/* Chamar depois de i2c_irqdma_init (prepara CPAR = TXDR/RXDR da instância) */
 void i2c_irqdma_set_dma_channels(i2c_drv_t *d, uint8_t ch_tx, uint8_t ch_rx);
 
 bool i2c_irqdma_start(i2c_drv_t *d, uint8_t addr7,
@@ -0,0 +1,193 @@
+#include "modbus_rtu.h"
+
+static inline uint16_t be16(const uint8_t *p){ return (uint16_t)((p[0] << 8) | p[1]); }
+static inline void put_be16(uint8_t *p, uint16_t v){ p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v; }
+
+static inline bool bit_get(const uint8_t *b, uint32_t i){ return (b[i >> 3] >> (i & 7u)) & 1u; }
+static inline void bit_put(uint8_t *b, uint32_t i, bool v){
+  if (v) b[i >> 3] |= (uint8_t)(1u << (i & 7u)); else b[i >> 3] &= (uint8_t)~(1u << (i & 7u));
+}
+
+/* tabela do tipo que contém [addr, addr + qty) inteiro */
+static const mb_table_t *find_table(const mb_config_t *cfg, mb_kind_t kind, uint16_t addr, uint16_t qty){
+  for (uint8_t i = 0; i < cfg->n_tables; i++) {
+    const mb_table_t *t = &cfg->tables[i];
+    if (t->kind == kind && addr >= t->start &&
+        (uint32_t)addr + qty <= (uint32_t)t->start + t->count) return t;
+  }
+  return NULL;
+}
+
+/* ===== Funções =====
+   Cada uma recebe o PDU depois do código (p, n bytes) e escreve os dados da
+   resposta em r (depois do código). Retorna bytes escritos ou 0x100 | exceção. */
+#define EXC(e)   (0x100u | (e))
+
+static uint32_t fc_read_bits(const mb_config_t *cfg, mb_kind_t kind, const uint8_t *p, uint32_t n, uint8_t *r){
+  if (n != 4u) return EXC(MB_EX_ILLEGAL_VALUE);
+  uint16_t addr = be16(p), qty = be16(p + 2);
+  if (qty < 1u || qty > 2000u) return EXC(MB_EX_ILLEGAL_VALUE);
+  const mb_table_t *t = find_table(cfg, kind, addr, qty);
+  if (!t) return EXC(MB_EX_ILLEGAL_ADDRESS);
+  if (t->on_read) { uint8_t e = t->on_read(addr, qty, t->ctx); if (e) return EXC(e); }
+
+  uint32_t nb = (qty + 7u) >> 3, off = addr - t->start;
+  const uint8_t *src = (const uint8_t*)t->data;
+  r[0] = (uint8_t)nb;
+  memset(&r[1], 0, nb);
+  if ((off & 7u) == 0u) {                         /* alinhado: cópia de bytes */
+    memcpy(&r[1], &src[off >> 3], nb);
+    if (qty & 7u) r[nb] &= (uint8_t)((1u << (qty & 7u)) - 1u);
+  } else {
+    for (uint32_t i = 0; i < qty; i++) if (bit_get(src, off + i)) r[1 + (i >> 3)] |= (uint8_t)(1u << (i & 7u));
+  }
+  return 1u + nb;
+}
+
+static uint32_t fc_read_regs(const mb_config_t *cfg, mb_kind_t kind, const uint8_t *p, uint32_t n, uint8_t *r){
+  if (n != 4u) return EXC(MB_EX_ILLEGAL_VALUE);
+  uint16_t addr = be16(p), qty = be16(p + 2);
+  if (qty < 1u || qty > 125u) return EXC(MB_EX_ILLEGAL_VALUE);
+  const mb_table_t *t = find_table(cfg, kind, addr, qty);
+  if (!t) return EXC(MB_EX_ILLEGAL_ADDRESS);
+  if (t->on_read) { uint8_t e = t->on_read(addr, qty, t->ctx); if (e) return EXC(e); }
+
+  const uint16_t *src = (const uint16_t*)t->data + (addr - t->start);
+  r[0] = (uint8_t)(qty * 2u);
+  for (uint32_t i = 0; i < qty; i++) put_be16(&r[1 + 2u * i], src[i]);
+  return 1u + 2u * qty;
+}
+
+static uint32_t fc_write_coil(const mb_config_t *cfg, const uint8_t *p, uint32_t n, uint8_t *r){
+  if (n != 4u) return EXC(MB_EX_ILLEGAL_VALUE);
+  uint16_t addr = be16(p), v = be16(p + 2);
+  if (v != 0xFF00u && v != 0x0000u) return EXC(MB_EX_ILLEGAL_VALUE);
+  const mb_table_t *t = find_table(cfg, MB_COILS, addr, 1u);
+  if (!t) return EXC(MB_EX_ILLEGAL_ADDRESS);
+  bit_put((uint8_t*)t->data, addr - t->start, v != 0u);
+  if (t->on_write) { uint8_t e = t->on_write(addr, 1u, t->ctx); if (e) return EXC(e); }
+  memcpy(r, p, 4u);                               /* eco */
+  return 4u;
+}
+
+static uint32_t fc_write_reg(const mb_config_t *cfg, const uint8_t *p, uint32_t n, uint8_t *r){
+  if (n != 4u) return EXC(MB_EX_ILLEGAL_VALUE);
+  uint16_t addr = be16(p);
+  const mb_table_t *t = find_table(cfg, MB_HOLDING_REGS, addr, 1u);
+  if (!t) return EXC(MB_EX_ILLEGAL_ADDRESS);
+  ((uint16_t*)t->data)[addr - t->start] = be16(p + 2);
+  if (t->on_write) { uint8_t e = t->on_write(addr, 1u, t->ctx); if (e) return EXC(e); }
+  memcpy(r, p, 4u);
+  return 4u;
+}
+
+static uint32_t fc_write_coils(const mb_config_t *cfg, const uint8_t *p, uint32_t n, uint8_t *r){
+  if (n < 5u) return EXC(MB_EX_ILLEGAL_VALUE);
+  uint16_t addr = be16(p), qty = be16(p + 2);
+  uint32_t nb = p[4];
+  if (qty < 1u || qty > 1968u || nb != ((qty + 7u) >> 3) || n != 5u + nb) return EXC(MB_EX_ILLEGAL_VALUE);
+  const mb_table_t *t = find_table(cfg, MB_COILS, addr, qty);
+  if (!t) return EXC(MB_EX_ILLEGAL_ADDRESS);
+  uint8_t *dst = (uint8_t*)t->data;
+  uint32_t off = addr - t->start;
+  for (uint32_t i = 0; i < qty; i++) bit_put(dst, off + i, bit_get(&p[5], i));
+  if (t->on_write) { uint8_t e = t->on_write(addr, qty, t->ctx); if (e) return EXC(e); }
+  memcpy(r, p, 4u);
+  return 4u;
+}
+
+static uint32_t fc_write_regs(const mb_config_t *cfg, const uint8_t *p, uint32_t n, uint8_t *r){
+  if (n < 5u) return EXC(MB_EX_ILLEGAL_VALUE);
+  uint16_t addr = be16(p), qty = be16(p + 2);
+  uint32_t nb = p[4];
+  if (qty < 1u || qty > 123u || nb != 2u * qty || n != 5u + nb) return EXC(MB_EX_ILLEGAL_VALUE);
+  const mb_table_t *t = find_table(cfg, MB_HOLDING_REGS, addr, qty);
+  if (!t) return EXC(MB_EX_ILLEGAL_ADDRESS);
+  uint16_t *dst = (uint16_t*)t->data + (addr - t->start);
+  for (uint32_t i = 0; i < qty; i++) dst[i] = be16(&p[5 + 2u * i]);
+  if (t->on_write) { uint8_t e = t->on_write(addr, qty, t->ctx); if (e) return EXC(e); }
+  memcpy(r, p, 4u);
+  return 4u;
+}
+
+uint32_t modbus_process(const mb_config_t *cfg, const uint8_t *adu, uint32_t len, uint8_t *rsp){
+  if (len < 2u) return 0;
+  uint8_t fc = adu[1];
+  const uint8_t *p = &adu[2];
+  uint32_t n = len - 2u, k;
+
+  switch (fc) {
+    case 0x01: k = fc_read_bits(cfg, MB_COILS, p, n, &rsp[2]);           break;
+    case 0x02: k = fc_read_bits(cfg, MB_DISCRETE_INPUTS, p, n, &rsp[2]); break;
+    case 0x03: k = fc_read_regs(cfg, MB_HOLDING_REGS, p, n, &rsp[2]);    break;
+    case 0x04: k = fc_read_regs(cfg, MB_INPUT_REGS, p, n, &rsp[2]);      break;
+    case 0x05: k = fc_write_coil(cfg, p, n, &rsp[2]);                    break;
+    case 0x06: k = fc_write_reg(cfg, p, n, &rsp[2]);                     break;
+    case 0x0F: k = fc_write_coils(cfg, p, n, &rsp[2]);                   break;
+    case 0x10: k = fc_write_regs(cfg, p, n, &rsp[2]);                    break;
+    default:   k = EXC(MB_EX_ILLEGAL_FUNCTION);                          break;
+  }
+
+  if (adu[0] == 0u) return 0;                     /* broadcast: executa e não responde */
+
+  rsp[0] = adu[0];
+  if (k & 0x100u) { rsp[1] = (uint8_t)(fc | 0x80u); rsp[2] = (uint8_t)k; k = 1u; }
+  else            { rsp[1] = fc; }
+  k += 2u;
+  uint16_t crc = crc16_modbus(0xFFFFu, rsp, k);
+  rsp[k] = (uint8_t)crc; rsp[k + 1u] = (uint8_t)(crc >> 8);
+  return k + 2u;
+}
+
+/* ===== Enlace ===== */
+static void tx_done(const void *buf, void *ctx){
+  (void)buf;
+  ((mb_slave_t*)ctx)->tx_busy = 0;
+}
+
+/* t3,5 (RTOF): junta os trechos do DMA, confere, responde */
+static void on_frame(usart_drv_t *u, uint32_t cause){
+  mb_slave_t *mb = (mb_slave_t*)u;              /* u é o 1º membro */
+  if (!(cause & UDRV_FRAME_RTO)) return;
+
+  udrv_span_t sp[2];
+  uint32_t len = usart_rx_peek(u, sp);
+  if (!len) return;
+  mb->frames++;
+  if (len > MB_ADU_MAX || len < 4u || mb->tx_busy) { usart_rx_consume(u, len); mb->dropped++; return; }
+
+  memcpy(mb->req, sp[0].ptr, sp[0].len);
+  if (sp[1].len) memcpy(&mb->req[sp[0].len], sp[1].ptr, sp[1].len);
+  usart_rx_consume(u, len);
+
+  uint8_t a = mb->req[0];
+  if (a != mb->cfg.addr && a != 0u) return;       /* outro escravo: nem confere CRC */
+  if (crc16_modbus(0xFFFFu, mb->req, len) != 0u) { mb->crc_err++; return; }
+
+  mb->handled++;
+  uint32_t n = modbus_process(&mb->cfg, mb->req, len - 2u, mb->rsp);
+  if (!n) return;
+  if (mb->rsp[1] & 0x80u) mb->exceptions++;
+  mb->tx_busy = 1;
+  if (!usart_write_ref(u, mb->rsp, n, tx_done, mb)) mb->tx_busy = 0;
+}
+
+bool modbus_init(mb_slave_t *mb, USART_TypeDef *inst, uint32_t pclk_hz,
+                 const usart_drv_config_t *ucfg, const mb_config_t *cfg)
+{
+  memset(mb, 0, sizeof(*mb));
+  mb->cfg = *cfg;
+
+  usart_drv_config_t c = *ucfg;
+  c.rx_engine = UDRV_ENGINE_DMA;
+  c.tx_engine = UDRV_ENGINE_DMA;
+  c.rx_frame  = UDRV_FRAME_RTO;
+  c.rto_bits  = (c.baud > 19200u) ? (uint32_t)(((uint64_t)c.baud * 1750u + 999999u) / 1000000u) : 39u;
+  c.mute      = 0;
+
+  crc_init();
+  usart_init(&mb->u, inst, pclk_hz, &c, mb->rx_dma, sizeof mb->rx_dma, mb->tx_ring, sizeof mb->tx_ring);
+  if (!mb->u.inst || mb->u.cfg.rx_engine != UDRV_ENGINE_DMA || mb->u.cfg.tx_engine != UDRV_ENGINE_DMA) return false;
+  usart_set_frame_callback(&mb->u, on_frame);
+  return true;
+}
@@ -0,0 +1,93 @@
+/*
+ * modbus_rtu.h
+ *
+ *  Escravo Modbus RTU sobre usart_irq_dma.
+ *  - Fim de frame (t3,5) pelo receiver timeout da USART (RTOR/RTOF), sem TIM:
+ *    até 19200 bd, 3,5 caracteres de 11 bits; acima, 1,75 ms (como a norma).
+ *    O F070 tem RTO na USART1 (e USART2, conforme o RM): use uma delas.
+ *  - RX e TX por DMA. A requisição é tratada no próprio callback de frame
+ *    (ISR da USART) e a resposta sai por usart_write_ref do buffer interno:
+ *    o tempo de virada é o do processamento, sem passar pelo loop principal.
+ *  - CRC-16/MODBUS por tabela (crc16_modbus): a unidade de CRC do F070 tem
+ *    polinômio fixo de 32 bits.
+ *  - Tabelas declaradas estaticamente pelo usuário (const), cada uma com
+ *    armazenamento próprio e callbacks opcionais:
+ *      on_read:  antes de ler (atualiza data[]); retorna 0 ou código de exceção.
+ *      on_write: depois de gravar em data[]; retorna 0 ou código de exceção
+ *                (para rejeitar, restaure o valor anterior no callback).
+ *    Os callbacks rodam na ISR da USART.
+ *  - Funções: 01, 02, 03, 04, 05, 06, 15, 16. Broadcast (endereço 0) executa
+ *    as escritas sem responder.
+ *  - RS-485: combine com rs485 = 1 no usart_drv_config_t (DE por hardware).
+ *    O /RE do transceiver deve seguir o DE (o escravo não pode ouvir o próprio eco).
+ */
+
+#ifndef __MODBUS_RTU_H__
+#define __MODBUS_RTU_H__
+
+#include "usart_irq_dma.h"
+#include "crc.h"
+
+/* ADU RTU máxima: endereço + PDU (253) + CRC */
+#define MB_ADU_MAX          256u
+
+/* Exceções */
+#define MB_EX_ILLEGAL_FUNCTION   0x01u
+#define MB_EX_ILLEGAL_ADDRESS    0x02u
+#define MB_EX_ILLEGAL_VALUE      0x03u
+#define MB_EX_DEVICE_FAILURE     0x04u
+
+typedef enum {
+	MB_COILS = 0,          /* bits leitura/escrita  (01, 05, 15) */
+	MB_DISCRETE_INPUTS,    /* bits só leitura       (02) */
+	MB_INPUT_REGS,         /* registros só leitura  (04) */
+	MB_HOLDING_REGS        /* registros leitura/escrita (03, 06, 16) */
+} mb_kind_t;
+
+typedef uint8_t (*mb_access_cb_t)(uint16_t addr, uint16_t count, void *ctx);
+
+/* data: uint16_t[count] para registros; uint8_t[(count+7)/8] para bits (LSB = start) */
+typedef struct {
+	mb_kind_t      kind;
+	uint16_t       start;
+	uint16_t       count;
+	void          *data;
+	mb_access_cb_t on_read;
+	mb_access_cb_t on_write;
+	void          *ctx;
+} mb_table_t;
+
+typedef struct {
+	uint8_t           addr;        /* 1..247 */
+	const mb_table_t *tables;
+	uint8_t           n_tables;
+} mb_config_t;
+
+/* O handle da USART é o primeiro membro: o callback de frame acha o escravo por ele */
+typedef struct {
+	usart_drv_t     u;
+	mb_config_t     cfg;
+	uint8_t         rx_dma[MB_ADU_MAX];
+	uint8_t         tx_ring[16];             /* não usado pelo caminho de resposta (write_ref) */
+	uint8_t         req[MB_ADU_MAX];
+	uint8_t         rsp[MB_ADU_MAX];
+	volatile uint8_t tx_busy;
+
+	/* estatísticas */
+	volatile uint32_t frames;       /* frames fechados por t3,5 */
+	volatile uint32_t crc_err;
+	volatile uint32_t handled;      /* requisições para este endereço (ou broadcast) */
+	volatile uint32_t exceptions;
+	volatile uint32_t dropped;      /* frame curto/longo ou chegou com resposta em envio */
+} mb_slave_t;
+
+/* ucfg: baud, paridade, stop bits, RS-485, prioridade NVIC. O stack força
+   RX/TX por DMA e o fechamento por RTO. false se não houver DMA disponível. */
+bool modbus_init(mb_slave_t *mb, USART_TypeDef *inst, uint32_t pclk_hz,
+                 const usart_drv_config_t *ucfg, const mb_config_t *cfg);
+
+/* Processa um ADU (sem CRC verificado aqui) e monta a resposta em rsp (com CRC).
+   Retorna o tamanho da resposta (0 = sem resposta). Exposto para teste. */
+uint32_t modbus_process(const mb_config_t *cfg, const uint8_t *adu, uint32_t len, uint8_t *rsp);
+
+#endif /* __MODBUS_RTU_H__ */
@@ -0,0 +1,129 @@
+#ifdef HOST_SIM
+
+#include "sim_nor.h"
+
+#define NOR_PAGE      256u
+#define NOR_BFPT_PTR  0x30u
+#define NOR_BFPT_DW   16u
+
+static uint8_t s_sfdp[NOR_BFPT_PTR + 4u * NOR_BFPT_DW];
+
+static void put32(uint8_t *p, uint32_t v){ p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24); }
+
+/* SFDP: cabeçalho + 1 parameter header + BFPT em 0x30 */
+static void build_sfdp(const sim_nor_t *n){
+  memset(s_sfdp, 0xFF, sizeof s_sfdp);
+  const uint8_t hdr[16] = { 'S','F','D','P', 0x06, 0x01, 0x00, 0xFF,
+                            0x00, 0x06, 0x01, NOR_BFPT_DW, NOR_BFPT_PTR, 0x00, 0x00, 0xFF };
+  memcpy(s_sfdp, hdr, sizeof hdr);
+
+  uint8_t *b = &s_sfdp[NOR_BFPT_PTR];
+  memset(b, 0, 4u * NOR_BFPT_DW);
+  uint32_t amode = (n->size > (1u << 24)) ? 1u : 0u;           /* 3 ou 4 bytes */
+  put32(b + 0,  0x01u | 0x04u | (0x20u << 8) | (amode << 17)); /* DW1: 4K=0x20 */
+  put32(b + 4,  n->size * 8u - 1u);                            /* DW2: densidade em bits - 1 */
+  put32(b + 28, 0x0Cu | (0x20u << 8) | (0x0Fu << 16) | (0x52u << 24));  /* DW8: 4K, 32K */
+  put32(b + 32, 0x10u | (0xD8u << 8));                         /* DW9: 64K */
+  put32(b + 40, 0x08u << 4);                                   /* DW11: página 2^8 */
+}
+
+void sim_nor_init(sim_nor_t *n, uint8_t *mem, uint32_t size, uint8_t mfr, uint8_t type){
+  memset(n, 0, sizeof(*n));
+  n->mem = mem; n->size = size;
+  memset(mem, 0xFF, size);
+  uint8_t cap = 0;
+  while ((1u << cap) < size) cap++;
+  n->jedec[0] = mfr; n->jedec[1] = type; n->jedec[2] = cap;
+  build_sfdp(n);
+}
+
+static inline bool nor_busy(const sim_nor_t *n){ return sim_cycles() < n->busy_until; }
+
+static void nor_erase(sim_nor_t *n, uint32_t sz, uint32_t t){
+  uint32_t a = n->addr & (n->size - 1u) & ~(sz - 1u);
+  memset(&n->mem[a], 0xFF, sz);
+  n->busy_until = sim_cycles() + t;
+  n->n_erase++;
+}
+
+/* comandos que executam na subida do CS */
+void sim_nor_select(sim_nor_t *n, bool selected){
+  if (selected) { n->sel = 1; n->pos = 0; n->cmd = 0; n->addr = 0; return; }
+  if (!n->sel) return;
+  n->sel = 0;
+
+  uint32_t alen = n->addr4 ? 4u : 3u;
+  if (!n->wel) return;
+  switch (n->cmd) {
+    case 0x02: if (n->pos > 1u + alen) { n->busy_until = sim_cycles() + SIM_NOR_T_PP; n->n_pp++; n->wel = 0; } break;
+    case 0x20: if (n->pos == 1u + alen) { nor_erase(n, 4096u, SIM_NOR_T_SE);    n->wel = 0; } break;
+    case 0x52: if (n->pos == 1u + alen) { nor_erase(n, 32768u, SIM_NOR_T_BE32); n->wel = 0; } break;
+    case 0xD8: if (n->pos == 1u + alen) { nor_erase(n, 65536u, SIM_NOR_T_BE64); n->wel = 0; } break;
+    case 0x60: case 0xC7:
+      if (n->pos == 1u) {
+        memset(n->mem, 0xFF, n->size);
+        n->busy_until = sim_cycles() + (uint64_t)SIM_NOR_T_BE64 * (n->size >> 16);
+        n->n_erase++; n->wel = 0;
+      }
+      break;
+    default: break;
+  }
+}
+
+uint16_t sim_nor_spi(SPI_TypeDef *inst, uint16_t mosi, void *ctx){
+  (void)inst;
+  sim_nor_t *n = (sim_nor_t*)ctx;
+  if (!n->sel) return 0xFFu;
+
+  uint32_t p = n->pos++;
+  uint8_t  b = (uint8_t)mosi;
+
+  if (p == 0u) {
+    if (nor_busy(n) && b != 0x05u) { n->cmd = 0xFFu; n->n_ignored++; return 0xFFu; }
+    n->cmd = b;
+    switch (b) {
+      case 0x06: n->wel = 1; break;
+      case 0x04: n->wel = 0; break;
+      case 0xB7: n->addr4 = 1; break;
+      case 0xE9: n->addr4 = 0; break;
+      case 0x05: n->n_rdsr++; break;
+      default: break;
+    }
+    return 0xFFu;
+  }
+
+  switch (n->cmd) {
+    case 0x9F: return (p <= 3u) ? n->jedec[p - 1u] : 0xFFu;
+    case 0x05: return (uint8_t)((nor_busy(n) ? 0x01u : 0u) | (n->wel ? 0x02u : 0u));
+    default: break;
+  }
+
+  uint32_t alen = (n->cmd == 0x5Au) ? 3u : (n->addr4 ? 4u : 3u);
+  if (p <= alen) {
+    n->addr = (n->addr << 8) | b;
+    if (p == alen && n->cmd == 0x02u) n->page_base = n->addr & ~(NOR_PAGE - 1u);
+    return 0xFFu;
+  }
+
+  uint32_t k = p - alen - 1u;                 /* byte de dados (0 = primeiro) */
+  switch (n->cmd) {
+    case 0x03:
+      return n->mem[(n->addr + k) & (n->size - 1u)];
+    case 0x0B:
+      if (k == 0u) return 0xFFu;              /* dummy */
+      return n->mem[(n->addr + k - 1u) & (n->size - 1u)];
+    case 0x5A:
+      if (k == 0u || n->sfdp_off) return 0xFFu;
+      return (n->addr + k - 1u < sizeof s_sfdp) ? s_sfdp[n->addr + k - 1u] : 0xFFu;
+    case 0x02:
+      if (n->wel) {
+        uint32_t a = (n->page_base + ((n->addr + k) & (NOR_PAGE - 1u))) & (n->size - 1u);
+        n->mem[a] &= b;
+      }
+      return 0xFFu;
+    default:
+      return 0xFFu;
+  }
+}
+
+#endif /* HOST_SIM */
@@ -0,0 +1,63 @@
+/*
+ * sim_nor.h
+ *
+ *  Flash SPI NOR simulada para o host (escravo do modelo de SPI em sim_periph).
+ *  - Comandos: 9F (JEDEC ID), 5A (SFDP), 05 (RDSR), 06/04 (WREN/WRDI),
+ *    03/0B (READ/FAST READ), 02 (PP, volta no fim da página), 20/52/D8
+ *    (erase 4K/32K/64K), 60/C7 (chip), B7/E9 (modo 4 bytes).
+ *  - SFDP com cabeçalho, um parameter header e a BFPT (JESD216B, 16 DWORDs):
+ *    densidade, tipos de erase, tamanho de página, modo de endereço.
+ *  - WIP com tempo em ciclos simulados (sim_cycles); ocupada, só RDSR responde.
+ *    Programação só leva bits de 1 para 0, como o chip real.
+ *  - O CS não passa pelo modelo de SPI: os callbacks de CS da aplicação chamam
+ *    sim_nor_select().
+ */
+
+#ifndef __SIM_NOR_H__
+#define __SIM_NOR_H__
+
+#include "sim_periph.h"
+
+#ifdef HOST_SIM
+
+/* tempos típicos (ciclos de HCLK a 48 MHz) */
+#ifndef SIM_NOR_T_PP
+#define SIM_NOR_T_PP        (48000u * 7u / 10u)   /* 0,7 ms por página */
+#endif
+#ifndef SIM_NOR_T_SE
+#define SIM_NOR_T_SE        (48000u * 45u)        /* 45 ms / 4K */
+#endif
+#ifndef SIM_NOR_T_BE32
+#define SIM_NOR_T_BE32      (48000u * 120u)
+#endif
+#ifndef SIM_NOR_T_BE64
+#define SIM_NOR_T_BE64      (48000u * 150u)
+#endif
+
+typedef struct {
+	uint8_t  *mem;
+	uint32_t  size;           /* potência de 2 */
+	uint8_t   jedec[3];
+	uint8_t   addr4;          /* modo 4 bytes (B7) */
+	uint8_t   sfdp_off;       /* 1: sem SFDP (5A devolve 0xFF) */
+
+	/* estado do comando */
+	uint8_t   sel;
+	uint8_t   cmd;
+	uint32_t  pos;            /* bytes do comando atual (inclui opcode) */
+	uint32_t  addr;
+	uint8_t   wel;
+	uint64_t  busy_until;
+	uint32_t  page_base;      /* PP: início da página */
+
+	/* estatísticas */
+	uint32_t  n_pp, n_erase, n_rdsr, n_ignored;
+} sim_nor_t;
+
+/* mem precisa ter size bytes; começa apagada (0xFF) */
+void     sim_nor_init(sim_nor_t *n, uint8_t *mem, uint32_t size, uint8_t mfr, uint8_t type);
+void     sim_nor_select(sim_nor_t *n, bool selected);
+uint16_t sim_nor_spi(SPI_TypeDef *inst, uint16_t mosi, void *ctx);   /* p/ sim_spi_set_slave */
+
+#endif /* HOST_SIM */
+#endif /* __SIM_NOR_H__ */
@@ -0,0 +1,1081 @@
+#ifdef HOST_SIM
+
+#define _GNU_SOURCE                 /* REG_RIP/REG_EFL/REG_ERR no ucontext */
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include "sim_periph.h"
+
+/* ===== Memória dos periféricos (bases de stm32f070xx.h / core_m0.h) ===== */
+#define SIM_APB_BYTES    0x28000u   /* 0x40000000..0x40027FFF (APB, DMA, RCC, FLASH, CRC) */
+#define SIM_AHB2_BYTES   0x1800u    /* 0x48000000..0x480017FF (GPIO) */
+#define SIM_SCS_BYTES    0x1000u    /* 0xE000E000..0xE000EFFF (SysTick, NVIC, SCB) */
+#define SIM_SPI_BYTES    0x1000u    /* SPI1 em +0, SPI2 em +0x400: uma página, protegida */
+
+uint32_t sim_apb_mem[SIM_APB_BYTES / 4u];
+uint32_t sim_ahb2_mem[SIM_AHB2_BYTES / 4u];
+uint32_t sim_scs_mem[SIM_SCS_BYTES / 4u];
+uint32_t sim_spi_mem[SIM_SPI_BYTES / 4u] __attribute__((aligned(SIM_SPI_BYTES)));
+volatile uint32_t sim_primask = 0;
+
+/* Handlers dos drivers: weak para linkar só com os drivers usados */
+#define SIM_WEAK __attribute__((weak))
+void DMA1_CH1_IRQHandler(void)   SIM_WEAK;
+void DMA1_CH2_3_IRQHandler(void) SIM_WEAK;
+void DMA1_CH4_5_IRQHandler(void) SIM_WEAK;
+void ADC_IRQHandler(void)        SIM_WEAK;
+void SPI1_IRQHandler(void)       SIM_WEAK;
+void SPI2_IRQHandler(void)       SIM_WEAK;
+void USART1_IRQHandler(void)     SIM_WEAK;
+void USART2_IRQHandler(void)     SIM_WEAK;
+void USART3_4_5_6_IRQHandler(void) SIM_WEAK;
+void SysTick_Handler(void)       SIM_WEAK;
+
+/* TDR "vazio": qualquer outro valor é uma escrita da CPU/DMA ainda não consumida */
+#define SIM_EMPTY        0xFFFFFFFFu
+/* bit reservado mantido em 1 no ADC ISR: se a CPU escrever (w1c), ele some */
+#define SIM_ADC_ISR_MARK (1u << 31)
+
+/* bits usados do USART */
+#define U_CR1_UE      (1u << 0)
+#define U_CR1_RE      (1u << 2)
+#define U_CR1_TE      (1u << 3)
+#define U_CR1_IDLEIE  (1u << 4)
+#define U_CR1_RXNEIE  (1u << 5)
+#define U_CR1_TCIE    (1u << 6)
+#define U_CR1_TXEIE   (1u << 7)
+#define U_CR1_WAKE    (1u << 11)
+#define U_CR1_MME     (1u << 13)
+#define U_CR1_CMIE    (1u << 14)
+#define U_CR1_RTOIE   (1u << 26)
+#define U_CR2_ADDM7   (1u << 4)
+#define U_CR2_RTOEN   (1u << 23)
+#define U_RQR_MMRQ    (1u << 2)
+#define U_CR3_EIE     (1u << 0)
+#define U_CR3_DMAR    (1u << 6)
+#define U_CR3_DMAT    (1u << 7)
+#define U_CR3_DEM     (1u << 14)
+#define U_ISR_FE      (1u << 1)
+#define U_ISR_NF      (1u << 2)
+#define U_ISR_ORE     (1u << 3)
+#define U_ISR_IDLE    (1u << 4)
+#define U_ISR_RXNE    (1u << 5)
+#define U_ISR_TC      (1u << 6)
+#define U_ISR_TXE     (1u << 7)
+#define U_ISR_RTOF    (1u << 11)
+#define U_ISR_CMF     (1u << 17)
+#define U_ISR_RWU     (1u << 19)
+
+/* bits usados do SPI */
+#define S_CR1_SPE     (1u << 6)
+#define S_CR1_CRCL    (1u << 11)
+#define S_CR1_CRCNEXT (1u << 12)
+#define S_CR1_CRCEN   (1u << 13)
+#define S_CR2_RXDMAEN (1u << 0)
+#define S_CR2_TXDMAEN (1u << 1)
+#define S_CR2_ERRIE   (1u << 5)
+#define S_CR2_RXNEIE  (1u << 6)
+#define S_CR2_TXEIE   (1u << 7)
+#define S_CR2_FRXTH   (1u << 12)
+#define S_SR_RXNE     (1u << 0)
+#define S_SR_TXE      (1u << 1)
+#define S_SR_CRCERR   (1u << 4)
+#define S_SR_MODF     (1u << 5)
+#define S_SR_OVR      (1u << 6)
+#define S_SR_BSY      (1u << 7)
+#define S_SR_ERR      (S_SR_CRCERR | S_SR_MODF | S_SR_OVR)
+
+/* ===== Estado ===== */
+typedef struct {
+    USART_TypeDef   *r;
+    IRQn_Type        irqn;
+    void           (*handler)(void);
+    uint16_t         rxq[SIM_UART_RXQ_LEN];
+    uint32_t         q_head, q_tail;
+    uint32_t         rx_left;      /* ciclos até o frame em curso chegar */
+    uint32_t         idle_left;    /* ciclos de linha parada até IDLE */
+    bool             idle_armed;
+    uint32_t         rto_left;     /* ciclos de silêncio até RTOF */
+    bool             rto_armed;
+    bool             mute;         /* MME: descartando até o endereço do nó */
+    bool             tx_busy;
+    uint16_t         tx_shift;
+    uint32_t         tx_left;
+    bool             de;           /* RS-485: DE ativo (DEM) */
+    uint32_t         de_left;      /* ciclos de DEDT até soltar DE */
+    sim_uart_tx_cb_t tx_cb;
+    void            *tx_ctx;
+    sim_uart_stats_t st;
+} sim_uart_t;
+
+typedef struct {
+    SPI_TypeDef       *r;
+    IRQn_Type          irqn;
+    void             (*handler)(void);
+    uint16_t           txf[4], rxf[4];
+    uint8_t            txn, rxn;
+    bool               busy;
+    uint16_t           shift;
+    uint32_t           left;
+    uint32_t           err;          /* OVR/CRCERR/MODF */
+    /* CRC: TXCRC/RXCRC sobre os frames de dados; fase de CRC após o último */
+    uint16_t           crc_tx, crc_rx, crc_got;
+    uint16_t           crc_out[2];
+    uint8_t            crc_out_n;    /* frames de CRC ainda por deslocar */
+    uint8_t            crc_out_i;
+    uint8_t            crc_in_n;     /* frames de CRC ainda por receber */
+    bool               crc_arm;      /* DMA TX entregou o último item */
+    bool               shift_crc;    /* frame em curso é de CRC */
+    sim_spi_slave_cb_t slave;
+    void              *slave_ctx;
+    sim_spi_stats_t    st;
+} sim_spi_t;
+
+typedef struct {
+    uint32_t isr;          /* ISR "verdadeiro" (sem a marca) */
+    bool     ready_given;  /* ADRDY já sinalizado neste enable */
+    bool     converting;
+    int8_t   ch;           /* canal em conversão */
+    uint32_t left;
+    uint16_t ramp;
+    sim_adc_source_t src;
+    void    *src_ctx;
+} sim_adc_t;
+
+typedef struct {
+    bool     en;
+    uint32_t par, mar;        /* ponteiros internos (avançam com PINC/MINC) */
+    uint32_t par_reg, mar_reg, ndt;  /* último valor visto nos registradores */
+    uint16_t reload;
+    sim_dma_stats_t st;
+} sim_dma_ch_t;
+
+#define SIM_N_UART   4               /* USART1..USART4 */
+#define SIM_N_SPI    2
+
+static sim_uart_t   s_uart[SIM_N_UART];
+static sim_spi_t    s_spi[SIM_N_SPI];
+static sim_adc_t    s_adc;
+static sim_dma_ch_t s_dma[6];        /* 1..5 */
+static uint32_t     s_dma_credit;
+static uint32_t     s_nvic_en;
+static uint32_t     s_systick_pend;
+static uint64_t     s_now;
+static uintptr_t    s_hi;            /* 32 bits altos dos endereços da imagem */
+
+/* ===== Endereços de 32 bits → ponteiros do host ===== */
+static inline void *sim_ptr(uint32_t a){ return (void*)(s_hi | (uintptr_t)a); }
+
+static sim_uart_t *uart_of(const USART_TypeDef *r){
+    for (int i = 0; i < SIM_N_UART; i++) if (s_uart[i].r == r) return &s_uart[i];
+    return NULL;
+}
+static sim_spi_t *spi_of(const SPI_TypeDef *r){
+    for (int i = 0; i < SIM_N_SPI; i++) if (s_spi[i].r == r) return &s_spi[i];
+    return NULL;
+}
+
+/* ============================================================
+   USART
+   ============================================================ */
+static uint32_t uart_bit_cycles(const USART_TypeDef *r){
+    uint32_t brr = r->BRR;
+    uint32_t bit = (r->CR1 & (1u << 15)) ? (((brr >> 4) << 3) + (brr & 7u)) : brr;  /* OVER8 */
+    return bit ? bit : 1u;
+}
+
+/* bits de dado (M1:M0 = 10 → 7, 00 → 8, 01 → 9); com paridade o último é o de paridade */
+static uint32_t uart_data_mask(const USART_TypeDef *r){
+    uint32_t m = (r->CR1 & (1u << 28)) ? 0x7Fu : (r->CR1 & (1u << 12)) ? 0x1FFu : 0xFFu;
+    return (r->CR1 & (1u << 10)) ? (m >> 1) : m;
+}
+
+/* mute por address mark: true se o frame deve ser descartado */
+static bool uart_muted(sim_uart_t *u, uint16_t d){
+    USART_TypeDef *r = u->r;
+    if ((r->CR1 & (U_CR1_MME | U_CR1_WAKE)) != (U_CR1_MME | U_CR1_WAKE)) return false;
+    uint32_t mask = uart_data_mask(r), msb = (mask + 1u) >> 1;
+    if (d & msb) {
+        uint32_t am  = (r->CR2 & U_CR2_ADDM7) ? 0x7Fu : 0x0Fu;
+        u->mute = ((d & am) != ((r->CR2 >> 24) & am));
+    }
+    if (u->mute) r->ISR |= U_ISR_RWU; else r->ISR &= ~U_ISR_RWU;
+    return u->mute;
+}
+
+static uint32_t uart_frame_cycles(const USART_TypeDef *r){
+    uint32_t bit = uart_bit_cycles(r);
+    uint32_t bits = 10u;                              /* start + 8 + stop */
+    if (r->CR1 & (1u << 12)) bits++;                  /* M0: 9 bits */
+    if (r->CR1 & (1u << 28)) bits--;                  /* M1: 7 bits */
+    if (((r->CR2 >> 12) & 3u) == 2u) bits++;          /* 2 stop */
+    return bits * bit;
+}
+
+/* DEAT/DEDT: amostras de 1/16 de bit (1/8 com OVER8) */
+static uint32_t uart_de_cycles(const USART_TypeDef *r, uint32_t pos){
+    uint32_t bit = uart_bit_cycles(r);
+    uint32_t n = (r->CR1 >> pos) & 0x1Fu;
+    return (r->CR1 & (1u << 15)) ? (n * bit) / 8u : (n * bit) / 16u;
+}
+
+static void uart_tx_load(sim_uart_t *u){
+    USART_TypeDef *r = u->r;
+    u->tx_shift = (uint16_t)r->TDR;
+    r->TDR      = SIM_EMPTY;
+    u->tx_busy  = true;
+    u->tx_left  = uart_frame_cycles(r);
+    r->ISR     &= ~U_ISR_TC;
+    if ((r->CR3 & U_CR3_DEM) && !u->de) {               /* DE sobe DEAT antes do start bit */
+        u->de = true;
+        u->tx_left += uart_de_cycles(r, 21);
+    }
+    u->de_left = 0;
+}
+
+static void uart_apply(sim_uart_t *u){
+    USART_TypeDef *r = u->r;
+    if (r->ICR) { r->ISR &= ~r->ICR; r->ICR = 0; }
+    if (r->RQR & U_RQR_MMRQ) { if (r->CR1 & U_CR1_MME) { u->mute = true; r->ISR |= U_ISR_RWU; } }
+    r->RQR = 0;
+    if (r->TDR != SIM_EMPTY && !u->tx_busy && (r->CR1 & U_CR1_UE) && (r->CR1 & U_CR1_TE)) uart_tx_load(u);
+    if (r->TDR == SIM_EMPTY) r->ISR |= U_ISR_TXE; else r->ISR &= ~U_ISR_TXE;
+}
+
+static void uart_step(sim_uart_t *u, uint32_t cyc){
+    USART_TypeDef *r = u->r;
+    if (!(r->CR1 & U_CR1_UE)) return;
+
+    /* TX: TDR → shifter → linha */
+    if (r->CR1 & U_CR1_TE) {
+        uint32_t c = cyc;
+        while (c) {
+            if (!u->tx_busy) {
+                if (r->TDR == SIM_EMPTY) break;
+                uart_tx_load(u);
+            }
+            if (u->tx_left > c) { u->tx_left -= c; break; }
+            c -= u->tx_left;
+            u->tx_busy = false;
+            u->st.tx_frames++;
+            if (u->tx_cb) u->tx_cb(r, (uint16_t)(u->tx_shift & uart_data_mask(r)), u->tx_ctx);
+            if (r->TDR == SIM_EMPTY) {
+                r->ISR |= U_ISR_TC;
+                if (u->de) u->de_left = uart_de_cycles(r, 16) + 1u;   /* DE cai DEDT após TC */
+            }
+        }
+    }
+    if (u->de) {
+        u->st.de_cycles += cyc;
+        if (u->de_left) {
+            if (u->de_left > cyc) u->de_left -= cyc;
+            else { u->de_left = 0; u->de = false; }
+        }
+    }
+
+    /* RX: um frame da fila a cada tempo de frame; IDLE após 1 frame parado */
+    if (r->CR1 & U_CR1_RE) {
+        if (u->q_head != u->q_tail) {
+            if (!u->rx_left) u->rx_left = uart_frame_cycles(r);
+            if (u->rx_left > cyc) {
+                u->rx_left -= cyc;
+            } else {
+                u->rx_left = 0;
+                uint16_t d = (uint16_t)(u->rxq[u->q_tail] & uart_data_mask(r));
+                u->q_tail = (u->q_tail + 1u) % SIM_UART_RXQ_LEN;
+                u->st.rx_frames++;
+                if (!uart_muted(u, d)) {                                   /* em mute: descartado em hardware */
+                    if (r->ISR & U_ISR_RXNE) { r->ISR |= U_ISR_ORE; u->st.rx_overruns++; }  /* frame perdido */
+                    else                     { r->RDR = d; r->ISR |= U_ISR_RXNE; }
+                    if ((uint8_t)d == (uint8_t)(r->CR2 >> 24)) r->ISR |= U_ISR_CMF;  /* character match */
+                    u->idle_left  = uart_frame_cycles(r);
+                    u->idle_armed = true;
+                    u->rto_left   = (r->RTOR & 0xFFFFFFu) * uart_bit_cycles(r);
+                    u->rto_armed  = (r->CR2 & U_CR2_RTOEN) != 0;
+                }
+            }
+        } else {
+            if (u->idle_armed) {
+                if (u->idle_left > cyc) u->idle_left -= cyc;
+                else { u->idle_armed = false; r->ISR |= U_ISR_IDLE; }
+            }
+            if (u->rto_armed) {
+                if (u->rto_left > cyc) u->rto_left -= cyc;
+                else { u->rto_armed = false; r->ISR |= U_ISR_RTOF; }
+            }
+        }
+    }
+
+    if (r->TDR == SIM_EMPTY) r->ISR |= U_ISR_TXE; else r->ISR &= ~U_ISR_TXE;
+}
+
+static bool uart_irq(const sim_uart_t *u){
+    const USART_TypeDef *r = u->r;
+    uint32_t isr = r->ISR, cr1 = r->CR1, cr3 = r->CR3;
+    return ((isr & U_ISR_RXNE) && (cr1 & U_CR1_RXNEIE)) ||
+           ((isr & U_ISR_TXE)  && (cr1 & U_CR1_TXEIE))  ||
+           ((isr & U_ISR_TC)   && (cr1 & U_CR1_TCIE))   ||
+           ((isr & U_ISR_IDLE) && (cr1 & U_CR1_IDLEIE)) ||
+           ((isr & U_ISR_RTOF) && (cr1 & U_CR1_RTOIE))  ||
+           ((isr & U_ISR_CMF)  && (cr1 & U_CR1_CMIE))   ||
+           ((isr & U_ISR_ORE)  && ((cr1 & U_CR1_RXNEIE) || (cr3 & U_CR3_EIE))) ||
+           ((isr & (U_ISR_FE | U_ISR_NF)) && (cr3 & U_CR3_EIE));
+}
+
+/* ============================================================
+   SPI (mestre; DR acessado pelo DMA ou pela CPU, ver spi_trap_segv)
+   ============================================================ */
+static inline uint8_t spi_item_bytes(const SPI_TypeDef *r){
+    return (((r->CR2 >> 8) & 0xFu) + 1u > 8u) ? 2u : 1u;
+}
+
+static void spi_update_sr(sim_spi_t *s){
+    SPI_TypeDef *r = s->r;
+    uint8_t  ib  = spi_item_bytes(r);
+    uint32_t rxb = (uint32_t)s->rxn * ib, txb = (uint32_t)s->txn * ib;
+    uint32_t need = (ib == 1u && !(r->CR2 & S_CR2_FRXTH)) ? 2u : 1u;
+    uint32_t sr = s->err;
+
+    if (s->rxn >= need)      sr |= S_SR_RXNE;
+    if (txb <= 2u)           sr |= S_SR_TXE;
+    bool crc_due = (r->CR1 & S_CR1_CRCEN) && (s->crc_arm || (r->CR1 & S_CR1_CRCNEXT));   /* CRC ainda por sair */
+    if (s->busy || s->txn || s->crc_out_n || crc_due) sr |= S_SR_BSY;
+    sr |= ((rxb > 3u ? 3u : rxb) << 9);    /* FRLVL */
+    sr |= ((txb > 3u ? 3u : txb) << 11);   /* FTLVL */
+    r->SR = sr;
+}
+
+/* CRC do F0: não refletido, init 0, polinômio do CRCPR; frame MSB primeiro.
+   TXCRC/RXCRC zeram com CRCEN 0→1 (escrita da CPU no CR1, ver spi_trap_step) */
+static uint16_t spi_crc_upd(const SPI_TypeDef *r, uint16_t crc, uint16_t v, uint32_t bits){
+    uint32_t len = (r->CR1 & S_CR1_CRCL) ? 16u : 8u;
+    uint16_t top = (uint16_t)(1u << (len - 1u)), poly = (uint16_t)r->CRCPR;
+    while (bits--) {
+        bool b = (((v >> bits) & 1u) != 0u) ^ ((crc & top) != 0u);
+        crc = (uint16_t)(crc << 1);
+        if (b) crc ^= poly;
+    }
+    return (len == 8u) ? (uint16_t)(crc & 0xFFu) : crc;
+}
+
+static void spi_crc_reset(sim_spi_t *s){
+    s->crc_tx = s->crc_rx = s->crc_got = 0;
+    s->crc_out_n = s->crc_in_n = s->crc_out_i = 0;
+    s->crc_arm = s->shift_crc = false;
+}
+
+/* TXFIFO vazio após o último dado (CRCNEXT ou fim do DMA TX): o TXCRC vai em
+   1 frame, ou 2 (byte alto primeiro) com CRC-16 e dados de 8 bits */
+static void spi_crc_start(sim_spi_t *s, uint32_t bits){
+    SPI_TypeDef *r = s->r;
+    uint8_t n = ((r->CR1 & S_CR1_CRCL) && bits <= 8u) ? 2u : 1u;
+    if (n == 2u) { s->crc_out[0] = s->crc_tx >> 8; s->crc_out[1] = s->crc_tx & 0xFFu; }
+    else         { s->crc_out[0] = s->crc_tx; }
+    s->crc_out_n = s->crc_in_n = n;
+    s->crc_out_i = 0;
+    s->crc_got = 0;
+    s->crc_arm = false;
+    r->CR1 &= ~S_CR1_CRCNEXT;            /* o hardware limpa ao entrar na fase */
+}
+
+static void spi_step(sim_spi_t *s, uint32_t cyc){
+    SPI_TypeDef *r = s->r;
+    if (r->CR1 & S_CR1_SPE) {
+        uint8_t  ib  = spi_item_bytes(r);
+        uint8_t  cap = (uint8_t)(4u / ib);
+        uint32_t bits = ((r->CR2 >> 8) & 0xFu) + 1u;
+        uint16_t mask = (uint16_t)((1u << bits) - 1u);
+        uint32_t c = cyc;
+        while (c) {
+            if (!s->busy) {
+                if (!s->txn && !s->crc_out_n && (r->CR1 & S_CR1_CRCEN) &&
+                    (s->crc_arm || (r->CR1 & S_CR1_CRCNEXT))) spi_crc_start(s, bits);
+                if (s->txn) {
+                    s->shift = s->txf[0];
+                    for (uint8_t i = 1; i < s->txn; i++) s->txf[i-1] = s->txf[i];
+                    s->txn--;
+                    s->shift_crc = false;
+                } else if (s->crc_out_n) {
+                    s->shift = s->crc_out[s->crc_out_i++];
+                    s->crc_out_n--;
+                    s->shift_crc = true;
+                } else break;
+                s->busy = true;
+                s->left = bits * (2u << ((r->CR1 >> 3) & 7u));   /* fPCLK / 2^(BR+1) */
+            }
+            if (s->left > c) { s->left -= c; break; }
+            c -= s->left;
+            s->busy = false;
+            uint16_t miso = s->slave ? s->slave(r, s->shift, s->slave_ctx) : s->shift;
+            miso &= mask;
+            s->st.frames++;
+            if (s->shift_crc) {
+                /* CRC do escravo: conferido com o RXCRC e também vai para o RXFIFO */
+                s->crc_got = (uint16_t)((s->crc_got << bits) | miso);
+                if (--s->crc_in_n == 0u) {
+                    if (s->crc_got != s->crc_rx) { s->err |= S_SR_CRCERR; s->st.crc_errors++; }
+                    s->crc_got = 0;
+                }
+            } else if (r->CR1 & S_CR1_CRCEN) {
+                s->crc_tx = spi_crc_upd(r, s->crc_tx, s->shift & mask, bits);
+                s->crc_rx = spi_crc_upd(r, s->crc_rx, miso, bits);
+            }
+            if (s->rxn < cap) s->rxf[s->rxn++] = miso;
+            else              s->err |= S_SR_OVR;
+        }
+    }
+    spi_update_sr(s);
+}
+
+static void spi_push(sim_spi_t *s, uint16_t v){
+    uint8_t cap = (uint8_t)(4u / spi_item_bytes(s->r));
+    if (s->txn < cap) s->txf[s->txn++] = v;
+    else              s->st.tx_dropped++;
+    spi_update_sr(s);
+}
+
+static uint16_t spi_pop(sim_spi_t *s){
+    uint16_t v = 0;
+    if (s->rxn) {
+        v = s->rxf[0];
+        for (uint8_t i = 1; i < s->rxn; i++) s->rxf[i-1] = s->rxf[i];
+        s->rxn--;
+    }
+    spi_update_sr(s);
+    return v;
+}
+
+/* último item do DMA TX no DR: com CRCEN e TXDMAEN, o CRC segue os dados */
+static void spi_dma_tx_last(uint32_t par){
+    void *p = sim_ptr(par);
+    for (int i = 0; i < SIM_N_SPI; i++) {
+        SPI_TypeDef *r = s_spi[i].r;
+        if (p == (void*)&r->DR && (r->CR1 & S_CR1_CRCEN) && (r->CR2 & S_CR2_TXDMAEN)) s_spi[i].crc_arm = true;
+    }
+}
+
+static bool spi_irq(const sim_spi_t *s){
+    const SPI_TypeDef *r = s->r;
+    uint32_t sr = r->SR, cr2 = r->CR2;
+    return ((sr & S_SR_RXNE) && (cr2 & S_CR2_RXNEIE)) ||
+           ((sr & S_SR_TXE)  && (cr2 & S_CR2_TXEIE))  ||
+           ((sr & S_SR_ERR) && (cr2 & S_CR2_ERRIE));
+}
+
+/* ------------------------------------------------------------
+   Acessos da CPU ao SPI. Enquanto roda código de driver/aplicação, a página
+   de sim_spi_mem fica sem permissão: cada acesso gera SIGSEGV, o modelo faz a
+   parte de antes, a instrução roda sozinha (TF) e o SIGTRAP faz a de depois.
+     DR lido:    1 ou 2 frames saem do RXFIFO (pelo tamanho do acesso)
+     DR escrito: o valor entra no TXFIFO (16 bits com dados de 8: 2 frames)
+     SR lido:    avança um quantum antes (laços de espera da CPU)
+     SR escrito: só o CRCERR muda (rc_w0)
+     CR1:        CRCEN 0→1 zera TXCRC/RXCRC
+   O próprio modelo roda com a página liberada (s_spi_open > 0).
+   ------------------------------------------------------------ */
+#if defined(__x86_64__)
+#define SIM_REG_PC  REG_RIP
+#elif defined(__i386__)
+#define SIM_REG_PC  REG_EIP
+#else
+#error "sim_periph: o acesso da CPU ao SPI usa SIGSEGV + single-step de x86"
+#endif
+#define SIM_EFL_TF  0x100u                   /* trap flag */
+#define SIM_PF_WRITE 0x2u                    /* código de erro do page fault: escrita */
+
+static void sim_advance(uint32_t cycles, bool irqs);
+
+static int s_spi_open;
+static struct {
+    sim_spi_t *s;
+    uint32_t   off;      /* registrador (offset no SPI_TypeDef) */
+    uint32_t   pre;      /* valor antes da instrução */
+    uint8_t    size;     /* bytes do acesso ao DR */
+    bool       wr;
+} s_acc;
+
+static void spi_mem_open(void){
+    if (s_spi_open++ == 0) mprotect(sim_spi_mem, SIM_SPI_BYTES, PROT_READ | PROT_WRITE);
+}
+static void spi_mem_close(void){
+    if (--s_spi_open == 0) mprotect(sim_spi_mem, SIM_SPI_BYTES, PROT_NONE);
+}
+
+/* handler de driver chamado pelo modelo: roda com a página protegida */
+static void cpu_call(void (*h)(void)){
+    int d = s_spi_open;
+    if (d) { s_spi_open = 1; spi_mem_close(); }
+    h();
+    if (d) { spi_mem_open(); s_spi_open = d; }
+}
+
+/* bytes de memória acessados pela instrução em pc (mov/movzx/ALU gerados
+   para registradores volatile); 0 se desconhecida */
+static uint8_t x86_mem_size(const uint8_t *pc){
+    bool o16 = false, w = false;
+    for (;; pc++) {
+        uint8_t b = *pc;
+        if (b == 0x66u) o16 = true;
+        else if (b == 0x67u || b == 0xF0u || b == 0xF2u || b == 0xF3u || b == 0x26u ||
+                 b == 0x2Eu || b == 0x36u || b == 0x3Eu || b == 0x64u || b == 0x65u) continue;
+#if defined(__x86_64__)
+        else if ((b & 0xF0u) == 0x40u) w = (b & 8u) != 0u;      /* REX */
+#endif
+        else break;
+    }
+    uint8_t full = o16 ? 2u : (w ? 8u : 4u), op = pc[0];
+    if (op == 0x0Fu) {
+        if (pc[1] == 0xB6u || pc[1] == 0xBEu) return 1u;         /* movzx/movsx r, m8 */
+        if (pc[1] == 0xB7u || pc[1] == 0xBFu) return 2u;         /* movzx/movsx r, m16 */
+        return 0u;
+    }
+    if (op < 0x40u && (op & 7u) < 4u) return (op & 1u) ? full : 1u;   /* ALU r/m */
+    switch (op) {
+    case 0x80: case 0x84: case 0x86: case 0x88: case 0x8A: case 0xC6: case 0xF6: return 1u;
+    case 0x81: case 0x83: case 0x85: case 0x87: case 0x89: case 0x8B: case 0xC7: case 0xF7: return full;
+    default: return 0u;
+    }
+}
+
+static void spi_trap_segv(int sig, siginfo_t *si, void *ctx){
+    ucontext_t *uc = (ucontext_t*)ctx;
+    uintptr_t a = (uintptr_t)si->si_addr, base = (uintptr_t)sim_spi_mem;
+    if (a - base >= SIM_N_SPI * 0x400u) { signal(sig, SIG_DFL); return; }   /* falha de verdade */
+
+    spi_mem_open();
+    sim_spi_t   *s = &s_spi[(a - base) / 0x400u];
+    SPI_TypeDef *r = s->r;
+    s_acc.s    = s;
+    s_acc.off  = (uint32_t)(a - (uintptr_t)r) & ~3u;
+    s_acc.wr   = (uc->uc_mcontext.gregs[REG_ERR] & SIM_PF_WRITE) != 0;
+    s_acc.size = 0;
+
+    if (s_acc.off == offsetof(SPI_TypeDef, DR)) {
+        s_acc.size = x86_mem_size((const uint8_t*)uc->uc_mcontext.gregs[SIM_REG_PC]);
+        if (!s_acc.size) { fprintf(stderr, "sim: acesso ao SPI DR não decodificado\n"); abort(); }
+        if (!s_acc.wr) {
+            uint16_t v = spi_pop(s);
+            if (s_acc.size >= 2u && spi_item_bytes(r) == 1u) v = (uint16_t)((v & 0xFFu) | (spi_pop(s) << 8));
+            r->DR = v;
+            s->err &= ~S_SR_OVR;             /* leitura de DR seguida de SR (o driver sempre lê SR) */
+            spi_update_sr(s);
+            s->st.cpu_reads++;
+        }
+    } else if (s_acc.off == offsetof(SPI_TypeDef, SR) && !s_acc.wr) {
+        sim_advance(SIM_QUANTUM_CYCLES, false);
+    }
+    s_acc.pre = *(volatile uint32_t*)((uintptr_t)r + s_acc.off);
+    uc->uc_mcontext.gregs[REG_EFL] |= SIM_EFL_TF;
+}
+
+static void spi_trap_step(int sig, siginfo_t *si, void *ctx){
+    (void)si;
+    ucontext_t *uc = (ucontext_t*)ctx;
+    if (!s_acc.s) { signal(sig, SIG_DFL); raise(sig); return; }
+    uc->uc_mcontext.gregs[REG_EFL] &= ~SIM_EFL_TF;
+
+    sim_spi_t   *s = s_acc.s;
+    SPI_TypeDef *r = s->r;
+    uint32_t now = *(volatile uint32_t*)((uintptr_t)r + s_acc.off);
+    s_acc.s = NULL;
+
+    if (s_acc.off == offsetof(SPI_TypeDef, DR) && s_acc.wr) {
+        uint16_t v = (s_acc.size == 1u) ? (uint16_t)(now & 0xFFu) : (uint16_t)now;
+        s->st.cpu_writes++;
+        if (s_acc.size >= 2u && spi_item_bytes(r) == 1u) { spi_push(s, v & 0xFFu); spi_push(s, v >> 8); }
+        else                                              spi_push(s, v);
+    } else if (s_acc.off == offsetof(SPI_TypeDef, SR) && now != s_acc.pre) {
+        if (!(now & S_SR_CRCERR)) s->err &= ~S_SR_CRCERR;
+        spi_update_sr(s);
+    } else if (s_acc.off == offsetof(SPI_TypeDef, CR1) && !(s_acc.pre & S_CR1_CRCEN) && (now & S_CR1_CRCEN)) {
+        spi_crc_reset(s);
+    }
+    spi_mem_close();
+}
+
+static void spi_trap_install(void){
+    static bool done;
+    if (done) return;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = spi_trap_segv; sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = spi_trap_step; sigaction(SIGTRAP, &sa, NULL);
+    done = true;
+}
+
+/* ============================================================
+   ADC
+   ============================================================ */
+static uint32_t adc_conv_cycles(void){
+    /* tempo de amostragem (meios ciclos) + 12.5 ciclos de conversão */
+    static const uint16_t k_smp_half[8] = { 3, 15, 27, 57, 83, 111, 143, 479 };
+    uint32_t half = k_smp_half[ADC1->SMPR & 7u] + 25u;
+    return (uint32_t)(((uint64_t)half * SIM_HCLK_HZ) / (2ull * SIM_ADC_CLK_HZ));
+}
+
+static int8_t adc_next_ch(int8_t from){
+    uint32_t sel = ADC1->CHSELR & 0x7FFFFu;
+    bool down = (ADC1->CFGR1 & ADC_CFGR1_SCANDIR) != 0;
+    for (int8_t c = (int8_t)(down ? from - 1 : from + 1); c >= 0 && c <= 18; c = (int8_t)(down ? c - 1 : c + 1)) {
+        if (sel & (1u << c)) return c;
+    }
+    return -1;
+}
+
+static void adc_apply(void){
+    ADC_TypeDef *r = ADC1;
+    if (!(r->ISR & SIM_ADC_ISR_MARK)) s_adc.isr &= ~r->ISR;     /* CPU escreveu (w1c) */
+
+    if (r->CR & ADC_CR_ADCAL) r->CR &= ~ADC_CR_ADCAL;             /* calibração instantânea */
+    if (r->CR & ADC_CR_ADSTP) { r->CR &= ~(ADC_CR_ADSTP | ADC_CR_ADSTART); s_adc.converting = false; }
+    if (r->CR & ADC_CR_ADDIS) {
+        r->CR &= ~(ADC_CR_ADDIS | ADC_CR_ADEN | ADC_CR_ADSTART);
+        s_adc.converting = false;
+    }
+    if (r->CR & ADC_CR_ADEN) {
+        if (!s_adc.ready_given) { s_adc.isr |= ADC_ISR_ADRDY; s_adc.ready_given = true; }
+    } else {
+        s_adc.ready_given = false;
+    }
+    r->ISR = s_adc.isr | SIM_ADC_ISR_MARK;
+}
+
+static void adc_step(uint32_t cyc){
+    ADC_TypeDef *r = ADC1;
+    if (!(r->CR & ADC_CR_ADEN) || !(r->CR & ADC_CR_ADSTART)) { s_adc.converting = false; return; }
+
+    while (cyc) {
+        if (!s_adc.converting) {
+            bool down = (r->CFGR1 & ADC_CFGR1_SCANDIR) != 0;
+            s_adc.ch = adc_next_ch(down ? 19 : -1);
+            if (s_adc.ch < 0) return;
+            s_adc.converting = true;
+            s_adc.left = adc_conv_cycles();
+        }
+        if (s_adc.left > cyc) { s_adc.left -= cyc; break; }
+        cyc -= s_adc.left;
+
+        uint16_t v = s_adc.src ? s_adc.src((uint8_t)s_adc.ch, s_adc.src_ctx) : (uint16_t)(s_adc.ramp++ & 0xFFFu);
+        v = (uint16_t)((v & 0xFFFu) >> (2u * ((r->CFGR1 & ADC_CFGR1_RES_Msk) >> ADC_CFGR1_RES_Pos)));
+        if (s_adc.isr & ADC_ISR_EOC) {
+            s_adc.isr |= ADC_ISR_OVR;
+            if (r->CFGR1 & ADC_CFGR1_OVRMOD) r->DR = v;            /* sobrescreve */
+        } else {
+            r->DR = v;
+        }
+        s_adc.isr |= ADC_ISR_EOC;
+
+        int8_t nx = adc_next_ch(s_adc.ch);
+        if (nx < 0) {
+            s_adc.isr |= ADC_ISR_EOS;
+            if (!(r->CFGR1 & ADC_CFGR1_CONT)) { r->CR &= ~ADC_CR_ADSTART; s_adc.converting = false; break; }
+            s_adc.converting = false;                              /* recomeça a sequência */
+        } else {
+            s_adc.ch = nx;
+            s_adc.left = adc_conv_cycles();
+        }
+    }
+    r->ISR = s_adc.isr | SIM_ADC_ISR_MARK;
+}
+
+/* ============================================================
+   Barramento visto pelo DMA (registradores de dados com efeito colateral)
+   ============================================================ */
+static bool bus_read(uint32_t a, uint32_t size, uint32_t *v){
+    if (!a) return false;
+    void *p = sim_ptr(a);
+    for (int i = 0; i < SIM_N_UART; i++) {
+        if (p == (void*)&s_uart[i].r->RDR) {
+            *v = s_uart[i].r->RDR;
+            s_uart[i].r->ISR &= ~U_ISR_RXNE;
+            return true;
+        }
+    }
+    for (int i = 0; i < SIM_N_SPI; i++)
+        if (p == (void*)&s_spi[i].r->DR) { *v = spi_pop(&s_spi[i]); return true; }
+    if (p == (void*)&ADC1->DR) {
+        *v = ADC1->DR;
+        s_adc.isr &= ~ADC_ISR_EOC;
+        ADC1->ISR = s_adc.isr | SIM_ADC_ISR_MARK;
+        return true;
+    }
+    if (size == 4u)      *v = *(volatile uint32_t*)p;
+    else if (size == 2u) *v = *(volatile uint16_t*)p;
+    else                 *v = *(volatile uint8_t*)p;
+    return true;
+}
+
+static bool bus_write(uint32_t a, uint32_t size, uint32_t v){
+    if (!a) return false;
+    void *p = sim_ptr(a);
+    for (int i = 0; i < SIM_N_UART; i++)
+        if (p == (void*)&s_uart[i].r->TDR) { s_uart[i].r->TDR = v & 0x1FFu; s_uart[i].r->ISR &= ~U_ISR_TXE; return true; }
+    for (int i = 0; i < SIM_N_SPI; i++)
+        if (p == (void*)&s_spi[i].r->DR)   { spi_push(&s_spi[i], (uint16_t)v); return true; }
+    if (size == 4u)      *(volatile uint32_t*)p = v;
+    else if (size == 2u) *(volatile uint16_t*)p = (uint16_t)v;
+    else                 *(volatile uint8_t*)p  = (uint8_t)v;
+    return true;
+}
+
+/* ============================================================
+   DMA1
+   ============================================================ */
+static bool dma_request(const DMA_Channel_TypeDef *C, const sim_dma_ch_t *s){
+    uint32_t ccr = C->CCR;
+    if (ccr & DMA_CCR_MEM2MEM) return true;
+
+    bool m2p = (ccr & DMA_CCR_DIR) != 0;
+    void *p = sim_ptr(s->par);
+    for (int i = 0; i < SIM_N_UART; i++) {
+        USART_TypeDef *u = s_uart[i].r;
+        if (p == (void*)&u->TDR) return m2p && (u->CR3 & U_CR3_DMAT) && (u->CR1 & U_CR1_UE) && (u->TDR == SIM_EMPTY);
+        if (p == (void*)&u->RDR) return !m2p && (u->CR3 & U_CR3_DMAR) && (u->ISR & U_ISR_RXNE);
+    }
+    for (int i = 0; i < SIM_N_SPI; i++) {
+        SPI_TypeDef *sp = s_spi[i].r;
+        if (p == (void*)&sp->DR) {
+            if (!(sp->CR1 & S_CR1_SPE)) return false;
+            return m2p ? ((sp->CR2 & S_CR2_TXDMAEN) && (sp->SR & S_SR_TXE))
+                       : ((sp->CR2 & S_CR2_RXDMAEN) && (sp->SR & S_SR_RXNE));
+        }
+    }
+    if (p == (void*)&ADC1->DR) return !m2p && (ADC1->CFGR1 & ADC_CFGR1_DMAEN) && (s_adc.isr & ADC_ISR_EOC);
+    return false;   /* periférico sem modelo: canal nunca recebe requisição */
+}
+
+static void dma_apply(void){
+    uint32_t ifcr = DMA1->IFCR;
+    if (ifcr) {
+        uint32_t clr = ifcr;
+        for (uint8_t n = 1; n <= 5; n++) if (ifcr & DMA_GIF(n)) clr |= 0xFu << (4u * (n - 1u));
+        DMA1->ISR &= ~clr;
+        DMA1->IFCR = 0;
+    }
+
+    /* EN, ou reprogramação com EN=1 entre dois passos (CNDTR/CMAR/CPAR mudaram) */
+    for (uint8_t n = 1; n <= 5; n++) {
+        DMA_Channel_TypeDef *C = DMA1_CHANNEL(n);
+        sim_dma_ch_t *s = &s_dma[n];
+        if (!(C->CCR & DMA_CCR_EN)) { s->en = false; continue; }
+        if (!s->en || C->CNDTR != s->ndt || C->CMAR != s->mar_reg || C->CPAR != s->par_reg) {
+            s->en = true;
+            s->par = s->par_reg = C->CPAR;
+            s->mar = s->mar_reg = C->CMAR;
+            s->ndt = C->CNDTR & 0xFFFFu;
+            s->reload = (uint16_t)s->ndt;
+        }
+    }
+}
+
+static void dma_flag(uint8_t n, uint32_t f){ DMA1->ISR |= f | DMA_GIF(n); }
+
+static void dma_beat(uint8_t n){
+    DMA_Channel_TypeDef *C = DMA1_CHANNEL(n);
+    sim_dma_ch_t *s = &s_dma[n];
+    uint32_t ccr = C->CCR;
+    uint32_t psz = 1u << ((ccr >> DMA_CCR_PSIZE_Pos) & 3u);
+    uint32_t msz = 1u << ((ccr >> DMA_CCR_MSIZE_Pos) & 3u);
+    bool m2p = (ccr & DMA_CCR_DIR) && !(ccr & DMA_CCR_MEM2MEM);
+
+    uint32_t v = 0;
+    bool ok = m2p ? (bus_read(s->mar, msz, &v) && bus_write(s->par, psz, v))
+                  : (bus_read(s->par, psz, &v) && bus_write(s->mar, msz, v));
+    if (!ok) {                                   /* TE: hardware desliga o canal */
+        C->CCR &= ~DMA_CCR_EN; s->en = false;
+        dma_flag(n, DMA_TEIF(n));
+        return;
+    }
+    if (ccr & DMA_CCR_PINC) s->par += psz;
+    if (ccr & DMA_CCR_MINC) s->mar += msz;
+
+    s->ndt--;
+    C->CNDTR = s->ndt;
+    if (!s->ndt && m2p) spi_dma_tx_last(C->CPAR);
+    s->st.beats++;
+    s->st.bus_cycles += SIM_DMA_BEAT_CYCLES;
+
+    if (s->reload >= 2u && (uint32_t)(s->reload - s->ndt) == (uint32_t)(s->reload / 2u)) dma_flag(n, DMA_HTIF(n));
+    if (!s->ndt) {
+        dma_flag(n, DMA_TCIF(n));
+        if (ccr & DMA_CCR_CIRC) {
+            s->ndt = s->reload; C->CNDTR = s->ndt;
+            s->par = C->CPAR;   s->mar = C->CMAR;
+        }
+    }
+}
+
+static void dma_step(uint32_t cyc){
+    s_dma_credit += cyc;
+    while (s_dma_credit >= SIM_DMA_BEAT_CYCLES) {
+        /* arbitragem: maior PL, depois menor número de canal */
+        uint8_t best = 0; uint32_t best_pl = 0;
+        for (uint8_t n = 1; n <= 5; n++) {
+            const DMA_Channel_TypeDef *C = DMA1_CHANNEL(n);
+            const sim_dma_ch_t *s = &s_dma[n];
+            if (!s->en || !s->ndt || !dma_request(C, s)) continue;
+            uint32_t pl = (C->CCR >> DMA_CCR_PL_Pos) & 3u;
+            if (!best || pl > best_pl) { best = n; best_pl = pl; }
+        }
+        if (!best) { s_dma_credit = 0; return; }   /* ocioso não acumula crédito */
+        dma_beat(best);
+        s_dma_credit -= SIM_DMA_BEAT_CYCLES;
+    }
+}
+
+static bool dma_irq(uint8_t first, uint8_t last){
+    uint32_t isr = DMA1->ISR;
+    for (uint8_t n = first; n <= last; n++) {
+        uint32_t ccr = DMA1_CHANNEL(n)->CCR;
+        if (((isr & DMA_TCIF(n)) && (ccr & DMA_CCR_TCIE)) ||
+            ((isr & DMA_HTIF(n)) && (ccr & DMA_CCR_HTIE)) ||
+            ((isr & DMA_TEIF(n)) && (ccr & DMA_CCR_TEIE))) return true;
+    }
+    return false;
+}
+
+/* ============================================================
+   Núcleo: RCC, NVIC, SysTick
+   ============================================================ */
+static void rcc_apply(void){
+    /* osciladores/PLL ficam prontos na hora; SWS segue SW */
+    if (RCC->CR & RCC_CR_HSION) RCC->CR |= RCC_CR_HSIRDY;
+    if (RCC->CR & RCC_CR_HSEON) RCC->CR |= RCC_CR_HSERDY;
+    if (RCC->CR & (1u << 24))   RCC->CR |= RCC_CR_PLLRDY;
+    RCC->CFGR  = (RCC->CFGR & ~(3u << 2)) | ((RCC->CFGR & 3u) << 2);
+    if (RCC->CR2  & (1u << 0))  RCC->CR2  |= (1u << 1);     /* HSI14RDY */
+    if (RCC->CSR  & (1u << 0))  RCC->CSR  |= (1u << 1);     /* LSIRDY */
+    if (RCC->BDCR & (1u << 0))  RCC->BDCR |= (1u << 1);     /* LSERDY */
+}
+
+static void nvic_apply(void){
+    /* nvic_enable_irq/disable acumulam em ISER no build HOST_SIM; ICER direto também vale */
+    s_nvic_en = NVIC_ISER & ~NVIC_ICER;
+    NVIC_ISER = s_nvic_en;
+    NVIC_ICER = 0;
+}
+
+static void systick_step(uint32_t cyc){
+    if (!(SYST_CSR & SYST_CSR_ENABLE)) return;
+    uint32_t load = SYST_RVR & 0x00FFFFFFu, cvr = SYST_CVR & 0x00FFFFFFu;
+    if (!(SYST_CSR & SYST_CSR_CLKSOURCE)) cyc /= 8u;       /* aprox.: HCLK/8 */
+    if (!load || !cyc) return;
+    if (cyc < cvr) { SYST_CVR = cvr - cyc; return; }
+
+    uint32_t rem = cyc - cvr, period = load + 1u;
+    uint32_t wraps = 1u + rem / period;
+    SYST_CVR = load - (rem % period);
+    SYST_CSR |= SYST_CSR_COUNTFLAG;
+    if (SYST_CSR & SYST_CSR_TICKINT) s_systick_pend += wraps;
+}
+
+static void apply_writes(void){
+    nvic_apply();
+    rcc_apply();
+    dma_apply();
+    for (int i = 0; i < SIM_N_UART; i++) uart_apply(&s_uart[i]);
+    for (int i = 0; i < SIM_N_SPI; i++)  spi_update_sr(&s_spi[i]);
+    adc_apply();
+}
+
+/* O dispatcher do dma_router limpa, com uma escrita no IFCR, tudo o que viu
+   pendente no grupo; callbacks podem escrever IFCR de novo (dma_router_stop)
+   e, em RAM, só a última escrita sobreviveria. Aplica IFCR após o handler e
+   considera limpos os flags que estavam pendentes na entrada. */
+static void dma_handler(void (*h)(void), uint8_t first, uint8_t last){
+    uint32_t seen = 0;
+    for (uint8_t n = first; n <= last; n++)
+        seen |= DMA1->ISR & (0xFu << (4u * (n - 1u)));
+    cpu_call(h);
+    dma_apply();
+    DMA1->ISR &= ~seen;
+}
+
+/* Entrega IRQs pendentes e habilitadas, menor IRQn primeiro; reavalia após cada handler */
+static void deliver_irqs(void){
+    if (sim_primask) return;
+
+    while (s_systick_pend) { s_systick_pend--; if (SysTick_Handler) cpu_call(SysTick_Handler); }
+
+    for (int guard = 0; guard < 64; guard++) {
+        apply_writes();
+
+        bool fired = false;
+        if ((s_nvic_en & (1u << DMA1_Channel1_IRQn)) && DMA1_CH1_IRQHandler && dma_irq(1, 1)) {
+            dma_handler(DMA1_CH1_IRQHandler, 1, 1); fired = true;
+        } else if ((s_nvic_en & (1u << DMA1_Channel2_3_IRQn)) && DMA1_CH2_3_IRQHandler && dma_irq(2, 3)) {
+            dma_handler(DMA1_CH2_3_IRQHandler, 2, 3); fired = true;
+        } else if ((s_nvic_en & (1u << DMA1_Channel4_5_IRQn)) && DMA1_CH4_5_IRQHandler && dma_irq(4, 5)) {
+            dma_handler(DMA1_CH4_5_IRQHandler, 4, 5); fired = true;
+        } else if ((s_nvic_en & (1u << ADC1_COMP_IRQn)) && ADC_IRQHandler && (s_adc.isr & ADC1->IER & 0x9Fu)) {
+            bool eoc = (s_adc.isr & ADC1->IER & ADC_ISR_EOC) != 0;
+            cpu_call(ADC_IRQHandler);
+            if (eoc) s_adc.isr &= ~ADC_ISR_EOC;                 /* handler leu DR */
+            fired = true;
+        } else {
+            for (int i = 0; i < SIM_N_SPI && !fired; i++) {
+                sim_spi_t *s = &s_spi[i];
+                if ((s_nvic_en & (1u << s->irqn)) && s->handler && spi_irq(s)) {
+                    s->st.irqs++;
+                    cpu_call(s->handler);
+                    fired = true;
+                }
+            }
+            for (int i = 0; i < SIM_N_UART && !fired; i++) {
+                sim_uart_t *u = &s_uart[i];
+                if ((s_nvic_en & (1u << u->irqn)) && u->handler && uart_irq(u)) {
+                    /* vetor compartilhado (USART3/4): o handler atende todas do mesmo IRQn */
+                    uint32_t rd = 0;
+                    for (int k = 0; k < SIM_N_UART; k++)
+                        if (s_uart[k].irqn == u->irqn && (s_uart[k].r->ISR & U_ISR_RXNE) &&
+                            (s_uart[k].r->CR1 & U_CR1_RXNEIE)) rd |= 1u << k;
+                    cpu_call(u->handler);
+                    for (int k = 0; k < SIM_N_UART; k++)
+                        if (rd & (1u << k)) s_uart[k].r->ISR &= ~U_ISR_RXNE;   /* handler leu RDR */
+                    fired = true;
+                }
+            }
+        }
+        if (!fired) return;
+        while (s_systick_pend) { s_systick_pend--; if (SysTick_Handler) cpu_call(SysTick_Handler); }
+    }
+}
+
+/* ============================================================
+   API
+   ============================================================ */
+void sim_reset(void)
+{
+    spi_trap_install();
+    s_spi_open = 0;
+    spi_mem_open();
+    memset(sim_spi_mem, 0, sizeof(sim_spi_mem));
+    memset(sim_apb_mem, 0, sizeof(sim_apb_mem));
+    memset(sim_ahb2_mem, 0, sizeof(sim_ahb2_mem));
+    memset(sim_scs_mem, 0, sizeof(sim_scs_mem));
+    memset(s_uart, 0, sizeof(s_uart));
+    memset(s_spi, 0, sizeof(s_spi));
+    memset(&s_adc, 0, sizeof(s_adc));
+    memset(s_dma, 0, sizeof(s_dma));
+    s_dma_credit = 0; s_nvic_en = 0; s_systick_pend = 0; s_now = 0;
+    sim_primask = 0;
+
+    /* 32 bits altos da imagem (0 em build de 32 bits) */
+    s_hi = ((uintptr_t)sim_apb_mem >> 16 >> 16) << 16 << 16;
+
+    s_uart[0].r = USART1; s_uart[0].irqn = USART1_IRQn; s_uart[0].handler = USART1_IRQHandler;
+    s_uart[1].r = USART2; s_uart[1].irqn = USART2_IRQn; s_uart[1].handler = USART2_IRQHandler;
+    s_uart[2].r = USART3; s_uart[2].irqn = USART3_4_IRQn; s_uart[2].handler = USART3_4_5_6_IRQHandler;
+    s_uart[3].r = USART4; s_uart[3].irqn = USART3_4_IRQn; s_uart[3].handler = USART3_4_5_6_IRQHandler;
+    s_spi[0].r  = SPI1;   s_spi[0].irqn  = SPI1_IRQn;   s_spi[0].handler  = SPI1_IRQHandler;
+    s_spi[1].r  = SPI2;   s_spi[1].irqn  = SPI2_IRQn;   s_spi[1].handler  = SPI2_IRQHandler;
+
+    /* valores de reset relevantes */
+    RCC->CR = RCC_CR_HSION | RCC_CR_HSIRDY;
+    for (int i = 0; i < SIM_N_UART; i++) {
+        s_uart[i].r->ISR = U_ISR_TXE | U_ISR_TC;
+        s_uart[i].r->TDR = SIM_EMPTY;
+    }
+    for (int i = 0; i < SIM_N_SPI; i++) {
+        s_spi[i].r->CR2   = (7u << 8);      /* DS = 8 bits */
+        s_spi[i].r->CRCPR = 7u;
+        spi_update_sr(&s_spi[i]);
+    }
+    ADC1->ISR = SIM_ADC_ISR_MARK;
+    spi_mem_close();
+}
+
+static void sim_advance(uint32_t cycles, bool irqs)
+{
+    spi_mem_open();
+    while (cycles) {
+        uint32_t q = (cycles < SIM_QUANTUM_CYCLES) ? cycles : SIM_QUANTUM_CYCLES;
+        apply_writes();
+        for (int i = 0; i < SIM_N_UART; i++) uart_step(&s_uart[i], q);
+        for (int i = 0; i < SIM_N_SPI; i++)  spi_step(&s_spi[i], q);
+        adc_step(q);
+        dma_step(q);
+        systick_step(q);
+        s_now += q;
+        cycles -= q;
+        if (irqs) deliver_irqs();
+    }
+    spi_mem_close();
+}
+
+void sim_step(uint32_t cycles){ sim_advance(cycles, true); }
+
+uint64_t sim_cycles(void){ return s_now; }
+
+void sim_uart_set_tx_sink(USART_TypeDef *inst, sim_uart_tx_cb_t cb, void *ctx)
+{
+    sim_uart_t *u = uart_of(inst);
+    if (!u) return;
+    u->tx_cb = cb; u->tx_ctx = ctx;
+}
+
+static uint32_t uart_inject(USART_TypeDef *inst, const uint8_t *d8, const uint16_t *d16, uint32_t len)
+{
+    sim_uart_t *u = uart_of(inst);
+    if (!u || (!d8 && !d16)) return 0;
+    uint32_t n = 0;
+    for (; n < len; n++) {
+        uint32_t nx = (u->q_head + 1u) % SIM_UART_RXQ_LEN;
+        if (nx == u->q_tail) { u->st.rx_dropped += len - n; break; }
+        u->rxq[u->q_head] = d16 ? d16[n] : d8[n];
+        u->q_head = nx;
+    }
+    return n;
+}
+
+uint32_t sim_uart_inject(USART_TypeDef *inst, const uint8_t *data, uint32_t len)
+{
+    return uart_inject(inst, data, NULL, len);
+}
+
+uint32_t sim_uart_inject16(USART_TypeDef *inst, const uint16_t *data, uint32_t len)
+{
+    return uart_inject(inst, NULL, data, len);
+}
+
+bool sim_uart_de(USART_TypeDef *inst)
+{
+    sim_uart_t *u = uart_of(inst);
+    return u ? u->de : false;
+}
+
+const sim_uart_stats_t *sim_uart_stats(USART_TypeDef *inst)
+{
+    sim_uart_t *u = uart_of(inst);
+    return u ? &u->st : NULL;
+}
+
+void sim_spi_set_slave(SPI_TypeDef *inst, sim_spi_slave_cb_t cb, void *ctx)
+{
+    sim_spi_t *s = spi_of(inst);
+    if (!s) return;
+    s->slave = cb; s->slave_ctx = ctx;
+}
+
+const sim_spi_stats_t *sim_spi_stats(SPI_TypeDef *inst)
+{
+    sim_spi_t *s = spi_of(inst);
+    return s ? &s->st : NULL;
+}
+
+void sim_adc_set_source(sim_adc_source_t cb, void *ctx)
+{
+    s_adc.src = cb; s_adc.src_ctx = ctx;
+}
+
+const sim_dma_stats_t *sim_dma_stats(uint8_t ch)
+{
+    if (ch < 1 || ch > 5) return NULL;
+    return &s_dma[ch].st;
+}
+
+#endif /* HOST_SIM */
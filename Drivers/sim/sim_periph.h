@@ -0,0 +1,129 @@
+/*
+ * sim_periph.h
+ *
+ *  Modelo de periféricos em RAM para rodar os drivers no host (Linux).
+ *
+ *  Build: compile TUDO com -DHOST_SIM. As bases de stm32f070xx.h/core_m0.h
+ *  passam a apontar para arrays deste módulo; os drivers não mudam.
+ *
+ *    gcc -DHOST_SIM -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast \
+ *        -I Drivers -I Drivers/dma -I Drivers/sim -I Drivers/usart/usart_irq_dma ... \
+ *        Drivers/sim/sim_periph.c Drivers/dma/dma_router.c <drivers> <app>.c
+ *
+ *  - O DMA guarda endereços de 32 bits (CPAR/CMAR). No host de 64 bits o
+ *    modelo reconstrói o ponteiro com os 32 bits altos da própria imagem:
+ *    buffers de DMA precisam ser estáticos (globais/static), não de pilha/heap.
+ *    Com -m32 qualquer buffer serve.
+ *  - Tempo: sim_step(ciclos) avança periféricos, DMA e SysTick e entrega as
+ *    "interrupções" chamando os handlers dos drivers (só com sim_primask == 0).
+ *    O código da aplicação/ISR roda em tempo zero; esperas bloqueantes dos
+ *    drivers (spi_wait, usart_flush) travam: no host, faça o laço com sim_step.
+ *    Exceção: cada leitura do SR de um SPI avança um quantum (laços de BSY e
+ *    do engine POLL), sem entregar interrupções.
+ *  - Escritas da CPU são detectadas por comparação (IFCR/ICR != 0, TDR
+ *    diferente de "vazio", bit reservado em ADC ISR). Leituras da CPU não são
+ *    visíveis: RXNE (USART) e EOC (ADC) são considerados lidos quando o handler
+ *    da interrupção correspondente roda. Várias escritas no mesmo registrador
+ *    entre dois passos: só a última vale (por isso nvic_enable_irq acumula em
+ *    ISER e os flags DMA vistos pelo dispatcher são limpos após o handler).
+ *  - SPI: os registradores ficam numa página própria (sim_spi_mem), protegida
+ *    enquanto roda código de driver/aplicação. Cada acesso da CPU gera SIGSEGV;
+ *    o modelo aplica o efeito (DR: FIFO pelo tamanho do acesso; SR: CRCERR
+ *    rc_w0; CR1: CRCEN 0→1 zera o CRC) e a instrução roda em single-step.
+ *    Só em host x86/x86-64 Linux; SIGSEGV e SIGTRAP ficam com o simulador.
+ *  - Modelado: DMA1 (5 canais, prioridade PL, HT/TC/TE, circular, MEM2MEM),
+ *    USART1..4 (TX/RX com tempo de frame, 7/8/9 bits, IDLE, RTOF, CMF, mute por
+ *    address mark, DE do RS-485 com DEAT/DEDT, ORE, DMAT/DMAR), SPI1/2 mestre
+ *    (FIFO de 4 bytes, FRXTH, FRLVL/FTLVL, OVR, escravo por callback, CRC
+ *    com CRCPR/CRCL: enviado após CRCNEXT ou após o último item do DMA TX,
+ *    conferido contra o CRC recebido → CRCERR), ADC1
+ *    (sequência CHSELR, CONT, DMAEN), SysTick e NVIC (ISER/ICER).
+ */
+
+#ifndef __SIM_PERIPH_H__
+#define __SIM_PERIPH_H__
+
+#include "stm32f070xx.h"
+
+#ifdef HOST_SIM
+
+/* ciclos de barramento por transferência do DMA (aprox. F0: 1 leitura + 1 escrita + arbitragem) */
+#ifndef SIM_DMA_BEAT_CYCLES
+#define SIM_DMA_BEAT_CYCLES   5u
+#endif
+
+/* granularidade do passo interno (ciclos) */
+#ifndef SIM_QUANTUM_CYCLES
+#define SIM_QUANTUM_CYCLES    8u
+#endif
+
+/* bytes pendentes na linha RX de cada USART */
+#ifndef SIM_UART_RXQ_LEN
+#define SIM_UART_RXQ_LEN      4096u
+#endif
+
+/* relação HCLK / clock do ADC (HSI14) */
+#ifndef SIM_HCLK_HZ
+#define SIM_HCLK_HZ           48000000u
+#endif
+#ifndef SIM_ADC_CLK_HZ
+#define SIM_ADC_CLK_HZ        14000000u
+#endif
+
+/* ===== Controle ===== */
+void     sim_reset(void);                /* zera o modelo e carrega valores de reset */
+void     sim_step(uint32_t cycles);
+uint64_t sim_cycles(void);               /* ciclos simulados desde sim_reset */
+
+/* ===== USART ===== */
+typedef void (*sim_uart_tx_cb_t)(USART_TypeDef *inst, uint16_t data, void *ctx);
+
+typedef struct {
+    uint32_t tx_frames;
+    uint32_t rx_frames;
+    uint32_t rx_overruns;   /* frame chegou com RXNE ainda setado (ORE) */
+    uint32_t rx_dropped;    /* sim_uart_inject sem espaço na fila */
+    uint32_t de_cycles;     /* ciclos com DE (RS-485) ativo */
+} sim_uart_stats_t;
+
+/* cada frame transmitido é entregue ao callback (ex.: loopback com sim_uart_inject) */
+void     sim_uart_set_tx_sink(USART_TypeDef *inst, sim_uart_tx_cb_t cb, void *ctx);
+/* enfileira frames na linha RX; chegam um por tempo de frame. Retorna aceitos */
+uint32_t sim_uart_inject(USART_TypeDef *inst, const uint8_t *data, uint32_t len);
+/* idem com frames de 9 bits (bit 8 = marca de endereço no mute multiprocessador) */
+uint32_t sim_uart_inject16(USART_TypeDef *inst, const uint16_t *data, uint32_t len);
+/* RS-485 (DEM): DE ativo agora (nível lógico, sem DEP) */
+bool     sim_uart_de(USART_TypeDef *inst);
+const sim_uart_stats_t *sim_uart_stats(USART_TypeDef *inst);
+
+/* ===== SPI (mestre) ===== */
+/* escravo: recebe o item MOSI e devolve o MISO. NULL = loopback (MISO = MOSI).
+   Na fase de CRC ele também é chamado (MOSI = CRC do mestre; devolve o seu). */
+typedef uint16_t (*sim_spi_slave_cb_t)(SPI_TypeDef *inst, uint16_t mosi, void *ctx);
+void     sim_spi_set_slave(SPI_TypeDef *inst, sim_spi_slave_cb_t cb, void *ctx);
+
+typedef struct {
+    uint32_t frames;        /* frames deslocados no barramento */
+    uint32_t irqs;          /* chamadas do handler do SPI */
+    uint32_t cpu_writes;    /* acessos da CPU ao DR */
+    uint32_t cpu_reads;
+    uint32_t tx_dropped;    /* escrita com o TXFIFO cheio */
+    uint32_t crc_errors;    /* CRC recebido diferente do RXCRC */
+} sim_spi_stats_t;
+const sim_spi_stats_t *sim_spi_stats(SPI_TypeDef *inst);
+
+/* ===== ADC ===== */
+/* valor bruto (12 bits) do canal; NULL = rampa 0..4095 por conversão */
+typedef uint16_t (*sim_adc_source_t)(uint8_t channel, void *ctx);
+void     sim_adc_set_source(sim_adc_source_t cb, void *ctx);
+
+/* ===== DMA ===== */
+typedef struct {
+    uint32_t beats;         /* transferências feitas */
+    uint32_t bus_cycles;    /* beats * SIM_DMA_BEAT_CYCLES */
+} sim_dma_stats_t;
+const sim_dma_stats_t *sim_dma_stats(uint8_t ch);   /* ch 1..5 */
+
+#endif /* HOST_SIM */
+
+#endif /* __SIM_PERIPH_H__ */
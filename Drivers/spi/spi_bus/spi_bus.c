@@ -0,0 +1,109 @@
+#include "spi_bus.h"
+
+static inline void cs_assert(const spi_dev_t *d){
+  if (d->cs_assert)    d->cs_assert();
+  else if (d->cs_port) d->cs_port->BRR = (1u << d->cs_pin);
+}
+static inline void cs_release(const spi_dev_t *d){
+  if (d->cs_release)   d->cs_release();
+  else if (d->cs_port) d->cs_port->BSRR = (1u << d->cs_pin);
+}
+
+/* inicia o item da cabeça (SPI ocioso); formato só se o dispositivo mudou.
+   Se o driver recusar o início, o item sai da fila sem callback (com os
+   seguintes do mesmo grupo keep_cs), conta em failed e o próximo é tentado. */
+static void bus_start_head(spi_bus_t *b){
+  for (;;) {
+    const spi_xfer_t *x = &b->q[b->head];
+    const spi_dev_t  *d = x->dev;
+
+    if (d != b->cur_dev) {
+      spi_set_format(b->s, d->mode, d->baud_div, d->bit_order, d->datasize);
+      b->cur_dev = d;
+      b->reconfigs++;
+    }
+    if (b->cs_dev != d) {
+      if (b->cs_dev) cs_release(b->cs_dev);
+      cs_assert(d);
+    }
+    b->cs_dev = d;
+    if (spi_transfer_async(b->s, x->tx, x->rx, x->count)) return;
+
+    cs_release(d);
+    b->cs_dev = NULL;
+
+    uint32_t pm = irq_lock();
+    bool chain;
+    do {
+      chain = b->q[b->head].keep_cs;
+      b->head = (uint8_t)((b->head + 1u) % SPI_BUS_QUEUE_LEN);
+      b->count--;
+      b->failed++;
+    } while (chain && b->count);
+    bool more = (b->count != 0u);
+    if (!more) b->running = 0;
+    irq_unlock(pm);
+
+    if (!more) return;
+  }
+}
+
+/* fim de transação (ISR, via spi_finish): solta o CS, avança a fila,
+   dispara a próxima e só então chama o callback da que terminou.
+   keep_cs no último item da fila também solta: um submit posterior pode ser
+   de outro dispositivo. */
+static void bus_done(spi_drv_t *s){
+  spi_bus_t *b = (spi_bus_t*)s->bus;
+  const spi_xfer_t *x = &b->q[b->head];
+  spi_bus_cb_t cb = x->cb;
+  void *ctx = x->ctx;
+
+  b->done++;
+
+  uint32_t pm = irq_lock();
+  b->head = (uint8_t)((b->head + 1u) % SPI_BUS_QUEUE_LEN);
+  b->count--;
+  bool more = (b->count != 0u);
+  if (!more) b->running = 0;
+  if (!x->keep_cs || !more) { cs_release(x->dev); b->cs_dev = NULL; }
+  irq_unlock(pm);
+
+  if (more) bus_start_head(b);
+  if (cb) cb(ctx);
+}
+
+void spi_bus_init(spi_bus_t *b, spi_drv_t *s){
+  memset(b, 0, sizeof(*b));
+  b->s = s;
+  s->bus = b;
+  s->bus_done = bus_done;
+}
+
+bool spi_bus_submit(spi_bus_t *b, const spi_xfer_t *x, uint8_t n){
+  if (!n) return true;
+  for (uint8_t i = 0; i < n; i++) if (!x[i].dev || !x[i].count) return false;
+
+  uint32_t pm = irq_lock();
+  if (b->count + n > SPI_BUS_QUEUE_LEN) { b->rejected++; irq_unlock(pm); return false; }
+  for (uint8_t i = 0; i < n; i++) b->q[(b->head + b->count + i) % SPI_BUS_QUEUE_LEN] = x[i];
+  b->count = (uint8_t)(b->count + n);
+  bool kick = !b->running;
+  b->running = 1;
+  irq_unlock(pm);
+
+  if (kick) bus_start_head(b);
+  return true;
+}
+
+void spi_bus_wait(spi_bus_t *b){ while (b->running) { __asm volatile("nop"); } }
+
+void spi_bus_abort(spi_bus_t *b){
+  uint32_t pm = irq_lock();
+  bool was = b->running;
+  b->count = 0; b->running = 0;
+  irq_unlock(pm);
+
+  if (was) spi_abort(b->s);
+  if (b->cs_dev) cs_release(b->cs_dev);
+  b->cs_dev = NULL;
+}
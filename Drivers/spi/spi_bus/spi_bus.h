@@ -0,0 +1,93 @@
+/*
+ * spi_bus.h
+ *
+ *  Gerenciador de barramento sobre spi_irq_dma: vários dispositivos no mesmo
+ *  SPI e uma fila de transações de tamanho fixo.
+ *  - Cada dispositivo é um descritor (normalmente const): modo CPOL/CPHA,
+ *    divisor de baud, ordem de bits, largura e CS (callbacks ou pino GPIO
+ *    ativo em 0, já configurado como saída pelo usuário).
+ *  - O fim de cada transação (spi_finish, na ISR do DMA/SPI) já dispara a
+ *    próxima da fila: transferências seguidas não passam pelo loop principal.
+ *    CR1/CR2 só são reescritos quando o dispositivo muda.
+ *  - keep_cs = 1 mantém o CS assertado para o item seguinte (que deve ser do
+ *    mesmo dispositivo): comando + dados na mesma seleção. Se a fila esvaziar
+ *    depois dele, o CS é solto mesmo assim. Os itens de um spi_bus_submit
+ *    entram juntos na fila (tudo ou nada).
+ *  - Callback por transação, chamado na ISR depois que a próxima já foi
+ *    iniciada. Pode chamar spi_bus_submit.
+ *  - Com engine POLL/AUTO, itens curtos terminam dentro da própria chamada
+ *    (o submit pode voltar com o callback já executado).
+ *  - O handle do driver deve ser iniciado com NSS_SOFT e sem cs_assert/
+ *    cs_release: o CS é por dispositivo. Não use spi_transfer_async
+ *    diretamente enquanto o barramento estiver em uso.
+ */
+
+#ifndef __SPI_BUS_H__
+#define __SPI_BUS_H__
+
+#include "spi_irq_dma.h"
+
+/* transações na fila (inclui a que está em andamento) */
+#ifndef SPI_BUS_QUEUE_LEN
+#define SPI_BUS_QUEUE_LEN   8u
+#endif
+
+typedef struct {
+  spi_mode_t      mode;
+  spi_baud_t      baud_div;
+  spi_bit_order_t bit_order;
+  spi_datasize_t  datasize;
+
+  /* CS: callbacks têm prioridade; senão cs_port/cs_pin (ativo em 0) */
+  void (*cs_assert)(void);
+  void (*cs_release)(void);
+  GPIO_TypeDef   *cs_port;
+  uint8_t         cs_pin;
+} spi_dev_t;
+
+typedef void (*spi_bus_cb_t)(void *ctx);
+
+typedef struct {
+  const spi_dev_t *dev;
+  const void      *tx;          /* NULL: envia dummy */
+  void            *rx;          /* NULL: descarta */
+  uint16_t         count;       /* itens (bytes ou halfwords, pela largura do dev) */
+  uint8_t          keep_cs;     /* 1: não solta o CS ao fim (próximo item, mesmo dev) */
+  spi_bus_cb_t     cb;          /* opcional */
+  void            *ctx;
+} spi_xfer_t;
+
+typedef struct {
+  spi_drv_t        *s;
+  spi_xfer_t        q[SPI_BUS_QUEUE_LEN];
+  volatile uint8_t  head;       /* item em andamento */
+  volatile uint8_t  count;      /* itens na fila */
+  volatile uint8_t  running;
+  const spi_dev_t  *cs_dev;     /* CS assertado (keep_cs do item anterior) */
+  const spi_dev_t  *cur_dev;    /* formato carregado no SPI */
+
+  /* estatísticas */
+  volatile uint32_t done;
+  volatile uint32_t reconfigs;  /* trocas de formato (CR1/CR2) */
+  volatile uint32_t rejected;   /* submits sem espaço na fila */
+  volatile uint32_t failed;     /* itens descartados: o driver recusou o início */
+} spi_bus_t;
+
+/* s já iniciado (spi_init) com NSS_SOFT, sem callbacks de CS */
+void spi_bus_init(spi_bus_t *b, spi_drv_t *s);
+
+/* Enfileira n itens de uma vez (ISR ou loop). false se não couberem ou se
+   algum item não tiver dev ou tiver count 0. Um item que o driver recusar ao
+   iniciar (ex.: SPI ainda ocupado) é
+   descartado sem callback, junto com o resto do seu grupo keep_cs, e conta
+   em failed. */
+bool spi_bus_submit(spi_bus_t *b, const spi_xfer_t *x, uint8_t n);
+
+static inline bool spi_bus_idle(const spi_bus_t *b){ return !b->running; }
+void spi_bus_wait(spi_bus_t *b);
+
+/* Para a transação em andamento, solta o CS e descarta a fila (sem callbacks).
+   Use após um erro reportado pelo on_error do driver. */
+void spi_bus_abort(spi_bus_t *b);
+
+#endif /* __SPI_BUS_H__ */
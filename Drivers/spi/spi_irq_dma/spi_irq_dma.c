@@ -2,31 +2,92 @@
 
 static void spi_dma_start(spi_drv_t *s);
 static void spi_irq_enable(spi_drv_t *s);
+static void spi_irq_disable(spi_drv_t *s);
+static void spi_poll_run(spi_drv_t *s);
 
 /* ===== Instâncias globais p/ SPI IRQ dispatch ===== */
 static spi_drv_t *g_spi1 = NULL;
 static spi_drv_t *g_spi2 = NULL;
 
 /* ===== Utilidades ===== */
+#define SPI_CR1_SPE      (1u<<6)
+#define SPI_CR1_CRCL     (1u<<11)
+#define SPI_CR1_CRCNEXT  (1u<<12)
+#define SPI_CR1_CRCEN    (1u<<13)
+#define SPI_SR_CRCERR    (1u<<4)
+#define SPI_SR_FRLVL(sr) (((sr) >> 9) & 3u)   /* 0, 1/4, 1/2, cheio */
+
+static inline bool eng_auto(const spi_drv_config_t *c){
+  return c->tx_engine == SPI_ENGINE_AUTO || c->rx_engine == SPI_ENGINE_AUTO;
+}
+/* DMA possível nesta config (AUTO também reserva os canais) */
+static inline bool eng_dma(spi_engine_t e){ return e == SPI_ENGINE_DMA || e == SPI_ENGINE_AUTO; }
+
+/* DR (offset 0x0C) em 8 ou 16 bits: endereço calculado, sem reinterpretar o
+   campo uint32_t do struct (strict aliasing) */
+#define SPI_DR_AT(T, spi)  (*(volatile T*)((uintptr_t)(spi) + 0x0Cu))
+static inline void spi_dr_write8 (SPI_TypeDef *spi, uint8_t v) { SPI_DR_AT(uint8_t, spi)  = v; }
+static inline void spi_dr_write16(SPI_TypeDef *spi, uint16_t v){ SPI_DR_AT(uint16_t, spi) = v; }
+static inline uint8_t  spi_dr_read8 (SPI_TypeDef *spi){ return SPI_DR_AT(uint8_t, spi); }
+static inline uint16_t spi_dr_read16(SPI_TypeDef *spi){ return SPI_DR_AT(uint16_t, spi); }
+
 static inline void wait_bsy_clear(SPI_TypeDef *spi){
   while (spi->SR & (1u<<7)) { __asm volatile("nop"); }  /* BSY */
 }
 
-/* Mapeamento DMA por instância (ajuste se seu part number diferir) */
+/* Mapeamento DMA por instância (via alocador do dma_router).
+   SPI não tem remap: reserve o SPI antes de USART1/ADC para que eles sejam relocados.
+   Um engine DMA usa os dois canais (o outro sentido gera clock/drena RX);
+   sem os dois livres, a transação cai para IRQ. */
 static void spi_pick_dma(spi_drv_t *s){
-  if (s->inst == SPI1){
-    s->dma_rx = DMA1_Channel2; s->rx_ch_idx = 2;
-    s->dma_tx = DMA1_Channel3; s->tx_ch_idx = 3;
-  } else {
-    s->dma_rx = DMA1_Channel4; s->rx_ch_idx = 4;
-    s->dma_tx = DMA1_Channel5; s->tx_ch_idx = 5;
+  if (!eng_dma(s->cfg.tx_engine) && !eng_dma(s->cfg.rx_engine)) return;
+
+  dma_req_t rq_rx = (s->inst == SPI1) ? DMA_REQ_SPI1_RX : DMA_REQ_SPI2_RX;
+  dma_req_t rq_tx = (s->inst == SPI1) ? DMA_REQ_SPI1_TX : DMA_REQ_SPI2_TX;
+
+  s->rx_ch_idx = dma_router_claim_req(rq_rx, s);
+  s->tx_ch_idx = dma_router_claim_req(rq_tx, s);
+  if (!s->rx_ch_idx || !s->tx_ch_idx) {
+    if (s->rx_ch_idx) dma_router_release(s->rx_ch_idx, s);
+    if (s->tx_ch_idx) dma_router_release(s->tx_ch_idx, s);
+    s->rx_ch_idx = s->tx_ch_idx = 0;
+    if (!eng_auto(&s->cfg)) s->cfg.tx_engine = s->cfg.rx_engine = SPI_ENGINE_IRQ;
+    return;   /* AUTO segue só com POLL/IRQ */
+  }
+  s->dma_rx = DMA1_CHANNEL(s->rx_ch_idx);
+  s->dma_tx = DMA1_CHANNEL(s->tx_ch_idx);
+}
+
+/* CCR dos dois canais calculado uma vez (largura fixa pelo datasize);
+   cada transação só recarrega CMAR/CNDTR via dma_router_restart*() */
+static void spi_prepare_dma(spi_drv_t *s){
+  if (!s->rx_ch_idx || !s->tx_ch_idx) return;
+  uint8_t w = (s->bytes_per_item == 1) ? 0u : 1u;   /* 8/16 bits */
+  dma_router_prepare_ccr(s->rx_ch_idx, (uint32_t)&s->inst->DR,
+      DMA_ROUTER_CCR(/*m2p*/0, 0, /*minc*/1, 0, w, w, /*prio*/2, /*tc*/1, 0, /*te*/1));
+  dma_router_prepare_ccr(s->tx_ch_idx, (uint32_t)&s->inst->DR,
+      DMA_ROUTER_CCR(/*m2p*/1, 0, /*minc*/1, 0, w, w, /*prio*/2, /*tc*/1, 0, /*te*/1));
+}
+
+/* engine desta transação: fixo pela config ou, no AUTO, pelo tamanho */
+static spi_engine_t spi_choose_engine(const spi_drv_t *s, uint32_t count){
+  const spi_drv_config_t *c = &s->cfg;
+  if (eng_auto(c)) {
+    if (count <= s->auto_poll_max) return SPI_ENGINE_POLL;
+    if (count >= s->auto_dma_min && count <= SPI_DMA_MAX_ITEMS && s->rx_ch_idx) return SPI_ENGINE_DMA;
+    return SPI_ENGINE_IRQ;
   }
+  if (c->tx_engine == SPI_ENGINE_DMA || c->rx_engine == SPI_ENGINE_DMA) return SPI_ENGINE_DMA;
+  if (c->tx_engine == SPI_ENGINE_POLL && c->rx_engine == SPI_ENGINE_POLL) return SPI_ENGINE_POLL;
+  return SPI_ENGINE_IRQ;
 }
 
-/* inicia uma fase (assert_cs controla se chamamos cs_assert agora) */
-static bool spi_start_phase(spi_drv_t *s, const void *tx, void *rx, uint32_t count, bool assert_cs)
+/* inicia um segmento (assert_cs só no primeiro) */
+static bool spi_start_phase(spi_drv_t *s, const spi_seg_t *g, bool assert_cs)
 {
-  s->tx_buf = tx; s->rx_buf = rx; s->count = count;
+  uint32_t count = g->len;
+  s->tx_buf = g->tx; s->rx_buf = g->rx; s->count = count;
+  s->tx_dummy16 = g->fill; s->tx_dummy8 = (uint8_t)g->fill;
   s->tx_idx = 0;  s->rx_idx = 0;
   s->dma_tx_done = s->dma_rx_done = 0;
 
@@ -35,9 +96,23 @@ static bool spi_start_phase(spi_drv_t *s, const void *tx, void *rx, uint32_t cou
   /* limpa OVR prévio */
   (void)s->inst->SR; (void)s->inst->DR;
 
-  if (s->cfg.tx_engine == SPI_ENGINE_DMA || s->cfg.rx_engine == SPI_ENGINE_DMA) {
+  /* CRC zera só com CRCEN 0→1 e SPE=0: uma vez por segmento */
+  s->crc_left = 0;
+  if (s->cfg.crc && count) {
+    SPI_TypeDef *spi = s->inst;
+    uint32_t cr1 = spi->CR1 & ~(SPI_CR1_SPE | SPI_CR1_CRCEN | SPI_CR1_CRCNEXT);
+    spi->CR1 = cr1;
+    spi->CR1 = cr1 | SPI_CR1_CRCEN;
+    spi->CR1 = cr1 | SPI_CR1_CRCEN | SPI_CR1_SPE;
+    s->crc_left = s->crc_bytes;
+  }
+
+  s->xfer_engine = (uint8_t)spi_choose_engine(s, count);
+  if (s->xfer_engine == SPI_ENGINE_DMA) {
     RCC->AHBENR |= RCC_AHBENR_DMA1EN;
     spi_dma_start(s);   /* usa buffers já colocados em s */
+  } else if (s->xfer_engine == SPI_ENGINE_POLL) {
+    spi_poll_run(s);    /* termina aqui (spi_finish já chamado) */
   } else {
     spi_irq_enable(s);
   }
@@ -45,34 +120,49 @@ static bool spi_start_phase(spi_drv_t *s, const void *tx, void *rx, uint32_t cou
 }
 
 
+/* CRC recebido: no DMA ele fica no RXFIFO (o canal RX conta só os dados);
+   no IRQ/POLL já foi lido. CRCERR é limpo escrevendo 0. */
+static void spi_crc_check(spi_drv_t *s){
+  SPI_TypeDef *spi = s->inst;
+  while (s->crc_left && SPI_SR_FRLVL(spi->SR)) {
+    if (s->bytes_per_item == 2) { (void)spi_dr_read16(spi); s->crc_left = 0; }
+    else                        { (void)spi_dr_read8(spi);  s->crc_left--; }
+  }
+  s->crc_left = 0;
+
+  uint32_t sr = spi->SR;
+  s->crc_fail = (sr & SPI_SR_CRCERR) ? 1u : 0u;
+  if (s->crc_fail) {
+    spi->SR = ~SPI_SR_CRCERR & 0xFFFFu;
+    s->crc_errors++;
+    if (s->on_error) s->on_error(sr, 0);
+  }
+}
+
 /* Finalização comum */
 static void spi_finish(spi_drv_t *s){
   wait_bsy_clear(s->inst);
+  if (s->cfg.crc && s->count) spi_crc_check(s);
 
-  /* Se estamos em transação multi-fase e acabamos a FASE 1:
-     -> NÃO libera CS, NÃO limpa busy; dispara fase 2 sem assert de CS */
-  if (s->multi_active && s->phase == 1) {
-    s->phase = 2;
-
-    /* Fase 2: TX = phase2_tx (normalmente NULL → dummy), RX = phase2_rx */
-    /* Aqui NÃO assertamos CS (mantém baixo do começo da fase 1) */
-    spi_start_phase(s, s->phase2_tx, s->phase2_rx, s->phase2_count, /*assert_cs=*/false);
+  /* Há mais segmentos: NÃO libera CS, NÃO limpa busy, sem callback;
+     o próximo começa daqui mesmo (ISR) */
+  if (s->seg_idx + 1u < s->seg_n) {
+    s->seg_idx++;
+    spi_start_phase(s, &s->segs[s->seg_idx], /*assert_cs=*/false);
     return;
   }
 
-  /* Fim normal (fase única ou fim da fase 2) */
+  /* Fim do último segmento */
   if (s->cfg.nss_mode == SPI_NSS_SOFT && s->cfg.cs_release) s->cfg.cs_release();
 
+  s->seg_n = 0;
   s->busy = 0;
 
-  /* callback do usuário:
-     - em fluxo multi-fase, chamamos somente ao final da fase 2 */
-  if (s->multi_active) {
-    s->multi_active = 0;
-    if (s->user_on_complete) s->user_on_complete();
-  } else if (s->on_complete) {
-    s->on_complete();
-  }
+  /* gerenciador de barramento: ele chama o callback da transação e já
+     dispara a próxima da fila daqui mesmo (ISR) */
+  if (s->bus_done) { s->bus_done(s); return; }
+
+  if (s->on_complete) s->on_complete();
 }
 
 
@@ -81,12 +171,12 @@ static void spi_dma_tx_cb(uint32_t flags, void *ctx){
   spi_drv_t *s = (spi_drv_t*)ctx;
   if (!s->tx_dma_active) return;
 
-  if (flags & (DMA_TEIF3 | DMA_TEIF5)) {  /* erro TX nos canais típicos */
+  if (flags & DMA_TEIF(s->tx_ch_idx)) {  /* erro TX */
     if (s->on_error) s->on_error(0, flags);
     s->tx_dma_active = 0;
     return;
   }
-  if (flags & (DMA_TCIF3 | DMA_TCIF5)) {  /* TX done */
+  if (flags & DMA_TCIF(s->tx_ch_idx)) {  /* TX done */
     s->dma_tx_done = 1;
     s->tx_dma_active = 0;
     /* se RX não usa DMA ou já terminou, finaliza */
@@ -98,12 +188,12 @@ static void spi_dma_rx_cb(uint32_t flags, void *ctx){
   spi_drv_t *s = (spi_drv_t*)ctx;
   if (!s->rx_dma_active) return;
 
-  if (flags & (DMA_TEIF2 | DMA_TEIF4)) {  /* erro RX nos canais típicos */
+  if (flags & DMA_TEIF(s->rx_ch_idx)) {  /* erro RX */
     if (s->on_error) s->on_error(0, flags);
     s->rx_dma_active = 0;
     return;
   }
-  if (flags & (DMA_TCIF2 | DMA_TCIF4)) {  /* RX done */
+  if (flags & DMA_TCIF(s->rx_ch_idx)) {  /* RX done */
     s->dma_rx_done = 1;
     s->rx_dma_active = 0;
     if (!s->tx_dma_active || s->dma_tx_done) spi_finish(s);
@@ -111,13 +201,40 @@ static void spi_dma_rx_cb(uint32_t flags, void *ctx){
 }
 
 /* ===== Inicialização ===== */
+/* CR1/CR2 a partir da config (SPE=0; CR2 sem bits de IRQ/DMA) */
+static void spi_calc_regs(const spi_drv_config_t *cfg, uint32_t *pcr1, uint32_t *pcr2){
+  uint32_t cr1 = 0;
+  if (cfg->mode & 0x2) cr1 |= (1u<<1); /* CPOL */
+  if (cfg->mode & 0x1) cr1 |= (1u<<0); /* CPHA */
+  cr1 |= (1u<<2);                      /* MSTR */
+  cr1 |= ((uint32_t)cfg->baud_div & 0x7u) << 3; /* BR */
+  if (cfg->bit_order == SPI_LSB_FIRST) cr1 |= (1u<<7);
+
+  if (cfg->nss_mode == SPI_NSS_SOFT) cr1 |= (1u<<9)|(1u<<8); /* SSM|SSI */
+  if (cfg->crc) {
+    cr1 |= SPI_CR1_CRCEN;
+    if (cfg->crc_16bit || cfg->datasize > 8) cr1 |= SPI_CR1_CRCL;
+  }
+
+  uint32_t cr2 = 0;
+  uint32_t ds = (cfg->datasize >= 4 && cfg->datasize <= 16) ? (cfg->datasize - 1u) : 7u;
+  cr2 |= (ds & 0xF) << 8;                 /* DS */
+  if (cfg->datasize <= 8) cr2 |= (1u<<12);/* FRXTH */
+  if (cfg->nss_mode == SPI_NSS_HARD_AUTO) {
+    cr2 |= (1u<<2);                       /* SSOE */
+    if (cfg->nssp_pulse) cr2 |= (1u<<3);  /* NSSP (se disponível) */
+  }
+  *pcr1 = cr1; *pcr2 = cr2;
+}
+
 void spi_init(spi_drv_t *s, SPI_TypeDef *inst, const spi_drv_config_t *cfg)
 {
   memset(s, 0, sizeof(*s));
   s->inst = inst;
   s->cfg  = *cfg;
   s->bytes_per_item = (cfg->datasize <= 8) ? 1u : 2u;
-  s->tx_dummy8 = 0xFF; s->tx_dummy16 = 0xFFFF;
+  s->auto_poll_max = SPI_AUTO_POLL_MAX;
+  s->auto_dma_min  = SPI_AUTO_DMA_MIN;
 
   /* clocks */
   if (inst == SPI1) RCC->APB2ENR |= RCC_APB2ENR_SPI1EN;
@@ -125,32 +242,18 @@ void spi_init(spi_drv_t *s, SPI_TypeDef *inst, const spi_drv_config_t *cfg)
 
   /* mapear DMA (e habilitar clock do DMA se qualquer engine usar DMA) */
   spi_pick_dma(s);
-  if (cfg->tx_engine == SPI_ENGINE_DMA || cfg->rx_engine == SPI_ENGINE_DMA) {
+  if (s->rx_ch_idx) {
     RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+    spi_prepare_dma(s);
   }
 
   /* configurar SPI */
   inst->CR1 &= ~(1u<<6); /* SPE=0 */
 
-  uint32_t cr1 = 0;
-  if (cfg->mode & 0x2) cr1 |= (1u<<1); /* CPOL */
-  if (cfg->mode & 0x1) cr1 |= (1u<<0); /* CPHA */
-  cr1 |= (1u<<2);                      /* MSTR */
-  cr1 |= ((uint32_t)cfg->baud_div & 0x7u) << 3; /* BR */
-  if (cfg->bit_order == SPI_LSB_FIRST) cr1 |= (1u<<7);
-
-  if (cfg->nss_mode == SPI_NSS_SOFT) cr1 |= (1u<<9)|(1u<<8); /* SSM|SSI */
-  else                               cr1 &= ~((1u<<9)|(1u<<8));
-
-  uint32_t cr2 = 0;
-  uint32_t ds = (cfg->datasize >= 4 && cfg->datasize <= 16) ? (cfg->datasize - 1u) : 7u;
-  cr2 |= (ds & 0xF) << 8;                 /* DS */
-  if (cfg->datasize <= 8) cr2 |= (1u<<12);/* FRXTH */
-  if (cfg->nss_mode == SPI_NSS_HARD_AUTO) {
-    cr2 |= (1u<<2);                       /* SSOE */
-    if (cfg->nssp_pulse) cr2 |= (1u<<3);  /* NSSP (se disponível) */
-  }
-
+  uint32_t cr1, cr2;
+  spi_calc_regs(&s->cfg, &cr1, &cr2);
+  s->crc_bytes = (cr1 & SPI_CR1_CRCL) ? 2u : 1u;
+  if (cfg->crc) inst->CRCPR = cfg->crc_poly ? cfg->crc_poly : 0x7u;
   inst->CR2 = cr2;
   inst->CR1 = cr1;
   inst->CR1 |= (1u<<6); /* SPE=1 */
@@ -166,15 +269,39 @@ void spi_init(spi_drv_t *s, SPI_TypeDef *inst, const spi_drv_config_t *cfg)
   if (inst==SPI1) g_spi1 = s; else g_spi2 = s;
 }
 
+/* Troca modo/baud/ordem/largura entre transações (BSY=0, sem transação em
+   andamento). SPE é desligado durante a escrita; o CCR do DMA só é
+   recalculado se a largura do item mudar. */
+void spi_set_format(spi_drv_t *s, spi_mode_t mode, spi_baud_t baud_div,
+                    spi_bit_order_t bit_order, spi_datasize_t datasize)
+{
+  SPI_TypeDef *spi = s->inst;
+  s->cfg.mode = mode; s->cfg.baud_div = baud_div;
+  s->cfg.bit_order = bit_order; s->cfg.datasize = datasize;
+
+  uint32_t cr1, cr2;
+  spi_calc_regs(&s->cfg, &cr1, &cr2);
+  cr2 |= spi->CR2 & ((1u<<1)|(1u<<0));    /* preserva TXDMAEN|RXDMAEN */
+  s->crc_bytes = (cr1 & SPI_CR1_CRCL) ? 2u : 1u;
+
+  wait_bsy_clear(spi);
+  spi->CR1 = cr1;                         /* SPE=0 */
+  spi->CR2 = cr2;
+  spi->CR1 = cr1 | (1u<<6);               /* SPE=1 */
+
+  uint8_t bpi = (datasize <= 8) ? 1u : 2u;
+  if (bpi != s->bytes_per_item) {
+    s->bytes_per_item = bpi;
+    spi_prepare_dma(s);
+  }
+}
+
 /* ===== Callbacks do usuário ===== */
 void spi_set_callbacks(spi_drv_t *s, void (*on_complete)(void),
                                   void (*on_error)(uint32_t,uint32_t))
 {
   s->on_complete = on_complete;
   s->on_error    = on_error;
-  /* também guardamos as versões “do usuário” para multi-fase */
-  s->user_on_complete = on_complete;
-  s->user_on_error    = on_error;
 }
 
 
@@ -184,11 +311,11 @@ void spi_abort(spi_drv_t *s)
   SPI_TypeDef *spi = s->inst;
 
   /* desliga IRQs do SPI (TXEIE/RXNEIE ficam em CR2) */
-  spi->CR2 &= ~((1u<<7)|(1u<<6));
+  spi_irq_disable(s);
 
   /* desliga DMAs se ativos */
-  if (s->dma_tx) s->dma_tx->CCR &= ~DMA_CCR_EN;
-  if (s->dma_rx) s->dma_rx->CCR &= ~DMA_CCR_EN;
+  if (s->tx_ch_idx) dma_router_stop(s->tx_ch_idx);
+  if (s->rx_ch_idx) dma_router_stop(s->rx_ch_idx);
   s->tx_dma_active = s->rx_dma_active = 0;
 
   /* limpa OVR e estados */
@@ -198,68 +325,123 @@ void spi_abort(spi_drv_t *s)
   if (s->cfg.nss_mode == SPI_NSS_SOFT && s->cfg.cs_release) s->cfg.cs_release();
 
   s->busy = 0;
-  s->multi_active = 0;
-  s->phase = 0;
+  s->seg_n = 0;
 }
 
 /* ===== Wait ===== */
 void spi_wait(spi_drv_t *s){ while (s->busy) { __asm volatile("nop"); } }
 
-/* ===== Caminho IRQ ===== */
+/* ===== Caminho IRQ =====
+   FIFO de 32 bits: em 8 bits, um acesso de 16 bits ao DR move dois frames.
+   Itens "em voo" (escritos no TX e ainda não lidos do RX) ficam limitados à
+   capacidade do RXFIFO (4 bytes / 2 halfwords): o RX nunca transborda, por
+   maior que seja a latência da ISR. O fluxo é puxado pelo RXNE com FRXTH=0
+   (uma IRQ a cada 2 bytes); FRXTH=1 só para o último byte de contagem ímpar.
+   TXEIE serve apenas para o primeiro preenchimento. */
+#define SPI_CR2_FRXTH      (1u<<12)
+
+/* FRXTH=1 só quando falta exatamente 1 byte (dados + CRC, 8 bits); em 16 bits sempre 0 */
+static inline void spi_irq_rx_threshold(spi_drv_t *s){
+  SPI_TypeDef *spi = s->inst;
+  bool one = (s->bytes_per_item == 1) && (s->count - s->rx_idx + s->crc_left == 1u);
+  uint32_t cr2 = spi->CR2;
+  if (one != ((cr2 & SPI_CR2_FRXTH) != 0u))
+    spi->CR2 = one ? (cr2 | SPI_CR2_FRXTH) : (cr2 & ~SPI_CR2_FRXTH);
+}
+
 static void spi_irq_enable(spi_drv_t *s){
-  uint32_t cr2 = s->inst->CR2;
-  /* geramos clock mesmo em RX-only (TXEIE liga) e evitamos OVR mesmo em TX-only (RXNEIE liga) */
-  cr2 |= (1u<<6) | (1u<<7); /* RXNEIE | TXEIE */
+  spi_irq_rx_threshold(s);
+  /* TXEIE: primeiro preenchimento; RXNEIE conduz o resto */
+  s->inst->CR2 |= (1u<<6) | (1u<<7); /* RXNEIE | TXEIE */
+}
+static void spi_irq_disable(spi_drv_t *s){
+  /* volta ao FRXTH da config (8 bits: 1) para os caminhos DMA/polling */
+  uint32_t cr2 = s->inst->CR2 & ~((1u<<7)|(1u<<6));
+  if (s->bytes_per_item == 1) cr2 |= SPI_CR2_FRXTH;
   s->inst->CR2 = cr2;
 }
-static void spi_irq_disable(spi_drv_t *s){ s->inst->CR2 &= ~((1u<<7)|(1u<<6)); }
 
-static void spi_irq_handler(spi_drv_t *s){
+/* esvazia o RXFIFO pelo FRLVL (2 bytes por acesso quando possível) */
+static void spi_irq_drain(spi_drv_t *s){
   SPI_TypeDef *spi = s->inst;
-  uint32_t sr = spi->SR;
-
-  /* RXNE */
-  if ((sr & (1u<<0)) && (spi->CR2 & (1u<<6))) {
-    if (s->bytes_per_item == 1) {
-      uint8_t d = *(volatile uint8_t*)&spi->DR;
-      if (s->rx_buf && s->rx_idx < s->count) ((uint8_t*)s->rx_buf)[s->rx_idx] = d;
+  uint32_t lvl;
+  while (s->rx_idx < s->count && (lvl = SPI_SR_FRLVL(spi->SR)) != 0u) {
+    uint32_t i = s->rx_idx;
+    if (s->bytes_per_item == 2) {
+      if (lvl < 2u) break;                           /* meio halfword: ainda chegando */
+      uint16_t d = spi_dr_read16(spi);
+      if (s->rx_buf) ((uint16_t*)s->rx_buf)[i] = d;
+      s->rx_idx = i + 1u;
+    } else if (lvl >= 2u && s->count - i >= 2u) {
+      uint16_t d = spi_dr_read16(spi);
+      if (s->rx_buf) { ((uint8_t*)s->rx_buf)[i] = (uint8_t)d; ((uint8_t*)s->rx_buf)[i + 1u] = (uint8_t)(d >> 8); }
+      s->rx_idx = i + 2u;
     } else {
-      uint16_t d = *(volatile uint16_t*)&spi->DR;
-      if (s->rx_buf && s->rx_idx < s->count) ((uint16_t*)s->rx_buf)[s->rx_idx] = d;
+      uint8_t d = spi_dr_read8(spi);
+      if (s->rx_buf) ((uint8_t*)s->rx_buf)[i] = d;
+      s->rx_idx = i + 1u;
     }
-    if (s->rx_idx < s->count) s->rx_idx++;
   }
+  /* CRC do escravo: lido e descartado (a conferência é do hardware) */
+  while (s->rx_idx >= s->count && s->crc_left && (lvl = SPI_SR_FRLVL(spi->SR)) != 0u) {
+    if (s->bytes_per_item == 2) { if (lvl < 2u) break; (void)spi_dr_read16(spi); s->crc_left = 0; }
+    else                        { (void)spi_dr_read8(spi); s->crc_left--; }
+  }
+}
 
-  /* TXE */
-  if ((sr & (1u<<1)) && (spi->CR2 & (1u<<7))) {
-    if (s->tx_idx < s->count) {
-      if (s->bytes_per_item == 1) {
-        uint8_t out = s->tx_buf ? ((const uint8_t*)s->tx_buf)[s->tx_idx] : 0xFFu;
-        *(volatile uint8_t*)&spi->DR = out;
-      } else {
-        uint16_t out = s->tx_buf ? ((const uint16_t*)s->tx_buf)[s->tx_idx] : 0xFFFFu;
-        *(volatile uint16_t*)&spi->DR = out;
-      }
-      s->tx_idx++;
+/* completa o TX até 4 bytes em voo (menos o CRC, que chega depois dos dados);
+   CRCNEXT logo após o último dado entrar no TXFIFO */
+static void spi_irq_refill(spi_drv_t *s){
+  SPI_TypeDef *spi = s->inst;
+  uint32_t cap = (4u - (s->cfg.crc ? s->crc_bytes : 0u)) / s->bytes_per_item;
+  bool crc_next = s->cfg.crc && s->tx_idx < s->count;
+  while (s->tx_idx < s->count) {
+    uint32_t i = s->tx_idx, room = cap - (i - s->rx_idx);
+    if (room == 0u) break;
+    if (s->bytes_per_item == 2) {
+      spi_dr_write16(spi, s->tx_buf ? ((const uint16_t*)s->tx_buf)[i] : s->tx_dummy16);
+      s->tx_idx = i + 1u;
+    } else if (room >= 2u && s->count - i >= 2u) {
+      const uint8_t *t = (const uint8_t*)s->tx_buf;
+      spi_dr_write16(spi, t ? (uint16_t)(t[i] | (t[i + 1u] << 8)) : (uint16_t)(s->tx_dummy8 * 0x0101u));
+      s->tx_idx = i + 2u;
     } else {
-      /* tudo transmitido → podemos desligar TXEIE (RXNEIE fica ligado até colher todo RX) */
-      spi->CR2 &= ~(1u<<7);
+      spi_dr_write8(spi, s->tx_buf ? ((const uint8_t*)s->tx_buf)[i] : s->tx_dummy8);
+      s->tx_idx = i + 1u;
     }
   }
+  if (crc_next && s->tx_idx >= s->count) spi->CR1 |= SPI_CR1_CRCNEXT;
+}
 
-  /* erros (MODF/OVR/CRCERR) */
-  if (sr & ((1u<<6)|(1u<<5)|(1u<<4))) {
+static void spi_irq_handler(spi_drv_t *s){
+  SPI_TypeDef *spi = s->inst;
+  uint32_t sr = spi->SR;
+
+  /* erros (MODF/OVR); CRCERR é tratado no fim, em spi_crc_check */
+  if (sr & ((1u<<6)|(1u<<5))) {
     (void)spi->DR; (void)spi->SR; /* limpa OVR */
     if (s->on_error) s->on_error(sr, 0);
   }
 
+  spi_irq_drain(s);
+  spi_irq_refill(s);
+  spi->CR2 &= ~(1u<<7);          /* TXEIE: daqui em diante o RXNE puxa o fluxo */
+  spi_irq_rx_threshold(s);
+
   /* terminou? (todos itens TX e RX processados) */
-  if (s->tx_idx >= s->count && s->rx_idx >= s->count) {
+  if (s->tx_idx >= s->count && s->rx_idx >= s->count && !s->crc_left) {
     spi_irq_disable(s);
     spi_finish(s);
   }
 }
 
+/* ===== Caminho POLL =====
+   Mesmo empacotamento do IRQ, em laço e sem interrupções. */
+static void spi_poll_run(spi_drv_t *s){
+  while (s->rx_idx < s->count || s->crc_left) { spi_irq_drain(s); spi_irq_refill(s); }
+  spi_finish(s);
+}
+
 /* ===== Caminho DMA ===== */
 static void spi_dma_start(spi_drv_t *s)
 {
@@ -271,44 +453,30 @@ static void spi_dma_start(spi_drv_t *s)
   s->rx_dma_active = 0; s->tx_dma_active = 0;
 
   /* RX: se o engine é DMA OU se precisamos drenar RX (TX-only por DMA) */
-  bool need_rx_dma = (s->cfg.rx_engine == SPI_ENGINE_DMA) ||
-                     ((s->cfg.tx_engine == SPI_ENGINE_DMA) && (s->rx_buf == NULL));
+  bool need_rx_dma = eng_dma(s->cfg.rx_engine) ||
+                     (eng_dma(s->cfg.tx_engine) && (s->rx_buf == NULL));
   if (need_rx_dma) {
-    DMA_Channel_TypeDef *ch = s->dma_rx;
-    ch->CCR &= ~DMA_CCR_EN;
-    ch->CPAR  = (uint32_t)&spi->DR;
-    ch->CNDTR = s->count;
-    if (s->bytes_per_item == 1) {
-      ch->CMAR = (uint32_t)(s->rx_buf ? s->rx_buf : &s->rx_discard8);
-      ch->CCR  = (s->rx_buf ? DMA_CCR_MINC : 0) | DMA_CCR_PL_HIGH | DMA_CCR_TCIE | DMA_CCR_TEIE;
+    if (s->rx_buf) {
+      dma_router_restart(s->rx_ch_idx, (uint32_t)s->rx_buf, (uint16_t)s->count);
     } else {
-      ch->CMAR = (uint32_t)(s->rx_buf ? s->rx_buf : &s->rx_discard16);
-      ch->CCR  = (s->rx_buf ? DMA_CCR_MINC : 0) | DMA_CCR_PL_HIGH | DMA_CCR_TCIE | DMA_CCR_TEIE
-               | DMA_CCR_PSIZE_16 | DMA_CCR_MSIZE_16;
+      void *discard = (s->bytes_per_item == 1) ? (void*)&s->rx_discard8 : (void*)&s->rx_discard16;
+      dma_router_restart_fixed(s->rx_ch_idx, (uint32_t)discard, (uint16_t)s->count);
     }
-    ch->CCR |= DMA_CCR_EN;
     s->dma_rx_done = 0;
     s->rx_dma_active = 1;
     cr2 |= (1u<<0); /* RXDMAEN */
   }
 
   /* TX: se o engine é DMA OU se precisamos gerar clock (RX-only por DMA) */
-  bool need_tx_dma = (s->cfg.tx_engine == SPI_ENGINE_DMA) ||
-                     ((s->cfg.rx_engine == SPI_ENGINE_DMA) && (s->tx_buf == NULL));
+  bool need_tx_dma = eng_dma(s->cfg.tx_engine) ||
+                     (eng_dma(s->cfg.rx_engine) && (s->tx_buf == NULL));
   if (need_tx_dma) {
-    DMA_Channel_TypeDef *ch = s->dma_tx;
-    ch->CCR &= ~DMA_CCR_EN;
-    ch->CPAR  = (uint32_t)&spi->DR;
-    ch->CNDTR = s->count;
-    if (s->bytes_per_item == 1) {
-      ch->CMAR = (uint32_t)(s->tx_buf ? s->tx_buf : &s->tx_dummy8);
-      ch->CCR  = DMA_CCR_DIR | (s->tx_buf ? DMA_CCR_MINC : 0) | DMA_CCR_PL_HIGH | DMA_CCR_TCIE | DMA_CCR_TEIE;
+    if (s->tx_buf) {
+      dma_router_restart(s->tx_ch_idx, (uint32_t)s->tx_buf, (uint16_t)s->count);
     } else {
-      ch->CMAR = (uint32_t)(s->tx_buf ? s->tx_buf : &s->tx_dummy16);
-      ch->CCR  = DMA_CCR_DIR | (s->tx_buf ? DMA_CCR_MINC : 0) | DMA_CCR_PL_HIGH | DMA_CCR_TCIE | DMA_CCR_TEIE
-               | DMA_CCR_PSIZE_16 | DMA_CCR_MSIZE_16;
+      const void *dummy = (s->bytes_per_item == 1) ? (const void*)&s->tx_dummy8 : (const void*)&s->tx_dummy16;
+      dma_router_restart_fixed(s->tx_ch_idx, (uint32_t)dummy, (uint16_t)s->count);
     }
-    ch->CCR |= DMA_CCR_EN;
     s->dma_tx_done = 0;
     s->tx_dma_active = 1;
     cr2 |= (1u<<1); /* TXDMAEN */
@@ -318,15 +486,30 @@ static void spi_dma_start(spi_drv_t *s)
 }
 
 /* ===== API principal ===== */
+bool spi_transfer_segs_async(spi_drv_t *s, const spi_seg_t *segs, uint8_t n)
+{
+  if (s->busy || n == 0u) return false;
+  /* CS mantido entre segmentos só com NSS_SOFT */
+  if (n > 1u && s->cfg.nss_mode != SPI_NSS_SOFT) return false;
+  /* segmento vazio deixaria o DMA com CNDTR = 0 (nunca termina); acima de
+     SPI_DMA_MAX_ITEMS o CNDTR trunca (o AUTO já cai para IRQ) */
+  for (uint8_t i = 0; i < n; i++) {
+    if (segs[i].len == 0u) return false;
+    if (segs[i].len > SPI_DMA_MAX_ITEMS && spi_choose_engine(s, segs[i].len) == SPI_ENGINE_DMA) return false;
+  }
+
+  s->busy    = 1;
+  s->segs    = segs;
+  s->seg_n   = n;
+  s->seg_idx = 0;
+  return spi_start_phase(s, &segs[0], /*assert_cs=*/true);
+}
+
 bool spi_transfer_async(spi_drv_t *s, const void *tx, void *rx, uint32_t count)
 {
   if (s->busy) return false;
-  s->busy  = 1;
-  s->multi_active = 0;   /* transação normal (fase única) */
-  s->phase = 1;
-
-  /* Fase única com assert de CS se NSS_SOFT */
-  return spi_start_phase(s, tx, rx, count, /*assert_cs=*/true);
+  s->seg_local[0] = (spi_seg_t){ .tx = tx, .rx = rx, .len = count, .fill = 0xFFFFu };
+  return spi_transfer_segs_async(s, s->seg_local, 1u);
 }
 
 bool spi_write_then_read_async(spi_drv_t *s,
@@ -334,38 +517,118 @@ bool spi_write_then_read_async(spi_drv_t *s,
                                void *rx2, uint32_t n_rx2)
 {
   if (s->busy) return false;
+  s->seg_local[0] = (spi_seg_t){ .tx = tx1,  .rx = NULL, .len = n_tx1, .fill = 0xFFFFu };
+  s->seg_local[1] = (spi_seg_t){ .tx = NULL, .rx = rx2,  .len = n_rx2, .fill = 0xFFFFu };
+  return spi_transfer_segs_async(s, s->seg_local, 2u);
+}
+
 
-  /* Requer NSS_SOFT para manter CS baixo entre as fases */
-  if (s->cfg.nss_mode != SPI_NSS_SOFT) {
-    /* fallback: pode-se emular com duas chamadas, mas CS vai “pulsar”.
-       Aqui retornamos false para deixar o uso explícito. */
-    return false;
-  }
 
-  s->busy = 1;
-  s->multi_active = 1;
-  s->phase = 1;
+/* ===== Calibração do AUTO =====
+   Cada ponto roda a transação com o engine forçado (pelos próprios limiares)
+   e desconta do tempo total os giros do laço de espera, cujo custo por volta
+   é medido antes com o mesmo laço. */
+static const uint16_t k_cal_len[SPI_CAL_POINTS] = { 1, 2, 4, 8, 16, 32, SPI_CAL_MAX_ITEMS };
+static uint16_t s_cal_buf[SPI_CAL_MAX_ITEMS];          /* estático: alvo de DMA */
 
-  /* preparar fase 2 */
-  s->phase2_tx    = NULL;     /* dummy clock na segunda fase */
-  s->phase2_rx    = rx2;
-  s->phase2_count = n_rx2;
+static inline uint32_t cal_elapsed(uint32_t t0){ return (t0 - SYST_CVR) & 0xFFFFFFu; }
 
-  /* fase 1: envia comando (RX descartado) com CS assertado */
-  return spi_start_phase(s, tx1, /*rx=*/NULL, n_tx1, /*assert_cs=*/true);
+static uint32_t __attribute__((noinline)) cal_spin(volatile uint8_t *flag, uint32_t limit){
+  uint32_t n = 0;
+  while (*flag && n != limit) n++;
+  return n;
 }
 
+static uint32_t cal_run(spi_drv_t *s, spi_engine_t e, uint32_t n, uint32_t spin_q8){
+  s->auto_poll_max = (e == SPI_ENGINE_POLL) ? 0xFFFFu : 0u;
+  s->auto_dma_min  = (e == SPI_ENGINE_DMA)  ? 0u : 0xFFFFu;
+
+  uint32_t best = 0xFFFFFFFFu;
+  for (uint8_t k = 0; k < 2; k++) {                   /* menor de duas medições */
+    uint32_t t0 = SYST_CVR;
+    spi_transfer_async(s, s_cal_buf, s_cal_buf, n);
+    uint32_t spins = cal_spin(&s->busy, 0xFFFFFFFFu);
+    uint32_t t = cal_elapsed(t0), idle = (spins * spin_q8) >> 8;
+    t = (t > idle) ? t - idle : 0u;
+    if (t < best) best = t;
+  }
+  return best;
+}
 
+/* maior tamanho em que a[] custa <= b[] (cruzamento interpolado entre os pontos);
+   0 se a já perde no primeiro ponto */
+static uint16_t cal_cross(const uint32_t *a, const uint32_t *b){
+  if (a[0] > b[0]) return 0;
+  for (uint8_t i = 1; i < SPI_CAL_POINTS; i++) {
+    if (a[i] > b[i]) {
+      uint32_t l0 = k_cal_len[i - 1], l1 = k_cal_len[i];
+      uint32_t d0 = b[i - 1] - a[i - 1], d1 = a[i] - b[i];
+      return (uint16_t)(l0 + (l1 - l0) * d0 / (d0 + d1));
+    }
+  }
+  return 0xFFFFu;
+}
+
+bool spi_calibrate(spi_drv_t *s, spi_calib_t *out)
+{
+  if (s->busy) return false;
+
+  /* sem CS e sem callbacks do usuário/barramento durante a medição */
+  spi_drv_config_t cfg = s->cfg;
+  void (*oc)(void) = s->on_complete;
+  void (*bd)(struct spi_drv_s*) = s->bus_done;
+  s->cfg.tx_engine = s->cfg.rx_engine = SPI_ENGINE_AUTO;
+  s->cfg.cs_assert = s->cfg.cs_release = NULL;
+  s->on_complete = NULL;
+  s->bus_done = NULL;
+
+  /* SysTick livre de 24 bits, sem IRQ */
+  uint32_t csr = SYST_CSR, rvr = SYST_RVR;
+  SYST_CSR = 0; SYST_RVR = 0xFFFFFFu; SYST_CVR = 0;
+  SYST_CSR = SYST_CSR_CLKSOURCE | SYST_CSR_ENABLE;
+
+  /* custo por volta do laço de espera (Q8) */
+  volatile uint8_t one = 1;
+  uint32_t t0 = SYST_CVR;
+  cal_spin(&one, 1024u);
+  uint32_t spin_q8 = cal_elapsed(t0) >> 2;            /* (t << 8) / 1024 */
+
+  spi_calib_t c;
+  for (uint8_t i = 0; i < SPI_CAL_POINTS; i++) {
+    uint32_t n = k_cal_len[i];
+    c.len[i]  = (uint16_t)n;
+    c.poll[i] = cal_run(s, SPI_ENGINE_POLL, n, spin_q8);
+    c.irq[i]  = cal_run(s, SPI_ENGINE_IRQ,  n, spin_q8);
+    c.dma[i]  = s->rx_ch_idx ? cal_run(s, SPI_ENGINE_DMA, n, spin_q8) : 0xFFFFFFFFu;
+  }
+
+  SYST_CSR = 0; SYST_RVR = rvr; SYST_CVR = 0; SYST_CSR = csr;
+
+  /* POLL enquanto ganhar dos dois; depois IRQ até o DMA ficar mais barato */
+  uint32_t best_async[SPI_CAL_POINTS];
+  for (uint8_t i = 0; i < SPI_CAL_POINTS; i++) best_async[i] = (c.irq[i] < c.dma[i]) ? c.irq[i] : c.dma[i];
+  c.poll_max = cal_cross(c.poll, best_async);
+  uint16_t irq_max = cal_cross(c.irq, c.dma);
+  c.dma_min = (irq_max == 0xFFFFu) ? 0xFFFFu : (uint16_t)(irq_max + 1u);
+
+  s->cfg = cfg;
+  s->on_complete = oc;
+  s->bus_done = bd;
+  s->auto_poll_max = c.poll_max;
+  s->auto_dma_min  = c.dma_min;
+  if (out) *out = c;
+  return true;
+}
 
 /* ===== ISRs de SPI ===== */
 static void spi_isr_common(spi_drv_t *s){
   if (!s || !s->busy) return;
   /* caminho IRQ: tratamos fluxo; em DMA apenas checamos erros */
-  if (s->cfg.tx_engine == SPI_ENGINE_IRQ || s->cfg.rx_engine == SPI_ENGINE_IRQ) {
+  if (s->xfer_engine == SPI_ENGINE_IRQ) {
     spi_irq_handler(s);
   } else {
     uint32_t sr = s->inst->SR;
-    if (sr & ((1u<<6)|(1u<<5)|(1u<<4))) {
+    if (sr & ((1u<<6)|(1u<<5))) {
       (void)s->inst->DR; (void)s->inst->SR;
       if (s->on_error) s->on_error(sr, 0);
     }
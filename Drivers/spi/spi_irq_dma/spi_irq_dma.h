@@ -13,10 +13,27 @@
 /* ===== Configuração ===== */
 
 typedef enum {
-	SPI_ENGINE_IRQ = 0,
-	SPI_ENGINE_DMA = 1
+	SPI_ENGINE_IRQ  = 0,
+	SPI_ENGINE_DMA  = 1,
+	SPI_ENGINE_POLL = 2,   /* síncrono: a transação termina (e chama o callback) antes de retornar */
+	SPI_ENGINE_AUTO = 3    /* POLL/IRQ/DMA por transação, pelo nº de itens (ver spi_calibrate) */
 } spi_engine_t;
 
+/* AUTO antes de spi_calibrate: até POLL_MAX itens por polling, a partir de DMA_MIN por DMA */
+#ifndef SPI_AUTO_POLL_MAX
+#define SPI_AUTO_POLL_MAX   4u
+#endif
+#ifndef SPI_AUTO_DMA_MIN
+#define SPI_AUTO_DMA_MIN    32u
+#endif
+
+/* maior segmento por DMA (CNDTR de 16 bits); acima disso o AUTO usa IRQ */
+#define SPI_DMA_MAX_ITEMS   0xFFFFu
+
+/* tamanhos medidos por spi_calibrate: 1, 2, 4 ... 64 itens */
+#define SPI_CAL_POINTS      7u
+#define SPI_CAL_MAX_ITEMS   64u
+
 typedef struct {
   /* núcleo SPI */
   spi_mode_t      mode;
@@ -28,9 +45,16 @@ typedef struct {
   spi_nss_mode_t  nss_mode;      /* SOFT → usa callbacks de CS; HARD_AUTO → SSOE */
   uint8_t         nssp_pulse;    /* 1: CR2.NSSP (se suportado) */
 
-  /* seleção do “engine” */
-  spi_engine_t    tx_engine;     /* IRQ ou DMA */
-  spi_engine_t    rx_engine;     /* IRQ ou DMA */
+  /* seleção do “engine” (AUTO em qualquer um dos dois vale para ambos) */
+  spi_engine_t    tx_engine;     /* IRQ, DMA, POLL ou AUTO */
+  spi_engine_t    rx_engine;     /* IRQ, DMA, POLL ou AUTO */
+
+  /* CRC por hardware: anexado ao fim de cada transação (ou fase) e
+     conferido na recepção. Falha → on_error(sr com CRCERR, 0) antes do
+     on_complete. O CRC do escravo precisa vir logo após os dados. */
+  uint8_t         crc;           /* 1: CRCEN */
+  uint8_t         crc_16bit;     /* 0: CRC-8 (CRCL=0); 1: CRC-16 (forçado em datasize 16) */
+  uint16_t        crc_poly;      /* CRCPR; 0 → 0x7 (reset) */
 
   /* prioridade da IRQ do SPI (DMA é do dma_router_init) */
   uint8_t         nvic_prio_spi; /* 0..3 (Cortex-M0: 2 MSBs efetivos) */
@@ -40,8 +64,18 @@ typedef struct {
   void (*cs_release)(void);
 } spi_drv_config_t;
 
-/* ===== Handle ===== */
+/* Segmento de uma transação com vários trechos sob o mesmo CS.
+   tx NULL: envia fill (byte baixo em 8 bits); rx NULL: descarta.
+   len em itens (bytes ou halfwords). */
 typedef struct {
+  const void *tx;
+  void       *rx;
+  uint32_t    len;
+  uint16_t    fill;
+} spi_seg_t;
+
+/* ===== Handle ===== */
+typedef struct spi_drv_s {
   SPI_TypeDef *inst;
   spi_drv_config_t cfg;
 
@@ -65,6 +99,17 @@ typedef struct {
   volatile uint8_t dma_rx_done;    /* setado pelo callback do router */
   volatile uint8_t dma_tx_done;
 
+  /* CRC: bytes de CRC por transação, quantos ainda faltam ler do RXFIFO */
+  uint8_t           crc_bytes;
+  volatile uint8_t  crc_left;
+  volatile uint8_t  crc_fail;      /* 1: última transação com CRCERR */
+  volatile uint32_t crc_errors;
+
+  /* engine da transação corrente e limiares do AUTO (em itens) */
+  uint8_t  xfer_engine;
+  uint16_t auto_poll_max;          /* count <= poll_max → POLL */
+  uint16_t auto_dma_min;           /* count >= dma_min  → DMA (senão IRQ) */
+
   /* dummies/sumidouros p/ modos only */
   uint16_t tx_dummy16; uint8_t tx_dummy8;
   uint16_t rx_discard16; uint8_t rx_discard8;
@@ -73,16 +118,16 @@ typedef struct {
   void (*on_complete)(void);
   void (*on_error)(uint32_t sr, uint32_t dma_flags);
 
-  /* ===== Multi-fase (write-then-read com CS baixo em NSS_SOFT) ===== */
-  uint8_t  multi_active;      /* 1=transação 2-fases ativa */
-  uint8_t  phase;             /* 1 ou 2 */
-  const void *phase2_tx;      /* normalmente NULL (dummy) */
-  void      *phase2_rx;
-  uint32_t   phase2_count;
+  /* ===== Segmentos (CS mantido do primeiro ao último) ===== */
+  const spi_seg_t *segs;
+  uint8_t   seg_n;
+  uint8_t   seg_idx;            /* segmento em andamento */
+  spi_seg_t seg_local[2];       /* usados por spi_transfer_async/write_then_read */
 
-  /* guardamos callbacks do usuário para chamar só ao fim da última fase */
-  void (*user_on_complete)(void);
-  void (*user_on_error)(uint32_t, uint32_t);
+  /* gerenciador de barramento (spi_bus): chamado no fim de cada transação,
+     no lugar de on_complete, com busy já em 0 */
+  void (*bus_done)(struct spi_drv_s *s);
+  void  *bus;
 } spi_drv_t;
 
 /* ===== API ===== */
@@ -90,7 +135,8 @@ void spi_init(spi_drv_t *s, SPI_TypeDef *inst, const spi_drv_config_t *cfg);
 
 /* inicia transação (full-duplex). Qualquer lado pode ser NULL.
    count = nº de itens (bytes se 8b, halfwords se 16b).
-   Retorna false se já estiver ocupado. */
+   Retorna false se já estiver ocupado, com count = 0 ou com count acima de
+   SPI_DMA_MAX_ITEMS num engine fixo em DMA. */
 bool spi_transfer_async(spi_drv_t *s, const void *tx, void *rx, uint32_t count);
 
 /* utilidades */
@@ -98,13 +144,44 @@ static inline bool spi_is_busy(const spi_drv_t *s){ return s->busy != 0; }
 void spi_wait(spi_drv_t *s);
 void spi_abort(spi_drv_t *s);
 
+/* Reconfigura CPOL/CPHA, baud, ordem de bits e largura (8/16) com o SPI
+   ocioso. Usado pelo spi_bus na troca de dispositivo. */
+void spi_set_format(spi_drv_t *s, spi_mode_t mode, spi_baud_t baud_div,
+                    spi_bit_order_t bit_order, spi_datasize_t datasize);
+
+/* Custo de CPU medido (ciclos de HCLK, via SysTick) por engine e tamanho.
+   Custo = tempo total menos o que sobrou para o laço de espera: no POLL é a
+   transação inteira; em IRQ/DMA é preparo + ISRs. */
+typedef struct {
+  uint16_t len[SPI_CAL_POINTS];
+  uint32_t poll[SPI_CAL_POINTS];
+  uint32_t irq[SPI_CAL_POINTS];
+  uint32_t dma[SPI_CAL_POINTS];    /* UINT32_MAX se não houver canais DMA */
+  uint16_t poll_max;               /* limiares resultantes (cruzamentos interpolados) */
+  uint16_t dma_min;
+} spi_calib_t;
+
+/* Mede os três engines no clock/baud/largura atuais e grava os limiares do
+   AUTO. Gera clock no barramento sem chamar cs_assert (com HARD_AUTO o NSS
+   desce): chame no boot, antes de selecionar dispositivos, com IRQs
+   habilitadas. Usa o SysTick livre durante a medição e o restaura depois
+   (a fase do tick se perde). out pode ser NULL. false se ocupado. */
+bool spi_calibrate(spi_drv_t *s, spi_calib_t *out);
+
 void spi_set_callbacks(spi_drv_t *s, void (*on_complete)(void),
                                   void (*on_error)(uint32_t,uint32_t));
 
-/* Mantém CS baixo (NSS_SOFT) entre as duas fases.
-   Fase 1: envia tx1 (n_tx1 itens), RX descartado
-   Fase 2: lê rx2 (n_rx2 itens), TX dummy
-   Retorna false se o SPI estiver ocupado. */
+/* Transação de n segmentos sob um único CS (ex.: comando + endereço +
+   dummy + dados). Os segmentos são encadeados na ISR (DMA/IRQ), sem soltar
+   o CS e sem callback entre eles; on_complete só no fim do último.
+   O array precisa continuar válido até o fim. Cada segmento escolhe o
+   próprio engine (AUTO) e, com CRC, leva o próprio CRC.
+   Mais de um segmento exige NSS_SOFT. false se ocupado, se algum segmento
+   tiver len = 0 ou, com engine fixo em DMA, len > SPI_DMA_MAX_ITEMS. */
+bool spi_transfer_segs_async(spi_drv_t *s, const spi_seg_t *segs, uint8_t n);
+
+/* Atalho de 2 segmentos: envia tx1 (n_tx1 itens, RX descartado) e lê rx2
+   (n_rx2 itens, TX 0xFF) com o CS baixo. false se ocupado ou sem NSS_SOFT. */
 bool spi_write_then_read_async(spi_drv_t *s,
                                const void *tx1, uint32_t n_tx1,
                                void *rx2, uint32_t n_rx2);
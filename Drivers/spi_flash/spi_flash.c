@@ -0,0 +1,369 @@
+#include "spi_flash.h"
+
+/* comandos */
+#define FL_RDSR   0x05u
+#define FL_WREN   0x06u
+#define FL_PP     0x02u
+#define FL_FREAD  0x0Bu
+#define FL_RDID   0x9Fu
+#define FL_RDSFDP 0x5Au
+#define FL_EN4B   0xB7u
+#define FL_CE     0xC7u
+#define FL_SR_WIP 0x01u
+
+enum { OP_NONE = 0, OP_PROBE, OP_READ, OP_PROG, OP_ERASE };
+
+/* step = o que está em andamento (ou acabou de terminar) */
+enum { ST_START = 0, ST_ID, ST_SFDP_HDR, ST_BFPT, ST_4B, ST_READ,
+       ST_WREN, ST_CMD, ST_WAIT, ST_RDSR };
+
+static spi_flash_t *s_fl = NULL;
+
+/* Passos podem terminar dentro da própria chamada (engine POLL/AUTO): o
+   on_complete só marca s_again e quem está em fl_run executa o passo
+   seguinte, sem recursão. */
+static volatile uint8_t s_in_step, s_again;
+
+static void fl_step(spi_flash_t *f);
+
+static void fl_run(void){
+  uint32_t pm = irq_lock();
+  if (s_in_step) { s_again = 1; irq_unlock(pm); return; }
+  s_in_step = 1;
+  irq_unlock(pm);
+
+  for (;;) {
+    fl_step(s_fl);
+    pm = irq_lock();
+    if (!s_again) { s_in_step = 0; irq_unlock(pm); return; }
+    s_again = 0;
+    irq_unlock(pm);
+  }
+}
+
+static void fl_done(spi_flash_t *f, bool ok){
+  spi_flash_cb_t cb = f->cb;
+  void *ctx = f->ctx;
+  ok = ok && f->ok;
+  f->step = ST_START;
+  f->op = OP_NONE;          /* antes do callback: ele pode iniciar outra operação */
+  if (cb) cb(ok, ctx);
+}
+
+static void fl_on_complete(void){ if (s_fl && s_fl->op) fl_run(); }
+
+/* CRCERR/OVR: a transação segue e a operação termina com ok = false.
+   Erro de DMA: a transação não termina sozinha. */
+static void fl_on_error(uint32_t sr, uint32_t dma_flags){
+  spi_flash_t *f = s_fl;
+  (void)sr;
+  if (!f || !f->op) return;
+  f->ok = 0;
+  if (dma_flags) { spi_abort(f->s); fl_done(f, false); }
+}
+
+static uint8_t fl_put_addr(const spi_flash_t *f, uint8_t *p, uint32_t a){
+  uint8_t n = 0;
+  if (f->addr_bytes == 4u) p[n++] = (uint8_t)(a >> 24);
+  p[n++] = (uint8_t)(a >> 16);
+  p[n++] = (uint8_t)(a >> 8);
+  p[n++] = (uint8_t)a;
+  return n;
+}
+
+static inline uint32_t rd32(const uint8_t *p){
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void fl_xfer(spi_flash_t *f, uint8_t step, const spi_seg_t *g, uint8_t n){
+  f->step = step;
+  if (!spi_transfer_segs_async(f->s, g, n)) fl_done(f, false);
+}
+
+/* comando de 1 byte (WREN, EN4B) */
+static void fl_cmd1(spi_flash_t *f, uint8_t step, uint8_t op){
+  f->op1 = op;
+  f->step = step;
+  if (!spi_transfer_async(f->s, &f->op1, NULL, 1u)) fl_done(f, false);
+}
+
+/* 5A: 3 bytes de endereço + 1 dummy, sempre */
+static void fl_read_sfdp(spi_flash_t *f, uint8_t step, uint32_t addr, uint32_t len){
+  uint8_t *h = f->hdr[0];
+  h[0] = FL_RDSFDP; h[1] = (uint8_t)(addr >> 16); h[2] = (uint8_t)(addr >> 8); h[3] = (uint8_t)addr; h[4] = 0;
+  f->seg[0] = (spi_seg_t){ .tx = h,    .rx = NULL,        .len = 5u,  .fill = 0xFFu };
+  f->seg[1] = (spi_seg_t){ .tx = NULL, .rx = f->sfdp_buf, .len = len, .fill = 0xFFu };
+  fl_xfer(f, step, f->seg, 2u);
+}
+
+/* ===== Geometria ===== */
+static void fl_add_erase(spi_flash_t *f, uint32_t size, uint8_t op){
+  if (f->n_erase >= 4u) return;
+  uint8_t i = f->n_erase++;
+  while (i && f->erase[i - 1u].size > size) { f->erase[i] = f->erase[i - 1u]; i--; }
+  f->erase[i].size = size;
+  f->erase[i].op   = op;
+}
+
+/* sem SFDP: capacidade = 2^(3º byte do JEDEC ID) */
+static bool fl_geom_jedec(spi_flash_t *f){
+  uint8_t c = f->jedec[2];
+  if (c < 16u || c > 31u) return false;
+  f->size = 1u << c;
+  f->page = 256u;
+  f->n_erase = 0;
+  fl_add_erase(f, 4096u, 0x20u);
+  fl_add_erase(f, 65536u, 0xD8u);
+  f->addr_bytes = (f->size > (1u << 24)) ? 4u : 3u;
+  return true;
+}
+
+/* BFPT (JESD216): DW1 modo de endereço, DW2 densidade, DW8/DW9 tipos de
+   erase, DW11 página (tabela de 11+ DWORDs) */
+static bool fl_geom_bfpt(spi_flash_t *f, uint8_t ndw){
+  const uint8_t *b = f->sfdp_buf;
+  uint32_t dw1 = rd32(b), dw2 = rd32(b + 4);
+
+  if (dw2 & 0x80000000u) {
+    uint32_t n = dw2 & 0x7FFFFFFFu;
+    if (n < 19u || n > 34u) return false;
+    f->size = 1u << (n - 3u);
+  } else {
+    f->size = (dw2 >> 3) + 1u;
+  }
+  if (f->size < 65536u) return false;
+
+  f->n_erase = 0;
+  for (uint8_t i = 0; i < 4u; i++) {
+    uint8_t e = b[28u + 2u * i], op = b[29u + 2u * i];
+    if (e && e < 32u) fl_add_erase(f, 1u << e, op);
+  }
+  if (!f->n_erase && (dw1 & 0x3u) == 0x1u) fl_add_erase(f, 4096u, (uint8_t)(dw1 >> 8));
+  if (!f->n_erase) return false;
+
+  f->page = 256u;
+  if (ndw >= 11u) {
+    uint8_t p = (uint8_t)((rd32(b + 40) >> 4) & 0xFu);
+    if (p >= 4u) f->page = (uint16_t)(1u << p);
+  }
+
+  /* 00: só 3 bytes; 01: 3 ou 4 (B7); 10: só 4 */
+  uint32_t am = (dw1 >> 17) & 0x3u;
+  f->addr_bytes = (am == 2u || (am == 1u && f->size > (1u << 24))) ? 4u : 3u;
+  return true;
+}
+
+static void fl_probe_end(spi_flash_t *f){
+  uint32_t am = (rd32(f->sfdp_buf) >> 17) & 0x3u;
+  if (f->addr_bytes == 4u && !(f->sfdp && am == 2u)) fl_cmd1(f, ST_4B, FL_EN4B);
+  else fl_done(f, true);
+}
+
+/* ===== Programação / erase ===== */
+/* prepara o próximo passo em hdr[cur^1]/seg_next (o atual pode estar no DMA) */
+static void fl_stage(spi_flash_t *f){
+  uint32_t left = f->len - f->pos;
+  uint32_t a = f->addr + f->pos;
+  uint8_t *h = f->hdr[f->cur ^ 1u];
+
+  f->next_n = 0;
+  if (!left) return;
+
+  if (f->op == OP_PROG) {
+    uint32_t n = f->page - (a & (f->page - 1u));
+    if (n > left) n = left;
+    h[0] = FL_PP;
+    uint8_t hl = (uint8_t)(1u + fl_put_addr(f, &h[1], a));
+    f->seg_next[0] = (spi_seg_t){ .tx = h, .rx = NULL, .len = hl, .fill = 0xFFu };
+    f->seg_next[1] = (spi_seg_t){ .tx = f->src + f->pos, .rx = NULL, .len = n, .fill = 0xFFu };
+    f->next_nseg = 2u;
+    f->next_n = n;
+  } else if (a == 0u && left == f->size) {
+    h[0] = FL_CE;
+    f->seg_next[0] = (spi_seg_t){ .tx = h, .rx = NULL, .len = 1u, .fill = 0xFFu };
+    f->next_nseg = 1u;
+    f->next_n = left;
+  } else {
+    /* maior tipo alinhado que cabe (o menor sempre cabe: addr/len validados) */
+    uint8_t i = f->n_erase - 1u;
+    while (i && ((a & (f->erase[i].size - 1u)) || f->erase[i].size > left)) i--;
+    h[0] = f->erase[i].op;
+    uint8_t hl = (uint8_t)(1u + fl_put_addr(f, &h[1], a));
+    f->seg_next[0] = (spi_seg_t){ .tx = h, .rx = NULL, .len = hl, .fill = 0xFFu };
+    f->next_nseg = 1u;
+    f->next_n = f->erase[i].size;
+  }
+  f->pos += f->next_n;
+}
+
+static void fl_issue_cmd(spi_flash_t *f){
+  f->seg[0] = f->seg_next[0];
+  f->seg[1] = f->seg_next[1];
+  f->cur ^= 1u;
+  if (f->op == OP_PROG) f->pages++; else f->erases++;
+  f->wip_ticks = 0;
+  fl_xfer(f, ST_CMD, f->seg, f->next_nseg);
+  /* enquanto o comando sai (e o chip trabalha), já deixa o próximo pronto */
+  if (f->op) fl_stage(f);
+}
+
+/* ===== Leitura ===== */
+static void fl_read_next(spi_flash_t *f){
+  uint32_t n = f->len - f->pos;
+  if (n > SPI_FLASH_READ_CHUNK) n = SPI_FLASH_READ_CHUNK;
+  uint8_t *h = f->hdr[0];
+  h[0] = FL_FREAD;
+  uint8_t hl = (uint8_t)(1u + fl_put_addr(f, &h[1], f->addr + f->pos));
+  h[hl++] = 0;                            /* dummy */
+  f->seg[0] = (spi_seg_t){ .tx = h,    .rx = NULL,            .len = hl, .fill = 0xFFu };
+  f->seg[1] = (spi_seg_t){ .tx = NULL, .rx = f->dst + f->pos, .len = n,  .fill = 0xFFu };
+  f->next_n = n;
+  fl_xfer(f, ST_READ, f->seg, 2u);
+}
+
+/* ===== Máquina de estados (on_complete do SPI, tick e início) ===== */
+static void fl_step(spi_flash_t *f){
+  switch (f->step) {
+    case ST_START:
+      if (f->op == OP_PROBE) {
+        f->hdr[0][0] = FL_RDID;
+        f->seg[0] = (spi_seg_t){ .tx = f->hdr[0], .rx = NULL,     .len = 1u, .fill = 0xFFu };
+        f->seg[1] = (spi_seg_t){ .tx = NULL,      .rx = f->jedec, .len = 3u, .fill = 0xFFu };
+        fl_xfer(f, ST_ID, f->seg, 2u);
+      } else if (f->op == OP_READ) {
+        fl_read_next(f);
+      } else {
+        fl_stage(f);
+        fl_cmd1(f, ST_WREN, FL_WREN);
+      }
+      break;
+
+    case ST_ID: {
+      uint8_t j = f->jedec[0] & f->jedec[1] & f->jedec[2];
+      uint8_t o = f->jedec[0] | f->jedec[1] | f->jedec[2];
+      if (j == 0xFFu || o == 0u) { fl_done(f, false); break; }
+      fl_read_sfdp(f, ST_SFDP_HDR, 0u, 16u);
+      break;
+    }
+
+    case ST_SFDP_HDR: {
+      const uint8_t *b = f->sfdp_buf;
+      /* assinatura "SFDP" e 1º parameter header = BFPT (ID 0xFF00) */
+      if (rd32(b) == 0x50444653u && b[8] == 0x00u && b[15] == 0xFFu && b[11] >= 9u) {
+        uint8_t ndw = (b[11] > 16u) ? 16u : b[11];
+        f->next_n = ndw;
+        fl_read_sfdp(f, ST_BFPT, rd32(&b[12]) & 0xFFFFFFu, 4u * ndw);
+      } else {
+        memset(f->sfdp_buf, 0, sizeof f->sfdp_buf);
+        if (!fl_geom_jedec(f)) { fl_done(f, false); break; }
+        fl_probe_end(f);
+      }
+      break;
+    }
+
+    case ST_BFPT:
+      f->sfdp = 1;
+      if (!fl_geom_bfpt(f, (uint8_t)f->next_n)) {
+        f->sfdp = 0;
+        memset(f->sfdp_buf, 0, sizeof f->sfdp_buf);
+        if (!fl_geom_jedec(f)) { fl_done(f, false); break; }
+      }
+      fl_probe_end(f);
+      break;
+
+    case ST_4B:
+      fl_done(f, true);
+      break;
+
+    case ST_READ:
+      f->pos += f->next_n;
+      if (f->pos < f->len) fl_read_next(f);
+      else fl_done(f, true);
+      break;
+
+    case ST_WREN:
+      fl_issue_cmd(f);
+      break;
+
+    case ST_CMD:
+      f->step = ST_WAIT;          /* daqui o spi_flash_tick assume */
+      break;
+
+    case ST_WAIT:                 /* chamado pelo tick */
+      f->wip_polls++;
+      f->step = ST_RDSR;
+      f->op1 = FL_RDSR;
+      if (!spi_write_then_read_async(f->s, &f->op1, 1u, &f->sr, 1u)) fl_done(f, false);
+      break;
+
+    case ST_RDSR:
+      if (f->sr & FL_SR_WIP) { f->step = ST_WAIT; break; }
+      if (!f->ok)            { fl_done(f, false); break; }
+      if (f->next_n) fl_cmd1(f, ST_WREN, FL_WREN);
+      else           fl_done(f, true);
+      break;
+
+    default:
+      break;
+  }
+}
+
+/* ===== API ===== */
+static bool fl_begin(spi_flash_t *f, uint8_t op, spi_flash_cb_t cb, void *ctx){
+  uint32_t pm = irq_lock();
+  if (f->op || f->s->busy) { irq_unlock(pm); return false; }
+  f->op = op;
+  irq_unlock(pm);
+
+  f->step = ST_START;
+  f->ok = 1;
+  f->cb = cb; f->ctx = ctx;
+  f->pos = 0;
+  f->next_n = 0;
+  fl_run();
+  return true;
+}
+
+bool spi_flash_probe_async(spi_flash_t *f, spi_drv_t *s, spi_flash_cb_t cb, void *ctx){
+  if (s->busy || s->bus_done || s->cfg.nss_mode != SPI_NSS_SOFT || s->bytes_per_item != 1u) return false;
+  memset(f, 0, sizeof(*f));
+  f->s = s;
+  f->addr_bytes = 3u;
+  s_fl = f;
+  spi_set_callbacks(s, fl_on_complete, fl_on_error);
+  return fl_begin(f, OP_PROBE, cb, ctx);
+}
+
+static bool fl_range_ok(const spi_flash_t *f, uint32_t addr, uint32_t len){
+  return f->size && addr <= f->size && len <= f->size - addr;
+}
+
+bool spi_flash_read_async(spi_flash_t *f, uint32_t addr, void *buf, uint32_t len,
+                          spi_flash_cb_t cb, void *ctx){
+  if (!fl_range_ok(f, addr, len) || !len) return false;
+  f->addr = addr; f->len = len; f->dst = (uint8_t*)buf;
+  return fl_begin(f, OP_READ, cb, ctx);
+}
+
+bool spi_flash_program_async(spi_flash_t *f, uint32_t addr, const void *data, uint32_t len,
+                             spi_flash_cb_t cb, void *ctx){
+  if (!fl_range_ok(f, addr, len) || !len) return false;
+  f->addr = addr; f->len = len; f->src = (const uint8_t*)data;
+  return fl_begin(f, OP_PROG, cb, ctx);
+}
+
+bool spi_flash_erase_async(spi_flash_t *f, uint32_t addr, uint32_t len,
+                           spi_flash_cb_t cb, void *ctx){
+  if (!len && !addr) len = f->size;
+  if (!fl_range_ok(f, addr, len) || !len || !f->n_erase) return false;
+  uint32_t m = f->erase[0].size - 1u;
+  if ((addr & m) || (len & m)) return false;
+  f->addr = addr; f->len = len;
+  return fl_begin(f, OP_ERASE, cb, ctx);
+}
+
+void spi_flash_tick(spi_flash_t *f){
+  if (!f->op || f->step != ST_WAIT) return;
+  if (++f->wip_ticks > SPI_FLASH_WIP_TIMEOUT) { fl_done(f, false); return; }
+  fl_run();
+}
@@ -0,0 +1,108 @@
+/*
+ * spi_flash.h
+ *
+ *  Flash SPI NOR sobre spi_irq_dma (segmentos sob um CS, DMA nas leituras e
+ *  programações longas; com engine AUTO, RDSR/WREN saem por polling).
+ *  - Descoberta: JEDEC ID (9F) e SFDP (5A): densidade, tipos de erase,
+ *    tamanho de página e modo de endereço. Sem SFDP, a capacidade vem do 3º
+ *    byte do JEDEC ID, com erase 4K (20) / 64K (D8) e página de 256 bytes.
+ *    Acima de 16 MB entra em modo de 4 bytes (B7).
+ *  - Tudo assíncrono, com callback ao fim (ok = false em timeout/ocupado).
+ *    Os passos de SPI seguem uns aos outros nas ISRs do driver SPI; o WIP é
+ *    consultado (RDSR) por spi_flash_tick(), chamado de um timer. Ao ver o
+ *    WIP zerar, o próprio tick já dispara WREN → próxima página/bloco.
+ *  - Programação em pipeline: enquanto o chip programa a página k, o
+ *    cabeçalho (PP + endereço) e os segmentos da página k+1 já ficam
+ *    prontos; os dados saem direto do buffer do usuário por DMA.
+ *  - Erase: em cada passo usa o maior tipo de erase alinhado que cabe no que
+ *    falta (SFDP); addr/len precisam estar alinhados ao menor tipo.
+ *  - O driver é dono dos callbacks do spi_drv_t (spi_set_callbacks) e usa o
+ *    CS dos callbacks da config (NSS_SOFT), fora do spi_bus. Largura de 8
+ *    bits. Uma flash por vez (a última do spi_flash_probe_async).
+ */
+
+#ifndef __SPI_FLASH_H__
+#define __SPI_FLASH_H__
+
+#include "spi_irq_dma.h"
+
+/* maior trecho lido por comando (o DMA conta até 65535 itens) */
+#ifndef SPI_FLASH_READ_CHUNK
+#define SPI_FLASH_READ_CHUNK   32768u
+#endif
+
+/* ticks sem o WIP zerar até desistir (em chamadas de spi_flash_tick) */
+#ifndef SPI_FLASH_WIP_TIMEOUT
+#define SPI_FLASH_WIP_TIMEOUT  100000u
+#endif
+
+typedef void (*spi_flash_cb_t)(bool ok, void *ctx);
+
+typedef struct {
+  uint32_t size;         /* bytes (potência de 2) */
+  uint8_t  op;
+} spi_flash_erase_t;
+
+typedef struct {
+  spi_drv_t *s;
+
+  /* geometria */
+  uint8_t   jedec[3];
+  uint8_t   sfdp;              /* 1: geometria veio do SFDP */
+  uint8_t   addr_bytes;        /* 3 ou 4 */
+  uint32_t  size;
+  uint16_t  page;
+  uint8_t   n_erase;
+  spi_flash_erase_t erase[4];  /* em ordem crescente de tamanho */
+
+  /* operação em andamento */
+  volatile uint8_t op;
+  volatile uint8_t step;
+  volatile uint8_t ok;         /* 0 após erro reportado pelo driver SPI */
+  uint32_t  addr, len, pos;
+  const uint8_t *src;
+  uint8_t  *dst;
+  spi_flash_cb_t cb;
+  void     *ctx;
+  uint32_t  wip_ticks;
+
+  /* buffers de comando (estáticos enquanto o DMA usa) */
+  uint8_t   hdr[2][6];         /* opcode + endereço (+ dummy), alternados no pipeline */
+  uint8_t   cur;               /* hdr em uso */
+  uint8_t   op1;               /* WREN / RDSR / EN4B */
+  uint8_t   sr;
+  spi_seg_t seg[2];            /* comando em andamento */
+  spi_seg_t seg_next[2];       /* próximo PP/erase, preparado durante o WIP */
+  uint8_t   next_nseg;
+  uint32_t  next_n;            /* bytes do próximo passo (0: acabou) */
+  uint8_t   sfdp_buf[64];
+
+  /* estatísticas */
+  volatile uint32_t pages, erases, wip_polls;
+} spi_flash_t;
+
+/* s já iniciado (spi_init) com NSS_SOFT e callbacks de CS.
+   Lê JEDEC ID e SFDP; cb ao fim (ok = false se não houver resposta). */
+bool spi_flash_probe_async(spi_flash_t *f, spi_drv_t *s, spi_flash_cb_t cb, void *ctx);
+
+/* FAST READ (0B) de qualquer tamanho, em trechos de SPI_FLASH_READ_CHUNK */
+bool spi_flash_read_async(spi_flash_t *f, uint32_t addr, void *buf, uint32_t len,
+                          spi_flash_cb_t cb, void *ctx);
+
+/* Page program com WREN por página, quebrando nas fronteiras de página.
+   data precisa continuar válido até o callback. */
+bool spi_flash_program_async(spi_flash_t *f, uint32_t addr, const void *data, uint32_t len,
+                             spi_flash_cb_t cb, void *ctx);
+
+/* Erase de [addr, addr+len): false se não alinhado ao menor tipo. len = 0
+   ou igual ao tamanho total com addr = 0 usa o chip erase (C7). */
+bool spi_flash_erase_async(spi_flash_t *f, uint32_t addr, uint32_t len,
+                           spi_flash_cb_t cb, void *ctx);
+
+/* Consulta o WIP se uma operação estiver esperando o chip (ISR de timer;
+   100 us a 1 ms). Use prioridade igual ou menor que a do SPI/DMA. */
+void spi_flash_tick(spi_flash_t *f);
+
+static inline bool spi_flash_busy(const spi_flash_t *f){ return f->op != 0u; }
+
+#endif /* __SPI_FLASH_H__ */
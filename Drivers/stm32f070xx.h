@@ -16,7 +16,16 @@
 #include "dma_router.h"
 
 /* ================= Base addresses essenciais ================= */
+#ifdef HOST_SIM
+/* Build no host (Drivers/sim): os periféricos viram RAM (modelo em sim_periph.c) */
+extern uint32_t sim_apb_mem[];
+extern uint32_t sim_ahb2_mem[];
+#define PERIPH_BASE        ((uintptr_t)sim_apb_mem)
+#define AHB2PERIPH_BASE    ((uintptr_t)sim_ahb2_mem)
+#else
 #define PERIPH_BASE        0x40000000UL
+#define AHB2PERIPH_BASE    0x48000000UL
+#endif
 #define AHBPERIPH_BASE     (PERIPH_BASE + 0x00020000UL)
 #define APB2PERIPH_BASE    (PERIPH_BASE + 0x00010000UL)
 #define APB1PERIPH_BASE    (PERIPH_BASE + 0x00000000UL)
@@ -125,7 +134,7 @@ typedef struct {
 #define RCC_APB1ENR_WWDGEN   (1u << 11)
 
 /* ---------------- FLASH ---------------- */
-#define FLASH_R_BASE       0x40022000UL
+#define FLASH_R_BASE       (PERIPH_BASE + 0x00022000UL) /* 0x40022000 */
 typedef struct {
     volatile uint32_t ACR;     // 0x00
     volatile uint32_t KEYR;    // 0x04
@@ -145,11 +154,11 @@ typedef struct {
 /* ================== MAPA DE REGISTRADORES BÁSICOS ================== */
 
 /* GPIO base (STM32F070) */
-#define GPIOA_BASE         (0x48000000UL)
-#define GPIOB_BASE         (0x48000400UL)
-#define GPIOC_BASE         (0x48000800UL)
-#define GPIOD_BASE         (0x48000C00UL)
-#define GPIOF_BASE         (0x48001400UL)
+#define GPIOA_BASE         (AHB2PERIPH_BASE + 0x0000UL)
+#define GPIOB_BASE         (AHB2PERIPH_BASE + 0x0400UL)
+#define GPIOC_BASE         (AHB2PERIPH_BASE + 0x0800UL)
+#define GPIOD_BASE         (AHB2PERIPH_BASE + 0x0C00UL)
+#define GPIOF_BASE         (AHB2PERIPH_BASE + 0x1400UL)
 
 typedef struct {
     volatile uint32_t MODER;    // 0x00
@@ -183,6 +192,13 @@ typedef struct {
 #define SYSCFG ((SYSCFG_TypeDef*)SYSCFG_BASE)
 #define RCC_APB2ENR_SYSCFGCOMPEN (1u << 0)
 
+/* SYSCFG_CFGR1: remapeamento de requisições DMA (0 = canal padrão) */
+#define SYSCFG_CFGR1_ADC_DMA_RMP      (1u << 8)   /* ADC:       CH1 → CH2 */
+#define SYSCFG_CFGR1_USART1TX_DMA_RMP (1u << 9)   /* USART1_TX: CH2 → CH4 */
+#define SYSCFG_CFGR1_USART1RX_DMA_RMP (1u << 10)  /* USART1_RX: CH3 → CH5 */
+#define SYSCFG_CFGR1_TIM16_DMA_RMP    (1u << 11)  /* TIM16:     CH3 → CH4 */
+#define SYSCFG_CFGR1_TIM17_DMA_RMP    (1u << 12)  /* TIM17:     CH1 → CH2 */
+
 /* EXTI */
 #define EXTI_BASE          (APB2PERIPH_BASE + 0x0400UL)
 typedef struct {
@@ -328,11 +344,15 @@ typedef struct {
 
 #define RCC_APB2ENR_USART1EN   (1u<<14)
 #define RCC_APB1ENR_USART2EN   (1u<<17)
+#define RCC_APB1ENR_USART3EN   (1u<<18)
+#define RCC_APB1ENR_USART4EN   (1u<<19)
 
 /* USART (linha F0) */
 
 #define USART1_BASE        (APB2PERIPH_BASE + 0x3800UL)
 #define USART2_BASE        (APB1PERIPH_BASE + 0x4400UL)
+#define USART3_BASE        (APB1PERIPH_BASE + 0x4800UL)
+#define USART4_BASE        (APB1PERIPH_BASE + 0x4C00UL)
 typedef struct {
     volatile uint32_t CR1;   // 0x00
     volatile uint32_t CR2;   // 0x04
@@ -348,6 +368,8 @@ typedef struct {
 } USART_TypeDef;
 #define USART1 ((USART_TypeDef*)USART1_BASE)
 #define USART2 ((USART_TypeDef*)USART2_BASE)
+#define USART3 ((USART_TypeDef*)USART3_BASE)
+#define USART4 ((USART_TypeDef*)USART4_BASE)
 
 
 /* DMA1 (F0) */
@@ -367,6 +389,7 @@ typedef struct {
 #define DMA1_Channel5 (&DMA1->CH[4])
 #define DMA1_Channel6 (&DMA1->CH[5])
 #define DMA1_Channel7 (&DMA1->CH[6])
+#define DMA1_CHANNEL(n) (&DMA1->CH[(n)-1])   /* n = 1..7 */
 
 #define RCC_AHBENR_DMA1EN    (1u<<0)
 
@@ -412,8 +435,15 @@ typedef struct {
 #define DMA_HTIF5 DMA_HTIF(5)
 #define DMA_TEIF5 DMA_TEIF(5)
 
+#ifdef HOST_SIM
+/* host: página própria, protegida pelo simulador para ver cada acesso da CPU */
+extern uint32_t sim_spi_mem[];
+#define SPI1_BASE          ((uintptr_t)sim_spi_mem)
+#define SPI2_BASE          ((uintptr_t)sim_spi_mem + 0x400UL)
+#else
 #define SPI1_BASE          (APB2PERIPH_BASE + 0x3000UL) /* 0x40013000 */
 #define SPI2_BASE          (APB1PERIPH_BASE + 0x3800UL) /* 0x40003800 */
+#endif
 typedef struct {
   volatile uint32_t CR1;     /* 0x00 */
   volatile uint32_t CR2;     /* 0x04 */
@@ -594,7 +624,7 @@ typedef struct {
 #define IWDG_SR_RVU      (1u<<1)
 
 #ifndef DBGMCU_BASE
-#define DBGMCU_BASE (0x40015800UL)
+#define DBGMCU_BASE (APB2PERIPH_BASE + 0x5800UL) /* 0x40015800 */
 #endif
 typedef struct {
     volatile uint32_t IDCODE; /* 0x00 */
@@ -612,4 +642,22 @@ typedef struct {
 #define DBGMCU_APB1_FZ_DBG_IWDG_STOP (1u<<12)
 #endif
 
+/* ---------------- CRC (F0x0: polinômio fixo 0x04C11DB7, 32 bits) ---------------- */
+#define CRC_BASE           (AHBPERIPH_BASE + 0x3000UL) /* 0x40023000 */
+typedef struct {
+    volatile uint32_t DR;    /* 0x00 (acesso 8/16/32 bits) */
+    volatile uint32_t IDR;   /* 0x04 */
+    volatile uint32_t CR;    /* 0x08 */
+    uint32_t RESERVED;       /* 0x0C */
+    volatile uint32_t INIT;  /* 0x10 */
+} CRC_TypeDef;
+#define CRC ((CRC_TypeDef*)CRC_BASE)
+
+#define RCC_AHBENR_CRCEN     (1u<<6)
+
+#define CRC_CR_RESET         (1u<<0)
+#define CRC_CR_REV_IN_Pos    5u        /* 00 nenhum, 01 byte, 10 half-word, 11 word */
+#define CRC_CR_REV_IN_BYTE   (1u<<5)
+#define CRC_CR_REV_OUT       (1u<<7)
+
 #endif /* __STM32F070XX_H__ */
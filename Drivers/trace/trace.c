@@ -0,0 +1,75 @@
+#include "trace.h"
+
+/* ===== Ring de palavras ===== */
+static uint32_t s_ring[TRACE_RING_WORDS];
+static volatile uint32_t s_head = 0, s_tail = 0;   /* índices livres (mascarados no uso) */
+static volatile uint32_t s_inflight = 0;           /* palavras em envio pelo DMA (0 = parado) */
+static volatile uint32_t s_dropped = 0;
+static uint8_t           s_seq = 0;
+static usart_drv_t      *s_u = NULL;
+
+#define RING_MASK  (TRACE_RING_WORDS - 1u)
+
+void trace_write(uint32_t hdr, const uint32_t *args, uint32_t nargs){
+  uint32_t pm = irq_lock();
+  uint32_t h = s_head;
+  hdr |= (uint32_t)s_seq++ << 16;
+  if (TRACE_RING_WORDS - (h - s_tail) < nargs + 1u) { s_dropped++; irq_unlock(pm); return; }
+  s_ring[h & RING_MASK] = hdr;
+  for (uint32_t i = 0; i < nargs; i++) s_ring[(h + 1u + i) & RING_MASK] = args[i];
+  s_head = h + 1u + nargs;
+  irq_unlock(pm);
+}
+
+uint32_t trace_dropped(void){ return s_dropped; }
+
+/* ===== Escoamento ===== */
+static void drain_kick(void);
+
+/* fim do envio por DMA (ISR): libera o trecho e manda o próximo */
+static void drain_done(const void *buf, void *ctx){
+  (void)buf; (void)ctx;
+  s_tail += s_inflight;
+  s_inflight = 0;
+  drain_kick();
+}
+
+/* trecho contíguo [tail, head ou fim do ring) direto do ring por DMA */
+static void drain_kick(void){
+  usart_drv_t *u = s_u;
+  if (!u || u->cfg.tx_engine != UDRV_ENGINE_DMA) return;
+
+  uint32_t pm = irq_lock();
+  if (s_inflight) { irq_unlock(pm); return; }
+  uint32_t t = s_tail, n = s_head - t, until_end = TRACE_RING_WORDS - (t & RING_MASK);
+  if (n > until_end) n = until_end;
+  if (n) {
+    s_inflight = n;
+    if (!usart_write_ref(u, &s_ring[t & RING_MASK], n * 4u, drain_done, NULL)) s_inflight = 0;
+  }
+  irq_unlock(pm);
+}
+
+void trace_poll(void){
+  usart_drv_t *u = s_u;
+  if (!u) return;
+  if (u->cfg.tx_engine == UDRV_ENGINE_DMA) { drain_kick(); return; }
+
+  /* TX=IRQ: cópia para o ring do driver, só do que couber sem bloquear */
+  for (;;) {
+    uint32_t t = s_tail, n = s_head - t, until_end = TRACE_RING_WORDS - (t & RING_MASK);
+    if (n > until_end) n = until_end;
+    uint32_t fr = usart_tx_free(u) / 4u;
+    if (n > fr) n = fr;
+    if (!n) return;
+    usart_write(u, &s_ring[t & RING_MASK], n * 4u);
+    s_tail = t + n;
+  }
+}
+
+void trace_init(usart_drv_t *u){
+  uint32_t pm = irq_lock();
+  s_u = u;
+  s_tail = s_head; s_inflight = 0; s_dropped = 0;
+  irq_unlock(pm);
+}
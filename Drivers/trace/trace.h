@@ -0,0 +1,83 @@
+/*
+ * trace.h
+ *
+ *  Log binário com formatação adiada (decodificado no host por Tools/trace_decode.py).
+ *  - TRACE("fmt", args...) não formata nada no alvo: grava no ring uma palavra de
+ *    cabeçalho (ID do formato + nº de argumentos + sequência) e os argumentos
+ *    crus de 32 bits. O texto do formato vai para a seção "trace_fmt", que não
+ *    é carregada na flash (ver STM32F070RBTX_FLASH.ld); o ID é o offset nela.
+ *  - Pode ser chamado de qualquer contexto (loop e ISRs). O M0 não tem
+ *    LDREX/STREX: a reserva e a cópia das palavras rodam com PRIMASK por
+ *    poucos ciclos. Ring cheio: o registro é descartado e contado (a
+ *    sequência de 8 bits pula e o decodificador mostra a lacuna).
+ *  - Escoamento em segundo plano: trechos contíguos do ring saem por
+ *    usart_write_ref (DMA direto do ring); o fim de cada envio já dispara o
+ *    próximo. trace_poll() no loop reinicia o escoamento quando ele para.
+ *    Com TX=IRQ, trace_poll copia para o ring do driver (usart_write).
+ *  - Conversões no decodificador: %d %i %u %x %X %c %p e %s (só para strings
+ *    constantes na flash: o texto é lido do ELF). Até TRACE_MAX_ARGS argumentos.
+ *  - Formato no fio (palavras little-endian):
+ *      cabeçalho = 0xA << 28 | nargs << 24 | seq << 16 | id
+ *      seguido de nargs palavras.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include "usart_irq_dma.h"
+
+/* 0 remove todas as chamadas TRACE() do binário */
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE      1
+#endif
+
+/* palavras de 32 bits no ring (potência de 2) */
+#ifndef TRACE_RING_WORDS
+#define TRACE_RING_WORDS  256u
+#endif
+
+#define TRACE_MAX_ARGS    8u
+#define TRACE_MAGIC       0xAu
+
+/* Liga o trace a uma USART (TX=DMA recomendado). Descarta o que estiver no ring. */
+void     trace_init(usart_drv_t *u);
+/* Reinicia o escoamento se estiver parado (chamar no loop principal) */
+void     trace_poll(void);
+/* Registros descartados por ring cheio */
+uint32_t trace_dropped(void);
+
+/* Usado pela macro: hdr = magic | nargs | id (a sequência é inserida aqui) */
+void     trace_write(uint32_t hdr, const uint32_t *args, uint32_t nargs);
+
+/* ===== Macro ===== */
+extern const char __start_trace_fmt[];   /* início da seção (0 no alvo) */
+
+#define TRACE_CAT_(a, b)  a##b
+#define TRACE_CAT(a, b)   TRACE_CAT_(a, b)
+#define TRACE_NARGS(...)  TRACE_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define TRACE_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+
+#define TRACE_W(x)        ((uint32_t)(uintptr_t)(x))
+#define TRACE_MAP_0()
+#define TRACE_MAP_1(a)                   , TRACE_W(a)
+#define TRACE_MAP_2(a, b)                TRACE_MAP_1(a) TRACE_MAP_1(b)
+#define TRACE_MAP_3(a, b, c)             TRACE_MAP_2(a, b) TRACE_MAP_1(c)
+#define TRACE_MAP_4(a, b, c, d)          TRACE_MAP_3(a, b, c) TRACE_MAP_1(d)
+#define TRACE_MAP_5(a, b, c, d, e)       TRACE_MAP_4(a, b, c, d) TRACE_MAP_1(e)
+#define TRACE_MAP_6(a, b, c, d, e, f)    TRACE_MAP_5(a, b, c, d, e) TRACE_MAP_1(f)
+#define TRACE_MAP_7(a, b, c, d, e, f, g) TRACE_MAP_6(a, b, c, d, e, f) TRACE_MAP_1(g)
+#define TRACE_MAP_8(a, b, c, d, e, f, g, h) TRACE_MAP_7(a, b, c, d, e, f, g) TRACE_MAP_1(h)
+
+#if TRACE_ENABLE
+#define TRACE(fmt, ...) do {                                                          \
+    static const char _trace_fmt[] __attribute__((section("trace_fmt"), used)) = fmt; \
+    const uint32_t _trace_a[] = { 0u TRACE_CAT(TRACE_MAP_, TRACE_NARGS(__VA_ARGS__))(__VA_ARGS__) }; \
+    trace_write(((uint32_t)TRACE_MAGIC << 28) | ((uint32_t)TRACE_NARGS(__VA_ARGS__) << 24) |         \
+                ((uint32_t)((uintptr_t)_trace_fmt - (uintptr_t)__start_trace_fmt) & 0xFFFFu),        \
+                &_trace_a[1], TRACE_NARGS(__VA_ARGS__));                                              \
+  } while (0)
+#else
+#define TRACE(fmt, ...) do { } while (0)
+#endif
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,230 @@
+#include "usart_frame.h"
+
+/* SLIP (RFC 1055) */
+#define SLIP_END       0xC0u
+#define SLIP_ESC       0xDBu
+#define SLIP_ESC_END   0xDCu
+#define SLIP_ESC_ESC   0xDDu
+
+/* ===== RX ===== */
+static inline void rx_reset(uframe_t *f){
+  f->rx_len = 0; f->rx_code = 0; f->rx_zero = 0; f->rx_esc = 0; f->rx_drop = 0;
+}
+
+/* copia para o pacote; sem espaço → descarta até o próximo delimitador */
+static inline bool rx_put(uframe_t *f, const uint8_t *src, uint32_t n){
+  if (n > f->rx_size - f->rx_len) { f->rx_overflow++; f->rx_drop = 1; return false; }
+  memcpy(&f->rx_buf[f->rx_len], src, n);
+  f->rx_len += n;
+  return true;
+}
+
+/* delimitador: confere o CRC e entrega o payload */
+static void rx_end(uframe_t *f){
+  uint32_t n = f->rx_len;
+  uint32_t c = (uint32_t)f->cfg.crc;
+
+  if (n == 0u) {
+    /* delimitadores seguidos (ou SLIP END inicial): nada a entregar */
+  } else if (n < c) {
+    f->rx_bad++;
+  } else {
+    n -= c;
+    const uint8_t *t = &f->rx_buf[n];
+    bool ok = true;
+    if (c == UFRAME_CRC16) {
+      ok = crc16_ccitt(0xFFFFu, f->rx_buf, n) == (uint16_t)(t[0] | (t[1] << 8));
+    } else if (c == UFRAME_CRC32) {
+      uint32_t rx = (uint32_t)t[0] | ((uint32_t)t[1] << 8) | ((uint32_t)t[2] << 16) | ((uint32_t)t[3] << 24);
+      ok = crc32_calc(f->rx_buf, n) == rx;
+    }
+    if (!ok) f->rx_crc_err++;
+    else {
+      f->rx_packets++;
+      if (f->cfg.on_packet) f->cfg.on_packet(f->rx_buf, n, f->cfg.ctx);
+    }
+  }
+  rx_reset(f);
+}
+
+/* COBS: código N = N-1 bytes literais + zero implícito (exceto N = 0xFF e o último bloco) */
+static void feed_cobs(uframe_t *f, const uint8_t *p, uint32_t len){
+  static const uint8_t zero = 0;
+  const uint8_t *end = p + len;
+
+  while (p < end) {
+    if (f->rx_drop) {
+      const uint8_t *z = memchr(p, 0, (size_t)(end - p));
+      if (!z) return;
+      p = z + 1;
+      rx_reset(f);
+      continue;
+    }
+
+    if (!f->rx_code) {
+      uint8_t b = *p++;
+      if (!b) { rx_end(f); continue; }                       /* delimitador */
+      if (f->rx_zero && !rx_put(f, &zero, 1u)) continue;     /* zero do bloco anterior */
+      f->rx_code = (uint8_t)(b - 1u);
+      f->rx_zero = (b != 0xFFu);
+      continue;
+    }
+
+    /* trecho literal do bloco; um zero aqui é delimitador fora de hora */
+    uint32_t n = (uint32_t)(end - p);
+    if (n > f->rx_code) n = f->rx_code;
+    const uint8_t *z = memchr(p, 0, n);
+    if (z) { f->rx_bad++; rx_reset(f); p = z + 1; continue; }
+    if (!rx_put(f, p, n)) continue;
+    p += n;
+    f->rx_code = (uint8_t)(f->rx_code - n);
+  }
+}
+
+static void feed_slip(uframe_t *f, const uint8_t *p, uint32_t len){
+  const uint8_t *end = p + len;
+
+  while (p < end) {
+    if (f->rx_drop) {
+      const uint8_t *z = memchr(p, SLIP_END, (size_t)(end - p));
+      if (!z) return;
+      p = z + 1;
+      rx_reset(f);
+      continue;
+    }
+
+    if (f->rx_esc) {
+      uint8_t b = *p++;
+      f->rx_esc = 0;
+      if      (b == SLIP_ESC_END) b = SLIP_END;
+      else if (b == SLIP_ESC_ESC) b = SLIP_ESC;
+      else {
+        f->rx_bad++;
+        if (b == SLIP_END) rx_reset(f); else f->rx_drop = 1;
+        continue;
+      }
+      (void)rx_put(f, &b, 1u);
+      continue;
+    }
+
+    /* trecho literal até END/ESC */
+    const uint8_t *q = p;
+    while (q < end && *q != SLIP_END && *q != SLIP_ESC) q++;
+    if (q > p && !rx_put(f, p, (uint32_t)(q - p))) continue;
+    p = q;
+    if (p == end) return;
+    if (*p++ == SLIP_END) rx_end(f); else f->rx_esc = 1;
+  }
+}
+
+void uframe_feed(uframe_t *f, const uint8_t *data, uint32_t len){
+  if (f->cfg.enc == UFRAME_SLIP) feed_slip(f, data, len);
+  else                           feed_cobs(f, data, len);
+}
+
+/* ===== TX ===== */
+uint32_t uframe_encoded_max(const uframe_t *f, uint32_t payload_len){
+  uint32_t n = payload_len + (uint32_t)f->cfg.crc;
+  if (f->cfg.enc == UFRAME_SLIP) return 2u * n + 2u;   /* END + tudo escapado + END */
+  return n + n / 254u + 2u;                            /* códigos + delimitador */
+}
+
+/* payload e CRC entram como dois segmentos (o CRC não é copiado para junto do payload) */
+static uint32_t enc_cobs(const uint8_t *s1, uint32_t n1, const uint8_t *s2, uint32_t n2, uint8_t *out){
+  uint32_t o = 1, ci = 0;
+  uint8_t code = 1;
+  for (uint8_t seg = 0; seg < 2u; seg++) {
+    const uint8_t *s = seg ? s2 : s1;
+    uint32_t n = seg ? n2 : n1;
+    for (uint32_t i = 0; i < n; i++) {
+      uint8_t b = s[i];
+      if (b) { out[o++] = b; code++; }
+      if (!b || code == 0xFFu) { out[ci] = code; ci = o++; code = 1; }
+    }
+  }
+  out[ci] = code;
+  out[o++] = 0;
+  return o;
+}
+
+static uint32_t enc_slip(const uint8_t *s1, uint32_t n1, const uint8_t *s2, uint32_t n2, uint8_t *out){
+  uint32_t o = 0;
+  out[o++] = SLIP_END;                       /* descarta ruído acumulado no receptor */
+  for (uint8_t seg = 0; seg < 2u; seg++) {
+    const uint8_t *s = seg ? s2 : s1;
+    uint32_t n = seg ? n2 : n1;
+    for (uint32_t i = 0; i < n; i++) {
+      uint8_t b = s[i];
+      if      (b == SLIP_END) { out[o++] = SLIP_ESC; out[o++] = SLIP_ESC_END; }
+      else if (b == SLIP_ESC) { out[o++] = SLIP_ESC; out[o++] = SLIP_ESC_ESC; }
+      else                      out[o++] = b;
+    }
+  }
+  out[o++] = SLIP_END;
+  return o;
+}
+
+uint32_t uframe_encode(const uframe_t *f, const void *payload, uint32_t len,
+                       uint8_t *out, uint32_t out_size){
+  if (uframe_encoded_max(f, len) > out_size) return 0;
+
+  const uint8_t *p = (const uint8_t*)payload;
+  uint8_t crcb[4];
+  uint32_t c = (uint32_t)f->cfg.crc;
+  if (c == UFRAME_CRC16) {
+    uint16_t v = crc16_ccitt(0xFFFFu, p, len);
+    crcb[0] = (uint8_t)v; crcb[1] = (uint8_t)(v >> 8);
+  } else if (c == UFRAME_CRC32) {
+    uint32_t v = crc32_calc(p, len);
+    crcb[0] = (uint8_t)v; crcb[1] = (uint8_t)(v >> 8); crcb[2] = (uint8_t)(v >> 16); crcb[3] = (uint8_t)(v >> 24);
+  }
+
+  if (f->cfg.enc == UFRAME_SLIP) return enc_slip(p, len, crcb, c, out);
+  return enc_cobs(p, len, crcb, c, out);
+}
+
+/* fim do envio por DMA: devolve o slot ao pool */
+static void tx_done(const void *buf, void *ctx){
+  uframe_t *f = (uframe_t*)ctx;
+  uint32_t i = (uint32_t)((const uint8_t*)buf - f->tx_pool) / f->tx_slot_size;
+  uint32_t pm = irq_lock();
+  f->tx_busy &= (uint8_t)~(1u << i);
+  irq_unlock(pm);
+}
+
+bool uframe_send(uframe_t *f, const void *payload, uint32_t len){
+  uint32_t pm = irq_lock();
+  uint8_t i = 0;
+  while (i < f->tx_slots && (f->tx_busy & (1u << i))) i++;
+  if (i == f->tx_slots) { f->tx_no_slot++; irq_unlock(pm); return false; }
+  f->tx_busy |= (uint8_t)(1u << i);
+  irq_unlock(pm);
+
+  uint8_t *slot = &f->tx_pool[i * f->tx_slot_size];
+  uint32_t n = uframe_encode(f, payload, len, slot, f->tx_slot_size);
+  bool ok = (n != 0u);
+
+  if (ok && f->u->cfg.tx_engine == UDRV_ENGINE_DMA) {
+    if (usart_write_ref(f->u, slot, n, tx_done, f)) { f->tx_packets++; return true; }
+    f->tx_no_slot++;
+    ok = false;
+  } else if (ok) {
+    usart_write(f->u, slot, n);              /* TX=IRQ: copia no ring */
+    f->tx_packets++;
+  }
+  tx_done(slot, f);
+  return ok;
+}
+
+/* ===== Init ===== */
+void uframe_init(uframe_t *f, usart_drv_t *u, const uframe_config_t *cfg,
+                 uint8_t *rx_buf, uint32_t rx_size,
+                 uint8_t *tx_pool, uint32_t tx_slot_size, uint8_t tx_slots)
+{
+  memset(f, 0, sizeof(*f));
+  f->u = u; f->cfg = *cfg;
+  f->rx_buf = rx_buf; f->rx_size = rx_size;
+  f->tx_pool = tx_pool; f->tx_slot_size = tx_slot_size;
+  f->tx_slots = (tx_slots > UFRAME_TX_SLOTS_MAX) ? (uint8_t)UFRAME_TX_SLOTS_MAX : tx_slots;
+  if (cfg->crc != UFRAME_CRC_NONE) crc_init();
+}
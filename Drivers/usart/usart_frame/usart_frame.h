@@ -0,0 +1,94 @@
+/*
+ * usart_frame.h
+ *
+ *  Pacotes sobre usart_irq_dma: COBS (delimitador 0x00) ou SLIP (RFC 1055),
+ *  com CRC opcional (CRC-16/CCITT-FALSE ou CRC-32, ver crc.h) no fim do
+ *  payload, little-endian, dentro da codificação.
+ *  - RX: uframe_feed() consome os trechos entregues pelo on_rx_chunk (ou por
+ *    usart_rx_peek) e decodifica em fluxo direto no buffer do pacote: trechos
+ *    literais vão por memcpy, só os bytes de controle são tratados um a um.
+ *    Pacote maior que o buffer é descartado até o próximo delimitador.
+ *  - TX: uframe_send() codifica em um slot do pool e o enfileira com
+ *    usart_write_ref (DMA direto do slot); o slot volta ao pool no fim do envio.
+ *    Com TX=IRQ usa usart_write (cópia no ring) e libera o slot na hora.
+ *  - Memória fixa: buffer RX e pool TX vêm do chamador; sem alocação dinâmica.
+ *  - on_packet roda no contexto de quem chama uframe_feed (ISR, se for do on_rx_chunk).
+ */
+
+#ifndef __USART_FRAME_H__
+#define __USART_FRAME_H__
+
+#include "usart_irq_dma.h"
+#include "crc.h"
+
+#define UFRAME_TX_SLOTS_MAX   8u
+
+typedef enum {
+	UFRAME_COBS = 0,
+	UFRAME_SLIP = 1
+} uframe_enc_t;
+
+/* valor = bytes do CRC no fim do payload */
+typedef enum {
+	UFRAME_CRC_NONE = 0,
+	UFRAME_CRC16    = 2,
+	UFRAME_CRC32    = 4
+} uframe_crc_t;
+
+typedef void (*uframe_rx_cb_t)(const uint8_t *pkt, uint32_t len, void *ctx);
+
+typedef struct {
+  uframe_enc_t    enc;
+  uframe_crc_t    crc;
+  uframe_rx_cb_t  on_packet;   /* payload sem CRC; válido só durante o callback */
+  void           *ctx;
+} uframe_config_t;
+
+typedef struct {
+  usart_drv_t    *u;
+  uframe_config_t cfg;
+
+  /* RX */
+  uint8_t        *rx_buf;
+  uint32_t        rx_size;
+  uint32_t        rx_len;      /* bytes decodificados no pacote atual */
+  uint8_t         rx_code;     /* COBS: bytes literais restantes no bloco (0 = espera código) */
+  uint8_t         rx_zero;     /* COBS: bloco atual termina em zero implícito */
+  uint8_t         rx_esc;      /* SLIP: ESC pendente */
+  uint8_t         rx_drop;     /* descartando até o próximo delimitador */
+
+  /* TX */
+  uint8_t        *tx_pool;
+  uint32_t        tx_slot_size;
+  uint8_t         tx_slots;
+  volatile uint8_t tx_busy;    /* bitmap dos slots em voo */
+
+  /* estatísticas */
+  volatile uint32_t rx_packets;
+  volatile uint32_t rx_crc_err;
+  volatile uint32_t rx_overflow;  /* pacote maior que rx_size */
+  volatile uint32_t rx_bad;       /* codificação inválida */
+  volatile uint32_t tx_packets;
+  volatile uint32_t tx_no_slot;   /* pool ou fila de ref cheios */
+} uframe_t;
+
+/* rx_buf: maior payload + CRC. tx_pool: tx_slots (1..8) slots de tx_slot_size bytes
+   (veja uframe_encoded_max). Com CRC, chama crc_init(). */
+void uframe_init(uframe_t *f, usart_drv_t *u, const uframe_config_t *cfg,
+                 uint8_t *rx_buf, uint32_t rx_size,
+                 uint8_t *tx_pool, uint32_t tx_slot_size, uint8_t tx_slots);
+
+/* Bytes recebidos da linha (qualquer fatiamento). Chama on_packet por pacote válido. */
+void uframe_feed(uframe_t *f, const uint8_t *data, uint32_t len);
+
+/* Tamanho codificado no pior caso (payload + CRC + delimitadores) */
+uint32_t uframe_encoded_max(const uframe_t *f, uint32_t payload_len);
+
+/* Codifica um pacote em out; retorna bytes ou 0 se não couber */
+uint32_t uframe_encode(const uframe_t *f, const void *payload, uint32_t len,
+                       uint8_t *out, uint32_t out_size);
+
+/* Codifica e enfileira para TX. false: sem slot livre, fila de ref cheia ou não cabe no slot */
+bool uframe_send(uframe_t *f, const void *payload, uint32_t len);
+
+#endif /* __USART_FRAME_H__ */
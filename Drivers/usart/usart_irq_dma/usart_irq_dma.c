@@ -1,8 +1,30 @@
 #include "usart_irq_dma.h"
 
-/* ===== Instâncias globais para ISR de USART ===== */
-static usart_drv_t *g_u1 = NULL;
-static usart_drv_t *g_u2 = NULL;
+/* ===== Instâncias: recursos fixos por USART e handles para as ISRs ===== */
+typedef struct {
+	uint8_t    apb2;           /* clock em APB2ENR (senão APB1ENR) */
+	uint32_t   en_bit;
+	IRQn_Type  irqn;
+	dma_req_t  rq_tx, rq_rx;
+} usart_hw_t;
+
+static const usart_hw_t s_hw[USART_DRV_COUNT] = {
+	{ 1, RCC_APB2ENR_USART1EN, USART1_IRQn,   DMA_REQ_USART1_TX, DMA_REQ_USART1_RX },
+	{ 0, RCC_APB1ENR_USART2EN, USART2_IRQn,   DMA_REQ_USART2_TX, DMA_REQ_USART2_RX },
+	{ 0, RCC_APB1ENR_USART3EN, USART3_4_IRQn, DMA_REQ_USART3_TX, DMA_REQ_USART3_RX },
+	{ 0, RCC_APB1ENR_USART4EN, USART3_4_IRQn, DMA_REQ_USART4_TX, DMA_REQ_USART4_RX },
+};
+
+static usart_drv_t *g_usart[USART_DRV_COUNT];
+
+/* índice 0..3 da instância; -1 se não for uma USART do F070 */
+static int usart_index(const USART_TypeDef *us) {
+	if (us == USART1) return 0;
+	if (us == USART2) return 1;
+	if (us == USART3) return 2;
+	if (us == USART4) return 3;
+	return -1;
+}
 
 /* ===== Rings ===== */
 static inline uint32_t rb_avail(const udrv_ring_t *rb) {
@@ -11,34 +33,56 @@ static inline uint32_t rb_avail(const udrv_ring_t *rb) {
 static inline uint32_t rb_free(const udrv_ring_t *rb) {
 	return (rb->size - 1u) - rb_avail(rb);
 }
-static inline void rb_put(udrv_ring_t *rb, uint8_t b) {
+static inline void rb_put(udrv_ring_t *rb, uint16_t d) {
 	uint32_t h = rb->head, nh = (h + 1u) & (rb->size - 1u);
 	if (nh != rb->tail) {
-		rb->buf[h] = b;
+		if (rb->shift) ((uint16_t*)rb->buf)[h] = d; else rb->buf[h] = (uint8_t)d;
 		rb->head = nh;
 	}
 }
+static inline uint16_t rb_peek1(const udrv_ring_t *rb) {
+	return rb->shift ? ((const uint16_t*)rb->buf)[rb->tail] : rb->buf[rb->tail];
+}
+/* Produtor em bloco: até dois memcpy (antes/depois do fim do ring) e um só
+   store em head, depois dos dados. Retorna itens copiados (limitado ao espaço). */
+static uint32_t rb_write(udrv_ring_t *rb, const uint8_t *src, uint32_t n) {
+	uint32_t fr = rb_free(rb);
+	if (n > fr) n = fr;
+	if (!n) return 0;
+	uint32_t h = rb->head, first = rb->size - h, sh = rb->shift;
+	if (first > n) first = n;
+	memcpy(&rb->buf[h << sh], src, first << sh);
+	if (n > first) memcpy(rb->buf, src + (first << sh), (n - first) << sh);
+	__asm volatile ("" ::: "memory");   /* dados visíveis antes de publicar head */
+	rb->head = (h + n) & (rb->size - 1u);
+	return n;
+}
 static inline uint32_t rb_get(udrv_ring_t *rb, uint8_t *dst, uint32_t n) {
 	uint32_t c = 0;
 	while (c < n && rb->tail != rb->head) {
-		dst[c++] = rb->buf[rb->tail];
+		if (rb->shift) ((uint16_t*)dst)[c++] = ((const uint16_t*)rb->buf)[rb->tail];
+		else           dst[c++] = rb->buf[rb->tail];
 		rb->tail = (rb->tail + 1u) & (rb->size - 1u);
 	}
 	return c;
 }
 
-/* ===== Mapeamento DMA por USART (ajuste se seu RM diferir) ===== */
+/* ===== Mapeamento DMA por USART (via alocador do dma_router) =====
+   Reserva só as direções que usam DMA. USART1 pode ser relocada para CH4/CH5
+   (SYSCFG remap) se CH2/CH3 já tiverem dono (ex.: SPI1 ou USART3). Sem canal
+   livre, a direção cai para o engine IRQ. */
 static void usart_pick_dma(usart_drv_t *u) {
-	if (u->inst == USART1) {
-		u->dma_tx = DMA1_Channel2;
-		u->tx_ch_idx = 2;
-		u->dma_rx = DMA1_Channel3;
-		u->rx_ch_idx = 3;
-	} else {
-		u->dma_tx = DMA1_Channel4;
-		u->tx_ch_idx = 4;
-		u->dma_rx = DMA1_Channel5;
-		u->rx_ch_idx = 5;
+	dma_req_t rq_tx = s_hw[u->idx].rq_tx, rq_rx = s_hw[u->idx].rq_rx;
+
+	if (u->cfg.tx_engine == UDRV_ENGINE_DMA) {
+		u->tx_ch_idx = dma_router_claim_req(rq_tx, u);
+		if (u->tx_ch_idx) u->dma_tx = DMA1_CHANNEL(u->tx_ch_idx);
+		else              u->cfg.tx_engine = UDRV_ENGINE_IRQ;
+	}
+	if (u->cfg.rx_engine == UDRV_ENGINE_DMA) {
+		u->rx_ch_idx = dma_router_claim_req(rq_rx, u);
+		if (u->rx_ch_idx) u->dma_rx = DMA1_CHANNEL(u->rx_ch_idx);
+		else              u->cfg.rx_engine = UDRV_ENGINE_IRQ;
 	}
 }
 
@@ -56,9 +100,10 @@ static void set_baud(USART_TypeDef *us, uint32_t pclk_hz, uint32_t baud, uint8_t
 /* ===== Core config ===== */
 static void core_config(usart_drv_t *u){
   USART_TypeDef *us = u->inst;
+  const usart_hw_t *hw = &s_hw[u->idx];
 
   /* habilitar clocks */
-  if (us==USART1) RCC->APB2ENR |= RCC_APB2ENR_USART1EN; else RCC->APB1ENR |= RCC_APB1ENR_USART2EN;
+  if (hw->apb2) RCC->APB2ENR |= hw->en_bit; else RCC->APB1ENR |= hw->en_bit;
 
   us->CR1 = 0;
   us->CR2 &= ~(3u<<12);
@@ -71,12 +116,37 @@ static void core_config(usart_drv_t *u){
 
   set_baud(us, u->pclk_hz, u->cfg.baud, u->cfg.oversample8?1u:0u);
 
+  /* Mute por address mark: MSB do caractere = 1 marca endereço; só acorda com ADD[6:0] */
+  if (u->cfg.mute) cr1 |= (1u<<13) | (1u<<11);                      /* MME | WAKE */
+
   /* RE/TE */
   cr1 |= (1u<<2) | (1u<<3);
 
   /* RX: IRQ -> RXNEIE ; DMA -> IDLEIE */
-  if (u->cfg.rx_engine == UDRV_ENGINE_DMA) cr1 |= (1u<<4); /* IDLEIE */
-  else                                     cr1 |= (1u<<5); /* RXNEIE */
+  uint8_t fr = u->cfg.rx_frame;
+  if (u->cfg.rx_engine == UDRV_ENGINE_DMA) { if (!fr) fr = UDRV_FRAME_IDLE; }
+  else cr1 |= (1u<<5); /* RXNEIE */
+  if (fr & UDRV_FRAME_IDLE) cr1 |= (1u<<4); /* IDLEIE */
+
+  /* Character match: ADD[31:24] compara o byte inteiro (só com UE=0).
+     O mute usa o mesmo ADD (endereço de 7 bits, ADDM7): os dois são exclusivos. */
+  us->CR2 &= ~((0xFFu<<24) | (1u<<23) | (1u<<4));
+  if (u->cfg.mute) us->CR2 |= ((uint32_t)(u->cfg.mute_addr & 0x7Fu) << 24) | (1u<<4); /* ADDM7 */
+  else if (fr & UDRV_FRAME_CHAR) { us->CR2 |= ((uint32_t)u->cfg.match_char << 24); cr1 |= (1u<<14); /* CMIE */ }
+
+  /* Receiver timeout: RTOF após rto_bits sem start bit depois do último caractere */
+  if (fr & UDRV_FRAME_RTO) {
+    us->RTOR = u->cfg.rto_bits & 0xFFFFFFu;
+    us->CR2 |= (1u<<23);                                              /* RTOEN */
+    cr1 |= (1u<<26);                                                  /* RTOIE */
+  }
+
+  /* RS-485: DEAT/DEDT em CR1 (só com UE=0), DEM/DEP em CR3 */
+  us->CR3 &= ~((1u<<14) | (1u<<15));
+  if (u->cfg.rs485) {
+    cr1 |= ((uint32_t)(u->cfg.de_assert & 0x1Fu) << 21) | ((uint32_t)(u->cfg.de_deassert & 0x1Fu) << 16);
+    us->CR3 |= (1u<<14) | (u->cfg.de_active_low ? (1u<<15) : 0u);  /* DEM | DEP */
+  }
 
   us->CR1 = cr1;
 
@@ -87,46 +157,88 @@ static void core_config(usart_drv_t *u){
 
   us->CR1 |= (1u<<0); /* UE */
 
-  /* NVIC USART */
-  nvic_enable_irq((us==USART1)?USART1_IRQn:USART2_IRQn, u->cfg.nvic_prio_usart);
+  /* NVIC USART (USART3/4 dividem o vetor: a última prioridade configurada vale) */
+  nvic_enable_irq(hw->irqn, u->cfg.nvic_prio_usart);
 }
 
 /* ===== RX DMA circular ===== */
+/* CCR fixos dos canais (calculados em tempo de compilação) */
+#define USART_RX_DMA_CCR  DMA_ROUTER_CCR(/*m2p*/0, /*circ*/1, /*minc*/1, /*pinc*/0, \
+                                         /*msize*/0, /*psize*/0, /*prio*/2, /*tc*/1, /*ht*/0, /*te*/1)
+#define USART_TX_DMA_CCR  DMA_ROUTER_CCR(/*m2p*/1, /*circ*/0, /*minc*/1, /*pinc*/0, \
+                                         /*msize*/0, /*psize*/0, /*prio*/2, /*tc*/1, /*ht*/0, /*te*/1)
+/* 9 bits de dado: itens de 16 bits em memória e no RDR/TDR */
+#define USART_RX_DMA_CCR16 DMA_ROUTER_CCR(/*m2p*/0, /*circ*/1, /*minc*/1, /*pinc*/0, \
+                                          /*msize*/1, /*psize*/1, /*prio*/2, /*tc*/1, /*ht*/0, /*te*/1)
+#define USART_TX_DMA_CCR16 DMA_ROUTER_CCR(/*m2p*/1, /*circ*/0, /*minc*/1, /*pinc*/0, \
+                                          /*msize*/1, /*psize*/1, /*prio*/2, /*tc*/1, /*ht*/0, /*te*/1)
+
 static void start_rx_dma(usart_drv_t *u){
-  DMA_Channel_TypeDef *ch = u->dma_rx; USART_TypeDef *us=u->inst;
-  ch->CCR &= ~DMA_CCR_EN;
-  ch->CPAR  = (uint32_t)&us->RDR;
-  ch->CMAR  = (uint32_t)u->rx_dma_buf;
-  ch->CNDTR = u->rx_dma_size;
-  ch->CCR   = DMA_CCR_MINC | DMA_CCR_PSIZE_8 | DMA_CCR_MSIZE_8 | DMA_CCR_PL_HIGH | DMA_CCR_CIRC | DMA_CCR_TEIE;
+  dma_router_prepare_ccr(u->rx_ch_idx, (uint32_t)&u->inst->RDR,
+                         u->wshift ? USART_RX_DMA_CCR16 : USART_RX_DMA_CCR);
   u->rx_dma_last = u->rx_dma_size;
-  ch->CCR |= DMA_CCR_EN;
+  u->rx_laps = 0; u->rx_rd = 0; u->rx_rd_idx = 0; u->rx_cm_pending = 0;
+  dma_router_restart(u->rx_ch_idx, (uint32_t)u->rx_dma_buf, (uint16_t)u->rx_dma_size);
 }
 
 /* ===== TX kick (IRQ) ===== */
 static inline void kick_tx_irq(usart_drv_t *u){ u->inst->CR1 |= (1u<<7); /* TXEIE */ }
 
 /* ===== TX kick (DMA) ===== */
+/* canal preparado no init (CPAR = TDR); cada rajada só recarrega CMAR/CNDTR */
+
+static inline void tx_desc_set(dma_router_desc_t *d, const uint8_t *p, uint32_t n){
+  d->cpar      = 0;
+  d->cmar      = (uint32_t)p;
+  d->count     = (uint16_t)n;
+  d->fixed_mem = 0;
+  d->next      = NULL;
+}
+
 static void kick_tx_dma(usart_drv_t *u){
-  DMA_Channel_TypeDef *ch = u->dma_tx; USART_TypeDef *us = u->inst;
   if (u->cfg.tx_engine != UDRV_ENGINE_DMA) return;
-  if (ch->CCR & DMA_CCR_EN) return;
-
-  uint32_t avail = rb_avail(&u->tx_rb);
-  if (!avail) return;
 
-  uint32_t tail = u->tx_rb.tail;
-  uint32_t until_end = u->tx_rb.size - tail;
-  uint32_t n = (avail < until_end)? avail : until_end;
-  if (!n) return;
+  uint32_t pm = irq_lock();              /* chamado do loop e da ISR do DMA */
+  if (u->tx_dma_len) { irq_unlock(pm); return; }   /* rajada em andamento */
+
+  /* ring só até a marca do 1º ref pendente: preserva a ordem entre write e write_ref */
+  const udrv_tx_ref_t *r = u->tx_ref_count ? &u->tx_ref[u->tx_ref_head] : NULL;
+  uint32_t limit = r ? r->mark : u->tx_rb.head;
+  uint32_t avail = (limit - u->tx_rb.tail) & (u->tx_rb.size - 1u);
+  uint32_t n;
+
+  if (avail) {
+    uint32_t tail = u->tx_rb.tail;
+    uint32_t until_end = u->tx_rb.size - tail;
+    n = (avail < until_end)? avail : until_end;
+    if (n > 0xFFFFu) n = 0xFFFFu;
+
+    /* 1º segmento: do tail até o limite ou até o fim do ring */
+    tx_desc_set(&u->tx_desc[0], &u->tx_rb.buf[tail << u->wshift], n);
+
+    /* ring deu a volta: 2º segmento a partir do início, na mesma rajada (um só TC) */
+    uint32_t wrap = avail - n;
+    if (n == until_end && wrap) {
+      if (wrap > 0xFFFFu) wrap = 0xFFFFu;
+      tx_desc_set(&u->tx_desc[1], &u->tx_rb.buf[0], wrap);
+      u->tx_desc[0].next = &u->tx_desc[1];
+      n += wrap;
+    }
+    u->tx_is_ref = 0;
+  } else if (r) {
+    /* ring em dia: envia o ref direto da memória do chamador */
+    n = r->len - u->tx_ref_off;
+    if (n > 0xFFFFu) n = 0xFFFFu;
+    tx_desc_set(&u->tx_desc[0], r->buf + (u->tx_ref_off << u->wshift), n);
+    u->tx_is_ref = 1;
+  } else {
+    irq_unlock(pm);
+    return;
+  }
 
-  ch->CCR &= ~DMA_CCR_EN;
-  ch->CPAR  = (uint32_t)&us->TDR;
-  ch->CMAR  = (uint32_t)&u->tx_rb.buf[tail];
-  ch->CNDTR = n;
-  ch->CCR   = DMA_CCR_DIR | DMA_CCR_MINC | DMA_CCR_PSIZE_8 | DMA_CCR_MSIZE_8 | DMA_CCR_PL_HIGH | DMA_CCR_TCIE | DMA_CCR_TEIE;
-  u->tx_dma_len = (uint16_t)n;
-  ch->CCR |= DMA_CCR_EN;
+  u->tx_dma_len = n;
+  if (!dma_router_restart_chain(u->tx_ch_idx, &u->tx_desc[0])) u->tx_dma_len = 0;
+  irq_unlock(pm);
 }
 
 /* ===== Callbacks do usuário ===== */
@@ -140,16 +252,54 @@ void usart_set_callbacks(usart_drv_t *u,
   u->on_error    = on_error;
 }
 
+void usart_set_frame_callback(usart_drv_t *u, void (*on_rx_frame)(usart_drv_t*, uint32_t))
+{
+  u->on_rx_frame = on_rx_frame;
+}
+
 /* ===== dma_router callbacks ===== */
 static void usart_dma_tx_cb(uint32_t flags, void *ctx){
   usart_drv_t *u = (usart_drv_t*)ctx;
 
-  if (flags & (DMA_TEIF2 | DMA_TEIF4)) { if (u->on_error) u->on_error(0, flags); return; }
+  if (flags & DMA_TEIF(u->tx_ch_idx)) {
+    /* erro: o hardware desliga o canal. A rajada é descartada (ring: tail
+       avança; ref: sai da fila e o dono é avisado) e o TX segue adiante */
+    dma_router_stop(u->tx_ch_idx);
+    const void *buf = NULL; udrv_ref_cb_t cb = NULL; void *cctx = NULL;
+    if (u->tx_is_ref) {
+      udrv_tx_ref_t *r = &u->tx_ref[u->tx_ref_head];
+      buf = r->buf; cb = r->cb; cctx = r->ctx;
+      u->tx_ref_head = (uint8_t)((u->tx_ref_head + 1u) % USART_TX_REF_QUEUE_LEN);
+      u->tx_ref_count--;
+    } else {
+      u->tx_rb.tail = (u->tx_rb.tail + u->tx_dma_len) & (u->tx_rb.size - 1u);
+    }
+    u->tx_dma_len = 0; u->tx_ref_off = 0; u->tx_is_ref = 0;
+    if (cb) cb(buf, cctx);
+    if (u->on_error) u->on_error(0, flags);
+    kick_tx_dma(u);
+    return;
+  }
 
-  if (flags & (DMA_TCIF2 | DMA_TCIF4)) {
-    /* avança tail do ring pela rajada atual e tenta próxima */
-    u->tx_rb.tail = (u->tx_rb.tail + u->tx_dma_len) & (u->tx_rb.size - 1u);
-    u->tx_dma_len = 0;
+  if (flags & DMA_TCIF(u->tx_ch_idx)) {
+    dma_router_stop(u->tx_ch_idx);
+    if (u->tx_is_ref) {
+      /* ref: avança no buffer do chamador; terminado, sai da fila e avisa */
+      udrv_tx_ref_t *r = &u->tx_ref[u->tx_ref_head];
+      u->tx_ref_off += u->tx_dma_len;
+      u->tx_dma_len = 0;
+      if (u->tx_ref_off >= r->len) {
+        const void *buf = r->buf; udrv_ref_cb_t cb = r->cb; void *cctx = r->ctx;
+        u->tx_ref_off  = 0;
+        u->tx_ref_head = (uint8_t)((u->tx_ref_head + 1u) % USART_TX_REF_QUEUE_LEN);
+        u->tx_ref_count--;
+        if (cb) cb(buf, cctx);
+      }
+    } else {
+      /* avança tail do ring pela rajada atual */
+      u->tx_rb.tail = (u->tx_rb.tail + u->tx_dma_len) & (u->tx_rb.size - 1u);
+      u->tx_dma_len = 0;
+    }
     if (u->on_tx_done) u->on_tx_done();
     kick_tx_dma(u);
   }
@@ -157,8 +307,64 @@ static void usart_dma_tx_cb(uint32_t flags, void *ctx){
 
 static void usart_dma_rx_cb(uint32_t flags, void *ctx){
   usart_drv_t *u = (usart_drv_t*)ctx;
-  if (flags & (DMA_TEIF3 | DMA_TEIF5)) { if (u->on_error) u->on_error(0, flags); }
-  /* RX circular normalmente não usa TC; processamento é por IDLE em USART IRQ */
+  if (flags & DMA_TEIF(u->rx_ch_idx)) { if (u->on_error) u->on_error(0, flags); }
+  /* TC só conta voltas (peek/consume); entrega de dados é por IDLE em USART IRQ */
+  if (flags & DMA_TCIF(u->rx_ch_idx)) u->rx_laps++;
+}
+
+/* ===== RX DMA: leitura no próprio buffer ===== */
+/* Bytes escritos pelo DMA e ainda não consumidos (> rx_dma_size: overrun).
+   voltas*size + posição, em aritmética mod 2^32 contra rx_rd. Relê se o TC
+   entrou entre as leituras. Com TCIF pendente (CNDTR já recarregou, mas a ISR
+   do DMA ainda não rodou: IRQ mascarada ou chamada de prioridade maior), a
+   volta que falta em rx_laps é contada aqui. */
+static uint32_t rx_dma_fill(usart_drv_t *u, uint32_t *wr_idx){
+  uint32_t laps, ndt, tc, tc2;
+  const uint32_t tcif = DMA_TCIF(u->rx_ch_idx);
+  do {
+    laps = u->rx_laps;
+    tc   = DMA1->ISR & tcif;
+    ndt  = u->dma_rx->CNDTR;
+    tc2  = DMA1->ISR & tcif;
+  } while (laps != u->rx_laps || tc != tc2);
+  if (tc) laps++;
+  uint32_t pos = u->rx_dma_size - ndt;
+  if (wr_idx) *wr_idx = (pos == u->rx_dma_size) ? 0u : pos;
+  return laps * u->rx_dma_size + pos - u->rx_rd;
+}
+
+/* overrun: descarta tudo até a posição atual do DMA */
+static void rx_dma_resync(usart_drv_t *u, uint32_t fill, uint32_t wr_idx){
+  u->rx_rd += fill;
+  u->rx_rd_idx = wr_idx;
+  u->rx_overruns++;
+}
+
+uint32_t usart_rx_peek(usart_drv_t *u, udrv_span_t span[2]){
+  span[0].ptr = span[1].ptr = u->rx_dma_buf;
+  span[0].len = span[1].len = 0;
+  if (u->cfg.rx_engine != UDRV_ENGINE_DMA) return 0;
+
+  uint32_t wr_idx, fill = rx_dma_fill(u, &wr_idx);
+  if (fill > u->rx_dma_size) { rx_dma_resync(u, fill, wr_idx); return 0; }
+
+  uint32_t until_end = u->rx_dma_size - u->rx_rd_idx;
+  span[0].ptr = &u->rx_dma_buf[u->rx_rd_idx << u->wshift];
+  span[0].len = (fill < until_end) ? fill : until_end;
+  span[1].len = fill - span[0].len;
+  return fill;
+}
+
+bool usart_rx_consume(usart_drv_t *u, uint32_t n){
+  if (u->cfg.rx_engine != UDRV_ENGINE_DMA) return false;
+
+  uint32_t wr_idx, fill = rx_dma_fill(u, &wr_idx);
+  if (fill > u->rx_dma_size) { rx_dma_resync(u, fill, wr_idx); return false; }
+
+  if (n > fill) n = fill;
+  u->rx_rd += n;
+  u->rx_rd_idx = (u->rx_rd_idx + n) % u->rx_dma_size;
+  return true;
 }
 
 /* ===== API ===== */
@@ -168,95 +374,206 @@ void usart_init(usart_drv_t *u, USART_TypeDef *inst, uint32_t pclk_hz,
                 uint8_t *tx_ring, uint32_t tx_len)
 {
   memset(u, 0, sizeof(*u));
-  u->inst = inst; u->pclk_hz = pclk_hz; u->cfg = *cfg;
+  int idx = usart_index(inst);
+  if (idx < 0) return;               /* u->inst fica NULL */
+  u->inst = inst; u->pclk_hz = pclk_hz; u->cfg = *cfg; u->idx = (uint8_t)idx;
+
+  usart_pick_dma(u);   /* pode rebaixar u->cfg.*_engine para IRQ */
 
-  if (cfg->rx_engine == UDRV_ENGINE_DMA) { u->rx_dma_buf = rx_ring_or_dma_buf; u->rx_dma_size = rx_len; }
-  else { u->rx_rb.buf = rx_ring_or_dma_buf; u->rx_rb.size = rx_len; u->rx_rb.head=u->rx_rb.tail=0; }
+  /* 9 bits de dado (M=9 sem paridade): rings e buffers DMA em uint16_t; tamanhos em bytes → itens */
+  u->wshift = (u->cfg.wordlen == UDRV_WORDLEN_9B && u->cfg.parity == UDRV_PARITY_NONE) ? 1u : 0u;
 
-  u->tx_rb.buf = tx_ring; u->tx_rb.size = tx_len; u->tx_rb.head=u->tx_rb.tail=0;
+  if (u->cfg.rx_engine == UDRV_ENGINE_DMA) { u->rx_dma_buf = rx_ring_or_dma_buf; u->rx_dma_size = rx_len >> u->wshift; }
+  else { u->rx_rb.buf = rx_ring_or_dma_buf; u->rx_rb.size = rx_len >> u->wshift; u->rx_rb.shift = u->wshift; u->rx_rb.head=u->rx_rb.tail=0; }
+
+  u->tx_rb.buf = tx_ring; u->tx_rb.size = tx_len >> u->wshift; u->tx_rb.shift = u->wshift; u->tx_rb.head=u->tx_rb.tail=0;
 
-  usart_pick_dma(u);
   core_config(u);
 
-  if (cfg->rx_engine == UDRV_ENGINE_DMA) {
+  if (u->cfg.rx_engine == UDRV_ENGINE_DMA) {
     RCC->AHBENR |= RCC_AHBENR_DMA1EN;
     start_rx_dma(u);
   }
-  if (cfg->tx_engine == UDRV_ENGINE_DMA) {
+  if (u->cfg.tx_engine == UDRV_ENGINE_DMA) {
     RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+    dma_router_prepare_ccr(u->tx_ch_idx, (uint32_t)&u->inst->TDR,
+                           u->wshift ? USART_TX_DMA_CCR16 : USART_TX_DMA_CCR);
   }
 
   /* registra callbacks no roteador (somente se usar DMA) */
-  if (cfg->tx_engine == UDRV_ENGINE_DMA && u->tx_ch_idx) dma_router_attach(u->tx_ch_idx, usart_dma_tx_cb, u);
-  if (cfg->rx_engine == UDRV_ENGINE_DMA && u->rx_ch_idx) dma_router_attach(u->rx_ch_idx, usart_dma_rx_cb, u);
+  if (u->cfg.tx_engine == UDRV_ENGINE_DMA && u->tx_ch_idx) dma_router_attach(u->tx_ch_idx, usart_dma_tx_cb, u);
+  if (u->cfg.rx_engine == UDRV_ENGINE_DMA && u->rx_ch_idx) dma_router_attach(u->rx_ch_idx, usart_dma_rx_cb, u);
+
+  /* guarda ponteiro para a ISR */
+  g_usart[idx] = u;
+}
+
+static inline void kick_tx(usart_drv_t *u){
+  if (u->cfg.tx_engine == UDRV_ENGINE_DMA) kick_tx_dma(u); else kick_tx_irq(u);
+}
 
-  /* guarda ponteiros para ISR */
-  if (inst==USART1) g_u1 = u; else g_u2 = u;
+/* copia o que couber no ring e dispara; não bloqueia */
+uint32_t usart_try_write(usart_drv_t *u, const void *data, uint32_t len){
+  uint32_t n = rb_write(&u->tx_rb, (const uint8_t*)data, len);
+  if (n) kick_tx(u);
+  return n;
 }
 
-/* escreve ao ring e garante disparo */
+uint32_t usart_tx_free(const usart_drv_t *u){ return rb_free(&u->tx_rb); }
+
+/* escreve ao ring e garante disparo; ring cheio → idle hook (ou espera ocupada) */
 uint32_t usart_write(usart_drv_t *u, const void *data, uint32_t len){
   const uint8_t *p=(const uint8_t*)data; uint32_t done=0;
-  while (done<len){
-    if (rb_free(&u->tx_rb)==0){
-      if (u->cfg.tx_engine == UDRV_ENGINE_DMA) kick_tx_dma(u); else kick_tx_irq(u);
-      __asm volatile("nop");
-      continue;
-    }
-    rb_put(&u->tx_rb, p[done++]);
+  for (;;){
+    done += rb_write(&u->tx_rb, p + (done << u->wshift), len - done);
+    kick_tx(u);
+    if (done >= len) break;
+    if (u->on_tx_wait) u->on_tx_wait(); else __asm volatile("nop");
   }
-  if (u->cfg.tx_engine == UDRV_ENGINE_DMA) kick_tx_dma(u); else kick_tx_irq(u);
   return done;
 }
 
+void usart_set_idle_hook(usart_drv_t *u, void (*on_tx_wait)(void)){
+  u->on_tx_wait = on_tx_wait;
+}
+
+void usart_mute_enter(usart_drv_t *u){
+  if (u->cfg.mute) u->inst->RQR = (1u<<2);   /* MMRQ */
+}
+
+bool usart_write_ref(usart_drv_t *u, const void *buf, uint32_t len,
+                     udrv_ref_cb_t done_cb, void *ctx){
+  if (u->cfg.tx_engine != UDRV_ENGINE_DMA || !buf || !len) return false;
+
+  uint32_t pm = irq_lock();
+  if (u->tx_ref_count >= USART_TX_REF_QUEUE_LEN) { irq_unlock(pm); return false; }
+  udrv_tx_ref_t *r = &u->tx_ref[(u->tx_ref_head + u->tx_ref_count) % USART_TX_REF_QUEUE_LEN];
+  r->buf  = (const uint8_t*)buf;
+  r->len  = len;
+  r->mark = u->tx_rb.head;
+  r->cb   = done_cb;
+  r->ctx  = ctx;
+  u->tx_ref_count++;
+  irq_unlock(pm);
+
+  kick_tx_dma(u);
+  return true;
+}
+
 uint32_t usart_read(usart_drv_t *u, void *out, uint32_t maxlen){
-  if (u->cfg.rx_engine == UDRV_ENGINE_DMA) return 0;
+  if (u->cfg.rx_engine == UDRV_ENGINE_DMA) {
+    udrv_span_t sp[2];
+    uint32_t n = usart_rx_peek(u, sp), c = 0;
+    if (n > maxlen) n = maxlen;
+    for (uint8_t i = 0; i < 2 && c < n; i++) {
+      uint32_t k = (sp[i].len < n - c) ? sp[i].len : n - c;
+      memcpy((uint8_t*)out + (c << u->wshift), sp[i].ptr, k << u->wshift);
+      c += k;
+    }
+    return usart_rx_consume(u, c) ? c : 0u;
+  }
   return rb_get(&u->rx_rb, (uint8_t*)out, maxlen);
 }
 
 void usart_flush(usart_drv_t *u){
   while (rb_avail(&u->tx_rb)){ if (u->cfg.tx_engine==UDRV_ENGINE_DMA) kick_tx_dma(u); __asm volatile("nop"); }
-  if (u->cfg.tx_engine==UDRV_ENGINE_DMA){ while (u->dma_tx->CCR & DMA_CCR_EN) { __asm volatile("nop"); } }
+  if (u->cfg.tx_engine==UDRV_ENGINE_DMA){ while (u->tx_dma_len || u->tx_ref_count) { kick_tx_dma(u); __asm volatile("nop"); } }
   while ((u->inst->ISR & (1u<<6))==0u) { __asm volatile("nop"); } /* TC */
 }
 
 /* ===== ISR USART ===== */
+/* RX DMA: entrega ao on_rx_chunk o que chegou desde o último evento, até a
+   posição do DMA dada por now (valor de CNDTR) */
+static void rx_dma_deliver(usart_drv_t *u, uint32_t now){
+  uint32_t size=u->rx_dma_size, last=u->rx_dma_last;
+  uint32_t delta = (last>=now)?(last-now):(last+size-now);
+  u->rx_dma_last = now;
+
+  if (delta && u->on_rx_chunk){
+    uint32_t write_idx = (size - now) % size;
+    uint32_t start = (write_idx + size - delta) % size;
+    if (start + delta <= size){
+      u->on_rx_chunk(&u->rx_dma_buf[start << u->wshift], delta);
+    } else {
+      uint32_t first = size - start;
+      u->on_rx_chunk(&u->rx_dma_buf[start << u->wshift], first);
+      u->on_rx_chunk(&u->rx_dma_buf[0], delta - first);
+    }
+  }
+}
+
+/* algum evento que usart_irq_core atende: flag com a interrupção habilitada, ou erro */
+static inline bool usart_irq_pending(const USART_TypeDef *us){
+  uint32_t isr = us->ISR, cr1 = us->CR1, en = 0xFu;                  /* PE/FE/NE/ORE */
+  if (cr1 & (1u<<5))  en |= (1u<<5);                                  /* RXNE */
+  if (cr1 & (1u<<4))  en |= (1u<<4);                                  /* IDLE */
+  if (cr1 & (1u<<6))  en |= (1u<<6);                                  /* TC   */
+  if (cr1 & (1u<<7))  en |= (1u<<7);                                  /* TXE  */
+  if (cr1 & (1u<<14)) en |= (1u<<17);                                 /* CMF  */
+  if (cr1 & (1u<<26)) en |= (1u<<11);                                 /* RTOF */
+  return (isr & en) != 0u;
+}
+
 static void usart_irq_core(usart_drv_t *u){
   USART_TypeDef *us = u->inst;
   uint32_t isr = us->ISR;
 
-  /* IDLE: RX DMA → calcula delta e repassa via callback */
-  if ((isr & (1u<<4)) && u->cfg.rx_engine==UDRV_ENGINE_DMA){
-    (void)us->RDR; us->ICR = (1u<<4);
-    uint32_t size=u->rx_dma_size, last=u->rx_dma_last, now=u->dma_rx->CNDTR;
-    uint32_t delta = (last>=now)?(last-now):(last+size-now);
-    u->rx_dma_last = now;
-
-    if (delta && u->on_rx_chunk){
-      uint32_t write_idx = (size - now) % size;
-      uint32_t start = (write_idx + size - delta) % size;
-      if (start + delta <= size){
-        u->on_rx_chunk(&u->rx_dma_buf[start], delta);
-      } else {
-        uint32_t first = size - start;
-        u->on_rx_chunk(&u->rx_dma_buf[start], first);
-        u->on_rx_chunk(&u->rx_dma_buf[0], delta - first);
-      }
-    }
-  }
-
   /* RXNE: RX por IRQ para enfileirar no ring */
   if ((isr & (1u<<5)) && u->cfg.rx_engine==UDRV_ENGINE_IRQ){
     uint16_t d=(uint16_t)us->RDR;
-    rb_put(&u->rx_rb, (uint8_t)(d & 0xFFu));
+    rb_put(&u->rx_rb, (uint16_t)(d & 0x1FFu));
+  }
+
+  /* Fim de frame: IDLE / RTOF / CMF (limpos com uma escrita no ICR) */
+  uint32_t frame = 0, clr = 0, cr1 = us->CR1;
+  if ((isr & (1u<<4))  && (cr1 & (1u<<4)))  { frame |= UDRV_FRAME_IDLE; clr |= (1u<<4);  }
+  if ((isr & (1u<<11)) && (cr1 & (1u<<26))) { frame |= UDRV_FRAME_RTO;  clr |= (1u<<11); }
+  if ((isr & (1u<<17)) && (cr1 & (1u<<14))) { frame |= UDRV_FRAME_CHAR; clr |= (1u<<17); }
+  if (frame) {
+    const bool rx_dma = (u->cfg.rx_engine==UDRV_ENGINE_DMA);
+    /* sem IDLE na config: IDLEIE só enquanto houver CHAR pendente (abaixo) */
+    const bool idle_aux = u->cfg.rx_frame && !(u->cfg.rx_frame & UDRV_FRAME_IDLE);
+
+    /* CMF sobe junto com RXNE. Se o byte casado ainda está no RDR, não espera o
+       DMA aqui: entrega o que já está no buffer e fecha esse frame no próximo
+       IDLE/RTOF/CMF. CNDTR é lido antes de RXNE: com RXNE ainda em 1, o byte
+       não entrou na contagem. */
+    uint32_t now = 0; bool late = false;
+    if (rx_dma) {
+      now  = u->dma_rx->CNDTR;
+      late = (frame & UDRV_FRAME_CHAR) && (us->ISR & (1u<<5));
+      if (late && idle_aux) clr |= (1u<<4);   /* IDLE antigo não conta */
+    }
+    us->ICR = clr;
+
+    if (rx_dma) {
+      /* frame pendente (o DMA já levou o byte casado): fecha até o fim gravado */
+      if (u->rx_cm_pending) {
+        u->rx_cm_pending = 0;
+        rx_dma_deliver(u, u->rx_cm_end);
+        if (u->on_rx_frame) u->on_rx_frame(u, UDRV_FRAME_CHAR);
+      }
+      if (late) {
+        frame &= ~UDRV_FRAME_CHAR;
+        u->rx_cm_end = (now > 1u) ? now - 1u : u->rx_dma_size;
+        u->rx_cm_pending = 1;
+      }
+      rx_dma_deliver(u, now);
+
+      if (idle_aux) {
+        frame &= ~UDRV_FRAME_IDLE;
+        if (late) us->CR1 |= (1u<<4); else us->CR1 &= ~(1u<<4);
+      }
+    }
+    if (frame && u->on_rx_frame) u->on_rx_frame(u, frame);
   }
 
   /* TXE: TX por IRQ para drenar ring */
   if ((isr & (1u<<7)) && (us->CR1 & (1u<<7)) && u->cfg.tx_engine==UDRV_ENGINE_IRQ){
     if (rb_avail(&u->tx_rb)){
-      uint8_t b=u->tx_rb.buf[u->tx_rb.tail];
+      uint16_t d=rb_peek1(&u->tx_rb);
       u->tx_rb.tail=(u->tx_rb.tail+1u)&(u->tx_rb.size-1u);
-      us->TDR=b;
+      us->TDR=d;
     } else {
       us->CR1 &= ~(1u<<7); /* TXEIE off */
       us->CR1 |=  (1u<<6); /* TCIE on para notificar fim */
@@ -277,5 +594,14 @@ static void usart_irq_core(usart_drv_t *u){
   }
 }
 
-void USART1_IRQHandler(void){ if (g_u1) usart_irq_core(g_u1); }
-void USART2_IRQHandler(void){ if (g_u2) usart_irq_core(g_u2); }
+void USART1_IRQHandler(void){ if (g_usart[0]) usart_irq_core(g_usart[0]); }
+void USART2_IRQHandler(void){ if (g_usart[1]) usart_irq_core(g_usart[1]); }
+
+/* Vetor compartilhado: atende cada USART registrada que tenha evento habilitado
+   pendente (as duas podem estar pendentes na mesma entrada) */
+void USART3_4_5_6_IRQHandler(void){
+  for (uint8_t i = 2; i < USART_DRV_COUNT; i++) {
+    usart_drv_t *u = g_usart[i];
+    if (u && usart_irq_pending(u->inst)) usart_irq_core(u);
+  }
+}
@@ -22,6 +22,13 @@ typedef enum {
 	UDRV_ENGINE_DMA = 1
 } udrv_engine_t;
 
+/* Fechamento de frame no RX (OR dos valores). 0 = padrão: IDLE com RX=DMA, nada com RX=IRQ */
+typedef enum {
+	UDRV_FRAME_IDLE = 1u << 0,   /* linha parada por 1 frame (IDLE) */
+	UDRV_FRAME_RTO  = 1u << 1,   /* receiver timeout: rto_bits de silêncio (RTOR/RTOF; USART1 no F070) */
+	UDRV_FRAME_CHAR = 1u << 2    /* character match: byte recebido == match_char (ADD/CMF) */
+} udrv_frame_t;
+
 typedef struct {
   uint32_t        baud;
   udrv_wordlen_t  wordlen;
@@ -30,19 +37,64 @@ typedef struct {
   uint8_t         oversample8;     /* 0=16x, 1=8x */
 
   udrv_engine_t   rx_engine;       /* IRQ ou DMA (DMA usa buffer circular + IDLE) */
-  udrv_engine_t   tx_engine;       /* IRQ (ring) ou DMA (ring→rajadas) */
+  udrv_engine_t   tx_engine;       /* IRQ (ring) ou DMA (ring→rajadas); sem canal DMA livre → IRQ */
 
   uint8_t         nvic_prio_usart; /* 0..3 (Cortex-M0: 2 MSBs efetivos) */
+
+  uint8_t         rx_frame;        /* udrv_frame_t (OR); 0 = padrão */
+  uint8_t         match_char;      /* UDRV_FRAME_CHAR: ex. '\n' ou 0x00 (COBS) */
+  uint32_t        rto_bits;        /* UDRV_FRAME_RTO: silêncio em bits (até 0xFFFFFF); ex. 11*2 = 2 chars */
+
+  /* Mute multiprocessador (address mark, MSB do caractere = 1): em mute a USART
+     descarta em hardware tudo até um endereço igual a mute_addr. Usa o ADD do
+     character match (UDRV_FRAME_CHAR fica sem efeito). */
+  uint8_t         mute;            /* 1 = MME + WAKE por address mark */
+  uint8_t         mute_addr;       /* endereço do nó (7 bits) */
+
+  /* RS-485 half-duplex: a USART comanda o pino DE do transceiver (DEM), sem GPIO.
+     DE sobe de_assert antes do start bit e cai de_deassert depois do fim do
+     último stop bit (TC). Tempos em amostras: 1/16 de bit (ou 1/8 com
+     oversample8), 0..31. Pino DE = RTS da USART (USART1: PA12 AF1). */
+  uint8_t         rs485;           /* 1 = DEM */
+  uint8_t         de_active_low;   /* DEP: 0 = DE ativo em nível alto */
+  uint8_t         de_assert;       /* DEAT */
+  uint8_t         de_deassert;     /* DEDT */
 } usart_drv_config_t;
 
-/* Ring (potência de 2) */
-typedef struct { volatile uint32_t head, tail, size; uint8_t *buf; } udrv_ring_t;
+/* Ring (potência de 2 itens); shift = 1: itens de 16 bits (9 bits de dado) */
+typedef struct { volatile uint32_t head, tail, size; uint8_t *buf; uint8_t shift; } udrv_ring_t;
+
+/* 9 bits: caractere de endereço (bit 8 = marca) para nós em mute */
+#define UDRV_ADDR(a)   ((uint16_t)(0x100u | ((a) & 0x7Fu)))
+
+/* USART1..USART4 (USART3/4 no vetor compartilhado USART3_4_5_6_IRQHandler) */
+#define USART_DRV_COUNT  4u
+
+/* Buffers do chamador enviados direto por DMA (usart_write_ref) */
+#ifndef USART_TX_REF_QUEUE_LEN
+#define USART_TX_REF_QUEUE_LEN  4u
+#endif
+
+typedef void (*udrv_ref_cb_t)(const void *buf, void *ctx);
 
-/* Handle */
 typedef struct {
-  USART_TypeDef *inst;
+  const uint8_t *buf;
+  uint32_t       len;
+  uint32_t       mark;               /* tx_rb.head no enfileiramento: ring antes dele sai primeiro */
+  udrv_ref_cb_t  cb;
+  void          *ctx;
+} udrv_tx_ref_t;
+
+/* Trecho contíguo do buffer RX (DMA) */
+typedef struct { const uint8_t *ptr; uint32_t len; } udrv_span_t;
+
+/* Handle */
+typedef struct usart_drv_s {
+  USART_TypeDef *inst;               /* NULL: instância inválida no init */
   uint32_t       pclk_hz;
   usart_drv_config_t cfg;
+  uint8_t        idx;                /* 0..3 = USART1..USART4 */
+  uint8_t        wshift;             /* 1 = 9 bits de dado: itens de uint16_t em rings/DMA */
 
   /* RX */
   /* IRQ: ring; DMA: buffer linear circular + IDLE */
@@ -52,20 +104,39 @@ typedef struct {
   DMA_Channel_TypeDef *dma_rx;
   uint8_t     rx_ch_idx;             /* 1..7 para dma_router */
   volatile uint32_t rx_dma_last;     /* CNDTR anterior (para delta) */
+  volatile uint32_t rx_laps;         /* voltas do DMA RX (TC) */
+  uint32_t    rx_rd;                 /* bytes consumidos via peek/consume (contador livre) */
+  uint32_t    rx_rd_idx;             /* posição de leitura em rx_dma_buf */
+  volatile uint32_t rx_overruns;     /* DMA sobrescreveu dados não consumidos */
+  volatile uint8_t  rx_cm_pending;   /* CMF com o byte casado ainda no RDR: frame fecha no próximo evento */
+  uint32_t    rx_cm_end;             /* CNDTR logo após o byte casado pendente */
 
   /* TX */
   udrv_ring_t tx_rb;                 /* sempre ring */
   DMA_Channel_TypeDef *dma_tx;       /* quando TX=DMA (rajadas) */
   uint8_t     tx_ch_idx;             /* 1..7 para dma_router */
-  volatile uint16_t tx_dma_len;      /* bytes da rajada atual */
+  volatile uint32_t tx_dma_len;      /* bytes da rajada atual (0 = DMA livre) */
+  dma_router_desc_t tx_desc[2];      /* rajada encadeada quando o ring dá a volta */
+  udrv_tx_ref_t tx_ref[USART_TX_REF_QUEUE_LEN];
+  volatile uint8_t  tx_ref_head, tx_ref_count;
+  volatile uint8_t  tx_is_ref;       /* rajada atual é do ref da frente (não do ring) */
+  uint32_t    tx_ref_off;            /* bytes do ref da frente já enviados */
 
   /* Callbacks */
-  void (*on_rx_chunk)(const uint8_t *data, uint32_t len); /* somente RX=DMA+IDLE */
+  void (*on_rx_chunk)(const uint8_t *data, uint32_t len); /* somente RX=DMA+IDLE (independe de peek/consume) */
   void (*on_tx_done)(void);
   void (*on_error)(uint32_t usart_isr, uint32_t dma_flags);
+  void (*on_tx_wait)(void);          /* usart_write com ring cheio (NULL = espera ocupada) */
+  /* frame fechado (cause = UDRV_FRAME_*); com RX=DMA roda depois do on_rx_chunk do mesmo evento.
+     Com RX=DMA, um CHAR cujo byte o DMA ainda não levou é fechado no evento seguinte. */
+  void (*on_rx_frame)(struct usart_drv_s *u, uint32_t cause);
 } usart_drv_t;
 
-/* ===== API ===== */
+/* ===== API =====
+   9 bits de dado (UDRV_WORDLEN_9B sem paridade): rings, buffer RX de DMA,
+   usart_write/try_write/write_ref/read, spans e on_rx_chunk trabalham com
+   uint16_t; os comprimentos passam a ser em itens. rx_len/tx_len do init
+   continuam em bytes (tamanho do buffer). Com paridade o dado tem 8 bits. */
 void usart_init(usart_drv_t *u, USART_TypeDef *inst, uint32_t pclk_hz,
                 const usart_drv_config_t *cfg,
                 /* RX:
@@ -80,16 +151,55 @@ void usart_set_callbacks(usart_drv_t *u,
                          void (*on_tx_done)(void),
                          void (*on_error)(uint32_t, uint32_t));
 
-/* Escrita (ring) — dispara por IRQ (TXE) ou por DMA (rajadas) */
+/* Mute (cfg.mute): volta a ignorar a linha até o próximo endereço igual a mute_addr.
+   O caractere de endereço que acorda o nó é recebido normalmente. */
+void usart_mute_enter(usart_drv_t *u);
+
+/* Fim de frame (IDLE/RTO/character match conforme cfg.rx_frame), no contexto da ISR */
+void usart_set_frame_callback(usart_drv_t *u, void (*on_rx_frame)(usart_drv_t*, uint32_t));
+
+/* Escrita (ring) — dispara por IRQ (TXE) ou por DMA (rajadas).
+   Bloqueia até copiar tudo; enquanto o ring estiver cheio chama o idle hook. */
 uint32_t usart_write(usart_drv_t *u, const void *data, uint32_t len);
 
-/* Leitura do RX ring (somente RX=IRQ). Retorna bytes lidos. */
+/* Escrita sem bloquear: copia o que couber no ring e retorna quantos bytes (0..len) */
+uint32_t usart_try_write(usart_drv_t *u, const void *data, uint32_t len);
+
+/* Espaço livre no ring TX (itens) */
+uint32_t usart_tx_free(const usart_drv_t *u);
+
+/* Chamado por usart_write a cada espera por espaço no ring (ex.: __WFI, tarefas
+   do loop). Roda no contexto de quem chamou usart_write. NULL = espera ocupada. */
+void usart_set_idle_hook(usart_drv_t *u, void (*on_tx_wait)(void));
+
+/* TX=DMA sem cópia: enfileira buf (RAM ou flash) para envio direto, na ordem
+   em relação ao que já foi escrito com usart_write. buf deve continuar válido
+   até done_cb (chamado na ISR do DMA, um por buffer). Erro de DMA no envio:
+   o buffer é abandonado, done_cb é chamado e on_error recebe os flags.
+   false: fila cheia, len = 0 ou TX não é DMA. */
+bool usart_write_ref(usart_drv_t *u, const void *buf, uint32_t len,
+                     udrv_ref_cb_t done_cb, void *ctx);
+
+/* Leitura: RX=IRQ tira do ring; RX=DMA copia via usart_rx_peek/consume.
+   Retorna bytes lidos. */
 uint32_t usart_read(usart_drv_t *u, void *out, uint32_t maxlen);
 
+/* RX=DMA sem cópia: expõe até dois trechos de rx_dma_buf ainda não consumidos
+   (span[1] só é usado quando os dados dão a volta no buffer). Retorna o total.
+   Se o DMA deu a volta sobre dados não consumidos, descarta tudo, conta em
+   rx_overruns e retorna 0. Chamar do loop principal (não de ISR/seção crítica):
+   a posição de escrita usa o contador de voltas atualizado na ISR do DMA. */
+uint32_t usart_rx_peek(usart_drv_t *u, udrv_span_t span[2]);
+
+/* Libera n bytes já processados. false: o DMA sobrescreveu parte do que foi
+   exposto pelo peek antes do consume (dados lidos suspeitos; leitor ressincroniza). */
+bool usart_rx_consume(usart_drv_t *u, uint32_t n);
+
 /* Flush TX (espera esvaziar e TC) */
 void usart_flush(usart_drv_t *u);
 
 void USART1_IRQHandler(void);
 void USART2_IRQHandler(void);
+void USART3_4_5_6_IRQHandler(void);
 
 #endif /* STM32F070_USART_DRV_H */
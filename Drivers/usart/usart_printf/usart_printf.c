@@ -0,0 +1,172 @@
+#include "usart_printf.h"
+
+static usart_drv_t     *s_u = NULL;
+static uprintf_policy_t s_policy = UPRINTF_DROP;
+static uprintf_stats_t  s_st;
+
+/* ===== Saída ===== */
+void uprintf_init(usart_drv_t *u, uprintf_policy_t policy){
+  s_u = u; s_policy = policy;
+  s_st.dropped_writes = 0; s_st.dropped_bytes = 0;
+}
+
+const uprintf_stats_t *uprintf_stats(void){ return &s_st; }
+
+int uprintf_write(const char *ptr, int len){
+  usart_drv_t *u = s_u;
+  if (len <= 0) return 0;
+  if (!u) { s_st.dropped_bytes += (uint32_t)len; return len; }
+
+  if (s_policy == UPRINTF_BLOCK) {
+    usart_write(u, ptr, (uint32_t)len);
+    return len;
+  }
+
+  /* DROP/TRUNCATE: checagem de espaço e cópia sem ISR no meio (pode ser chamado de ISR) */
+  uint32_t n = (uint32_t)len, sent = 0;
+  uint32_t pm = irq_lock();
+  if (s_policy == UPRINTF_TRUNCATE || usart_tx_free(u) >= n) sent = usart_try_write(u, ptr, n);
+  irq_unlock(pm);
+
+  if (sent < n) {
+    if (!sent) s_st.dropped_writes++;
+    s_st.dropped_bytes += n - sent;
+  }
+  return len;
+}
+
+/* gancho de _write (syscalls.c); sem driver ligado, _write volta ao __io_putchar */
+int __io_write(const char *ptr, int len){
+  if (!s_u) return -1;
+  return uprintf_write(ptr, len);
+}
+
+/* ===== Formatador ===== */
+typedef struct {
+  char    *buf;
+  uint32_t size;     /* capacidade de buf */
+  uint32_t pos;      /* bytes em buf */
+  uint32_t total;    /* bytes produzidos (retorno) */
+  uint8_t  flush;    /* 1: buf cheio vai para uprintf_write */
+} fmt_out_t;
+
+static void out_put(fmt_out_t *o, char c){
+  o->total++;
+  if (o->pos < o->size) o->buf[o->pos++] = c;
+  if (o->flush && o->pos == o->size) { uprintf_write(o->buf, (int)o->pos); o->pos = 0; }
+}
+
+static void out_pad(fmt_out_t *o, char c, int n){
+  while (n-- > 0) out_put(o, c);
+}
+
+/* Cortex-M0 não divide em hardware: decimal por subtração de potências de 10 */
+static const uint32_t s_pow10[10] = {
+  1000000000u, 100000000u, 10000000u, 1000000u, 100000u, 10000u, 1000u, 100u, 10u, 1u
+};
+
+static uint32_t utoa_dec(uint32_t v, char *d){
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < 10u; i++) {
+    char c = '0';
+    while (v >= s_pow10[i]) { v -= s_pow10[i]; c++; }
+    if (c != '0' || n || i == 9u) d[n++] = c;
+  }
+  return n;
+}
+
+static uint32_t utoa_hex(uint32_t v, char *d, bool upper){
+  const char *dig = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+  uint32_t n = 0;
+  int s = 28;
+  while (s > 0 && !(v >> s)) s -= 4;
+  for (; s >= 0; s -= 4) d[n++] = dig[(v >> s) & 0xFu];
+  return n;
+}
+
+static void vformat(fmt_out_t *o, const char *fmt, va_list ap){
+  char num[12];
+
+  for (; *fmt; fmt++) {
+    if (*fmt != '%') { out_put(o, *fmt); continue; }
+    fmt++;
+
+    bool left = false, zero = false;
+    for (;; fmt++) {
+      if      (*fmt == '-') left = true;
+      else if (*fmt == '0') zero = true;
+      else break;
+    }
+    int width = 0;
+    if (*fmt == '*') { width = va_arg(ap, int); fmt++; if (width < 0) { left = true; width = -width; } }
+    else while (*fmt >= '0' && *fmt <= '9') width = width * 10 + (*fmt++ - '0');
+    while (*fmt == 'l') fmt++;                       /* long = int no Cortex-M0 */
+
+    const char *s = num;
+    uint32_t n = 0;
+    char sign = 0;
+    switch (*fmt) {
+      case 'd': case 'i': {
+        int v = va_arg(ap, int);
+        uint32_t m = (uint32_t)v;
+        if (v < 0) { sign = '-'; m = 0u - m; }
+        n = utoa_dec(m, num);
+        break;
+      }
+      case 'u': n = utoa_dec(va_arg(ap, unsigned), num); break;
+      case 'x': n = utoa_hex(va_arg(ap, unsigned), num, false); break;
+      case 'X': n = utoa_hex(va_arg(ap, unsigned), num, true); break;
+      case 'p': {
+        uint32_t v = (uint32_t)(uintptr_t)va_arg(ap, void*);
+        out_put(o, '0'); out_put(o, 'x'); width -= 2;
+        n = utoa_hex(v, num, false);
+        break;
+      }
+      case 'c': num[0] = (char)va_arg(ap, int); n = 1; break;
+      case 's': s = va_arg(ap, const char*); if (!s) s = "(null)"; n = (uint32_t)strlen(s); break;
+      case '%': out_put(o, '%'); continue;
+      case '\0': return;
+      default:  out_put(o, '%'); out_put(o, *fmt); continue;  /* não suportado: ecoa */
+    }
+
+    int pad = width - (int)n - (sign ? 1 : 0);
+    if (!left && !zero) out_pad(o, ' ', pad);
+    if (sign) out_put(o, sign);
+    if (!left && zero) out_pad(o, '0', pad);
+    for (uint32_t i = 0; i < n; i++) out_put(o, s[i]);
+    if (left) out_pad(o, ' ', pad);
+  }
+}
+
+int uvsnprintf(char *buf, uint32_t size, const char *fmt, va_list ap){
+  fmt_out_t o = { buf, size ? size - 1u : 0u, 0, 0, 0 };
+  vformat(&o, fmt, ap);
+  if (size) buf[o.pos] = '\0';
+  return (int)o.total;
+}
+
+int usnprintf(char *buf, uint32_t size, const char *fmt, ...){
+  va_list ap;
+  va_start(ap, fmt);
+  int n = uvsnprintf(buf, size, fmt, ap);
+  va_end(ap);
+  return n;
+}
+
+/* formata em blocos de UPRINTF_CHUNK na pilha: linhas longas saem em mais de
+   uma escrita (com DROP, cada bloco é aceito ou descartado por inteiro) */
+int uvprintf(const char *fmt, va_list ap){
+  char chunk[UPRINTF_CHUNK];
+  fmt_out_t o = { chunk, sizeof chunk, 0, 0, 1 };
+  vformat(&o, fmt, ap);
+  if (o.pos) uprintf_write(chunk, (int)o.pos);
+  return (int)o.total;
+}
+
+int uprintf(const char *fmt, ...){
+  va_list ap;
+  va_start(ap, fmt);
+  int n = uvprintf(fmt, ap);
+  va_end(ap);
+  return n;
+}
@@ -0,0 +1,57 @@
+/*
+ * usart_printf.h
+ *
+ *  Saída de printf/puts (newlib _write) no ring TX de um usart_drv_t, sem
+ *  esperar a linha: o chamador só paga a cópia para o ring; a transmissão
+ *  segue por DMA (ou IRQ). Com o ring cheio vale a política configurada.
+ *  - UPRINTF_DROP: a escrita inteira é descartada e contada (mensagem nunca
+ *    sai cortada).
+ *  - UPRINTF_TRUNCATE: envia o que couber e conta os bytes cortados.
+ *  - UPRINTF_BLOCK: espera espaço (usart_write; usa o idle hook do driver).
+ *  DROP/TRUNCATE podem ser usados em ISR (cópia sob irq_lock); BLOCK só no
+ *  contexto principal.
+ *
+ *  uprintf/usnprintf: formatador só com inteiros, sem heap nem vfprintf:
+ *  %d %i %u %x %X %c %s %p %%, flags '-' e '0', largura (número ou '*') e
+ *  modificador 'l' (aceito e ignorado: long tem 32 bits). Sem float.
+ */
+
+#ifndef __USART_PRINTF_H__
+#define __USART_PRINTF_H__
+
+#include <stdarg.h>
+#include "usart_irq_dma.h"
+
+/* buffer de pilha do uprintf (descarregado no ring a cada enchimento) */
+#ifndef UPRINTF_CHUNK
+#define UPRINTF_CHUNK   64u
+#endif
+
+typedef enum {
+	UPRINTF_DROP     = 0,
+	UPRINTF_TRUNCATE = 1,
+	UPRINTF_BLOCK    = 2
+} uprintf_policy_t;
+
+typedef struct {
+	volatile uint32_t dropped_writes;   /* escritas descartadas (DROP) */
+	volatile uint32_t dropped_bytes;    /* bytes perdidos (DROP + TRUNCATE) */
+} uprintf_stats_t;
+
+/* Liga _write (stdout/stderr) ao driver. u = NULL desliga (saída descartada). */
+void uprintf_init(usart_drv_t *u, uprintf_policy_t policy);
+
+/* Escrita crua com a política; retorna len (o que não coube é contado) */
+int  uprintf_write(const char *ptr, int len);
+
+int  uprintf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+int  uvprintf(const char *fmt, va_list ap);
+
+/* Formata em buf (sempre terminado em '\0' se size > 0); retorna o tamanho
+   completo, como snprintf */
+int  usnprintf(char *buf, uint32_t size, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+int  uvsnprintf(char *buf, uint32_t size, const char *fmt, va_list ap);
+
+const uprintf_stats_t *uprintf_stats(void);
+
+#endif /* __USART_PRINTF_H__ */
@@ -30,6 +30,7 @@
 #include "i2c_irq_dma.h"
 #include "adc_poll.h"
 #include "watchdog.h"
+#include "dma_mem.h"
 
 #ifdef __EXEMPLO_BOTAO__
 /**
@@ -310,6 +311,11 @@ int main(void)
     const char *hello = "USART1 DMA RX(IDLE)/TX ready\r\n";
     usart_write(&U1, hello, (uint32_t)strlen(hello));
 
+    /* Constante em flash enviada direto pelo DMA (sem passar pelo ring);
+       sai depois do hello, na ordem das chamadas */
+    static const char banner[] = "build " __DATE__ " " __TIME__ "\r\n";
+    usart_write_ref(&U1, banner, sizeof(banner) - 1u, NULL, NULL);
+
     /* Nada a fazer no loop — RX via DMA notifica por IDLE e o callback “on_rx_chunk”
        já faz eco. O TX usa DMA em rajadas disparadas por usart_write. */
     for (;;){ __asm volatile ("nop"); }
@@ -318,10 +324,273 @@ int main(void)
 /* No vetor de interrupções do startup:
    void USART1_IRQHandler(void);  // já implementada no driver
 
-   As interrupções de DMA (DMA1_Channel2_3 / 4_5) ficam TODAS em dma_router.c,
+   As interrupções de DMA (DMA1_CH2_3 / CH4_5) ficam TODAS em dma_router.c,
    não adiciona nada no vetor além do que o dma_router já define. */
 #endif
 
+#ifdef __EXEMPLO_USART_DMA_PEEK
+/* RX por DMA consumido no loop principal, direto no buffer circular:
+   linhas terminadas em '\n' são ecoadas sem copiar para um buffer intermediário.
+   O '\n' fecha o frame em hardware (character match): uma IRQ por linha. */
+#define RX_DMA_BUF_SZ 512
+#define TX_RING_SZ    512
+
+static usart_drv_t U1;
+static uint8_t rx_dma_buf[RX_DMA_BUF_SZ];
+static uint8_t tx_ring[TX_RING_SZ];
+static volatile uint32_t g_lines = 0;
+
+static void on_rx_frame(usart_drv_t *u, uint32_t cause)
+{
+    (void)u;
+    if (cause & UDRV_FRAME_CHAR) g_lines++;
+}
+
+int main(void)
+{
+    rcc_reset_to_hsi();
+    rcc_set_sysclk_from_hsi(48000000UL, RCC_AHB_DIV1, RCC_APB_DIV1);
+    dma_router_init(2);
+
+    gpio_pin_init(GPIOA, 9,  GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_UP);
+    gpio_pin_set_altfunc(GPIOA, 9, GPIO_AF1);
+    gpio_pin_init(GPIOA, 10, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_UP);
+    gpio_pin_set_altfunc(GPIOA, 10, GPIO_AF1);
+
+    usart_drv_config_t cfg = {
+        .baud = 115200, .wordlen = UDRV_WORDLEN_8B, .parity = UDRV_PARITY_NONE,
+        .stopbits = UDRV_STOPBITS_1, .oversample8 = 0,
+        .rx_engine = UDRV_ENGINE_DMA, .tx_engine = UDRV_ENGINE_DMA, .nvic_prio_usart = 2,
+        .rx_frame = UDRV_FRAME_CHAR, .match_char = '\n'
+    };
+    usart_init(&U1, USART1, 48000000UL, &cfg, rx_dma_buf, RX_DMA_BUF_SZ, tx_ring, TX_RING_SZ);
+    usart_set_callbacks(&U1, NULL, NULL, NULL);   /* sem on_rx_chunk: leitura por peek */
+    usart_set_frame_callback(&U1, on_rx_frame);
+
+    uint32_t lines_done = 0;
+    for (;;) {
+        if (lines_done == g_lines) continue;        /* nenhuma linha nova fechada */
+
+        udrv_span_t sp[2];
+        if (!usart_rx_peek(&U1, sp)) { lines_done = g_lines; continue; }
+
+        /* procura '\n' nos dois trechos; consome até ele (inclusive) */
+        uint32_t used = 0;
+        for (uint8_t i = 0; i < 2 && !used; i++) {
+            const uint8_t *nl = memchr(sp[i].ptr, '\n', sp[i].len);
+            if (!nl) continue;
+            uint32_t k = (uint32_t)(nl - sp[i].ptr) + 1u;
+            if (i) usart_write(&U1, sp[0].ptr, sp[0].len);
+            usart_write(&U1, sp[i].ptr, k);
+            used = (i ? sp[0].len : 0u) + k;
+        }
+        if (!used) { lines_done = g_lines; continue; }
+        lines_done++;
+        if (!usart_rx_consume(&U1, used)) {
+            /* DMA passou por cima durante o eco: a linha ecoada pode estar corrompida */
+            usart_write(&U1, "\r\n[overrun]\r\n", 15);
+        }
+    }
+}
+#endif
+
+#ifdef __EXEMPLO_USART_9BIT_MUTE
+/* Barramento multiponto 9 bits (ex.: RS-485): cada nó fica em mute e só
+   acorda quando passa o seu endereço (bit 8 = 1). O tráfego dos outros nós
+   é descartado pela USART, sem IRQ. RX/TX por DMA com itens de 16 bits. */
+#define NODE_ADDR   0x12u
+
+static usart_drv_t U1;
+static uint16_t rx_dma_buf[128];   /* 9 bits: buffers de uint16_t (tamanho em bytes no init) */
+static uint16_t tx_ring[64];
+
+static void on_rx_chunk(const uint8_t *data, uint32_t len)
+{
+    const uint16_t *w = (const uint16_t*)data;   /* len em itens */
+    for (uint32_t i = 0; i < len; i++) {
+        if (w[i] & 0x100u) continue;              /* o próprio endereço que nos acordou */
+        /* ... trata w[i] (dado de 8 bits no bit 8 = 0) ... */
+    }
+}
+
+static void on_rx_frame(usart_drv_t *u, uint32_t cause)
+{
+    (void)cause;
+    usart_mute_enter(u);                          /* fim da mensagem: volta a dormir */
+}
+
+int main(void)
+{
+    rcc_reset_to_hsi();
+    rcc_set_sysclk_from_hsi(48000000UL, RCC_AHB_DIV1, RCC_APB_DIV1);
+    dma_router_init(2);
+
+    gpio_pin_init(GPIOA, 9,  GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_UP);
+    gpio_pin_set_altfunc(GPIOA, 9, GPIO_AF1);
+    gpio_pin_init(GPIOA, 10, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_UP);
+    gpio_pin_set_altfunc(GPIOA, 10, GPIO_AF1);
+
+    usart_drv_config_t cfg = {
+        .baud = 115200, .wordlen = UDRV_WORDLEN_9B, .parity = UDRV_PARITY_NONE,
+        .stopbits = UDRV_STOPBITS_1, .oversample8 = 0,
+        .rx_engine = UDRV_ENGINE_DMA, .tx_engine = UDRV_ENGINE_DMA, .nvic_prio_usart = 2,
+        .mute = 1, .mute_addr = NODE_ADDR
+    };
+    usart_init(&U1, USART1, 48000000UL, &cfg,
+               (uint8_t*)rx_dma_buf, sizeof rx_dma_buf, (uint8_t*)tx_ring, sizeof tx_ring);
+    usart_set_callbacks(&U1, on_rx_chunk, NULL, NULL);
+    usart_set_frame_callback(&U1, on_rx_frame);
+    usart_mute_enter(&U1);
+
+    /* mensagem para o nó 0x05: endereço + dados */
+    static const uint16_t msg[] = { UDRV_ADDR(0x05), 'o', 'l', 'a' };
+    usart_write(&U1, msg, sizeof msg / sizeof msg[0]);
+
+    for (;;) { __asm volatile ("nop"); }
+}
+#endif
+
+#ifdef __EXEMPLO_USART_RS485
+/* RS-485 half-duplex: DE do transceiver no PA12 (USART1_DE, AF1) comandado pela
+   própria USART. Mestre envia a requisição por DMA e o fim da resposta é
+   detectado por receiver timeout (3,5 caracteres); sem GPIO no on_tx_done. */
+static usart_drv_t U1;
+static uint8_t rx_dma_buf[256];
+static uint8_t tx_ring[256];
+static volatile uint32_t g_resp_len = 0;
+
+static void on_rx_chunk(const uint8_t *data, uint32_t len)
+{
+    (void)data;
+    g_resp_len += len;   /* ... copia/trata a resposta ... */
+}
+
+static void on_rx_frame(usart_drv_t *u, uint32_t cause)
+{
+    (void)u; (void)cause;   /* UDRV_FRAME_RTO: resposta completa */
+}
+
+int main(void)
+{
+    rcc_reset_to_hsi();
+    rcc_set_sysclk_from_hsi(48000000UL, RCC_AHB_DIV1, RCC_APB_DIV1);
+    dma_router_init(2);
+
+    gpio_pin_init(GPIOA, 9,  GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_UP);
+    gpio_pin_set_altfunc(GPIOA, 9, GPIO_AF1);
+    gpio_pin_init(GPIOA, 10, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_UP);
+    gpio_pin_set_altfunc(GPIOA, 10, GPIO_AF1);
+    gpio_pin_init(GPIOA, 12, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_NONE);
+    gpio_pin_set_altfunc(GPIOA, 12, GPIO_AF1);                /* USART1_DE */
+
+    usart_drv_config_t cfg = {
+        .baud = 115200, .wordlen = UDRV_WORDLEN_8B, .parity = UDRV_PARITY_NONE,
+        .stopbits = UDRV_STOPBITS_1, .oversample8 = 0,
+        .rx_engine = UDRV_ENGINE_DMA, .tx_engine = UDRV_ENGINE_DMA, .nvic_prio_usart = 2,
+        .rx_frame = UDRV_FRAME_RTO, .rto_bits = 35u,           /* 3,5 caracteres de 10 bits */
+        .rs485 = 1, .de_active_low = 0,
+        .de_assert = 16, .de_deassert = 16                     /* 1 bit antes/depois (16 amostras) */
+    };
+    usart_init(&U1, USART1, 48000000UL, &cfg, rx_dma_buf, sizeof rx_dma_buf, tx_ring, sizeof tx_ring);
+    usart_set_callbacks(&U1, on_rx_chunk, NULL, NULL);
+    usart_set_frame_callback(&U1, on_rx_frame);
+
+    static const uint8_t req[] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x02, 0xC4, 0x0B };
+    for (;;) {
+        usart_write(&U1, req, sizeof req);
+        systick_delay_ms(48000000UL, 100);
+    }
+}
+#endif
+
+#ifdef __EXEMPLO_USART_PRINTF
+/* Log sem travar o laço: printf/uprintf vão para o ring TX (DMA) e retornam;
+   com o ring cheio a mensagem é descartada e contada (UPRINTF_DROP).
+   Linkar Drivers/usart/usart_printf/usart_printf.c (fornece __io_write). */
+#include <stdio.h>
+#include "usart_printf.h"
+
+static usart_drv_t U1;
+static uint8_t rx_ring[64];
+static uint8_t tx_ring[1024];
+
+int main(void)
+{
+    rcc_reset_to_hsi();
+    rcc_set_sysclk_from_hsi(48000000UL, RCC_AHB_DIV1, RCC_APB_DIV1);
+    dma_router_init(2);
+
+    gpio_pin_init(GPIOA, 2, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_UP);
+    gpio_pin_set_altfunc(GPIOA, 2, GPIO_AF1);                 /* USART2_TX (ST-LINK VCP) */
+
+    usart_drv_config_t cfg = {
+        .baud = 115200, .wordlen = UDRV_WORDLEN_8B, .parity = UDRV_PARITY_NONE,
+        .stopbits = UDRV_STOPBITS_1, .oversample8 = 0,
+        .rx_engine = UDRV_ENGINE_IRQ, .tx_engine = UDRV_ENGINE_DMA, .nvic_prio_usart = 3
+    };
+    usart_init(&U1, USART2, 48000000UL, &cfg, rx_ring, sizeof rx_ring, tx_ring, sizeof tx_ring);
+    uprintf_init(&U1, UPRINTF_DROP);
+
+    printf("boot\r\n");                                         /* newlib → _write → ring */
+
+    for (uint32_t it = 0;; it++) {
+        /* ... laço de controle ... */
+        if ((it & 0xFFFFu) == 0u)
+            uprintf("it=%lu perdidas=%lu\r\n", (unsigned long)it,
+                    (unsigned long)uprintf_stats()->dropped_writes);
+    }
+}
+#endif
+
+#ifdef __EXEMPLO_TRACE
+/* Log binário: cada TRACE() grava ID + argumentos crus (sem formatar) e o ring
+   escoa por DMA na USART2 (VCP). No PC:
+     python3 Tools/trace_decode.py Debug/drivers_stm32f070.elf captura.bin
+   Linkar Drivers/trace/trace.c. */
+#include "trace.h"
+
+static usart_drv_t U2;
+static uint8_t rx_ring[16];
+static uint8_t tx_ring[64];          /* pouco uso: o trace sai por write_ref direto do seu ring */
+static volatile uint32_t g_ticks = 0;
+
+static void on_tick(void)
+{
+    g_ticks++;
+    if ((g_ticks % 1000u) == 0u) TRACE("tick %u", g_ticks);   /* também vale em ISR */
+}
+
+int main(void)
+{
+    rcc_reset_to_hsi();
+    rcc_set_sysclk_from_hsi(48000000UL, RCC_AHB_DIV1, RCC_APB_DIV1);
+    dma_router_init(2);
+
+    gpio_pin_init(GPIOA, 2, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_UP);
+    gpio_pin_set_altfunc(GPIOA, 2, GPIO_AF1);
+
+    usart_drv_config_t cfg = {
+        .baud = 921600, .wordlen = UDRV_WORDLEN_8B, .parity = UDRV_PARITY_NONE,
+        .stopbits = UDRV_STOPBITS_1, .oversample8 = 0,
+        .rx_engine = UDRV_ENGINE_IRQ, .tx_engine = UDRV_ENGINE_DMA, .nvic_prio_usart = 3
+    };
+    usart_init(&U2, USART2, 48000000UL, &cfg, rx_ring, sizeof rx_ring, tx_ring, sizeof tx_ring);
+    trace_init(&U2);
+    systick_init_ms(48000000UL, 1, true, true, 2);
+    systick_set_callback(on_tick);
+
+    TRACE("boot, SYSCLK %u Hz", 48000000u);
+
+    int32_t err = 0;
+    for (uint32_t it = 0;; it++) {
+        /* ... laço de controle ... */
+        err = (int32_t)(it & 0xFFu) - 128;
+        if ((it & 0x3FFu) == 0u) TRACE("it=%u err=%d", it, err);
+        trace_poll();
+    }
+}
+#endif
+
 #ifdef __EXEMPLO_SPI_POLLING
 static inline void cs_low(void){  gpio_write_pin(GPIOC, 4, 0); }
 static inline void cs_high(void){ gpio_write_pin(GPIOC, 4, 1); }
@@ -477,7 +746,259 @@ int main(void)
 
 /* No vetor:
    void SPI1_IRQHandler(void);           // driver SPI
-   // As ISRs de DMA (DMA1_Channel2_3 / 4_5) ficam TODAS em dma_router.c */
+   // As ISRs de DMA (DMA1_CH2_3 / CH4_5) ficam TODAS em dma_router.c */
+#endif
+
+#ifdef __EXEMPLO_SPI_BUS
+/*
+ * Dois dispositivos no SPI1 com fila de transações:
+ *  - flash SPI (modo 0, 8 bits, CS em PC4): comando 0x03 + leitura na mesma seleção
+ *  - DAC de 16 bits (modo 1, 16 bits, CS em PB6)
+ * O loop só enfileira; as transações seguem umas às outras na ISR do DMA.
+ */
+#include "spi_bus.h"
+
+static spi_drv_t SPIx;
+static spi_bus_t BUS;
+
+static const spi_dev_t DEV_FLASH = {
+    .mode = SPI_MODE0, .baud_div = SPI_BR_DIV2, .bit_order = SPI_MSB_FIRST, .datasize = SPI_DS_8BIT,
+    .cs_port = GPIOC, .cs_pin = 4
+};
+static const spi_dev_t DEV_DAC = {
+    .mode = SPI_MODE1, .baud_div = SPI_BR_DIV4, .bit_order = SPI_MSB_FIRST, .datasize = SPI_DS_16BIT,
+    .cs_port = GPIOB, .cs_pin = 6
+};
+
+static uint8_t  rd_cmd[4] = { 0x03, 0x00, 0x10, 0x00 };   /* READ 0x001000 */
+static uint8_t  page[64];
+static uint16_t dac_word;
+static volatile uint8_t page_ok;
+
+static void on_page(void *ctx){ (void)ctx; page_ok = 1; }
+
+int main(void)
+{
+    rcc_reset_to_hsi();
+    rcc_set_sysclk_from_hsi(48000000UL, RCC_AHB_DIV1, RCC_APB_DIV1);
+    dma_router_init(2);
+
+    /* Pinos SPI1 (AF0) */
+    gpio_pin_init(GPIOA,5, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_NONE); gpio_pin_set_altfunc(GPIOA,5, GPIO_AF0);
+    gpio_pin_init(GPIOA,6, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_UP  ); gpio_pin_set_altfunc(GPIOA,6, GPIO_AF0);
+    gpio_pin_init(GPIOA,7, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_NONE); gpio_pin_set_altfunc(GPIOA,7, GPIO_AF0);
+
+    /* CS dos dispositivos (ativos em 0) */
+    gpio_pin_init(GPIOC,4, GPIO_MODE_OUTPUT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_NONE); gpio_write_pin(GPIOC,4,1);
+    gpio_pin_init(GPIOB,6, GPIO_MODE_OUTPUT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_NONE); gpio_write_pin(GPIOB,6,1);
+
+    /* o formato inicial não importa: o barramento carrega o de cada dispositivo */
+    spi_drv_config_t cfg = {
+        .mode=SPI_MODE0, .baud_div=SPI_BR_DIV2, .bit_order=SPI_MSB_FIRST, .datasize=SPI_DS_8BIT,
+        .nss_mode=SPI_NSS_SOFT,
+        .tx_engine=SPI_ENGINE_DMA, .rx_engine=SPI_ENGINE_DMA,
+        .nvic_prio_spi=2
+    };
+    spi_init(&SPIx, SPI1, &cfg);
+    spi_bus_init(&BUS, &SPIx);
+
+    for (;;) {
+        if (spi_bus_idle(&BUS)) {
+            spi_xfer_t x[3] = {
+                { .dev = &DEV_FLASH, .tx = rd_cmd, .count = sizeof rd_cmd, .keep_cs = 1 },
+                { .dev = &DEV_FLASH, .rx = page,   .count = sizeof page,   .cb = on_page },
+                { .dev = &DEV_DAC,   .tx = &dac_word, .count = 1 },
+            };
+            spi_bus_submit(&BUS, x, 3);
+            dac_word = (uint16_t)(dac_word + 64u);
+        }
+        __asm volatile ("wfi");
+    }
+}
+#endif
+
+#ifdef __EXEMPLO_SPI_AUTO_BENCH
+/*
+ * Mede POLL/IRQ/DMA no SPI1 para alguns divisores de baud e mostra os
+ * cruzamentos que o SPI_ENGINE_AUTO passa a usar. Saída na USART2 (VCP).
+ * Sem escravo: MOSI pode ficar aberto (o dado não importa, só o tempo).
+ * Linkar Drivers/usart/usart_printf/usart_printf.c.
+ */
+#include "usart_printf.h"
+
+static usart_drv_t U2;
+static uint8_t u_rx[16], u_tx[1024];
+static spi_drv_t SPIx;
+
+int main(void)
+{
+    rcc_reset_to_hsi();
+    rcc_set_sysclk_from_hsi(48000000UL, RCC_AHB_DIV1, RCC_APB_DIV1);
+    dma_router_init(2);
+
+    gpio_pin_init(GPIOA, 2, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_UP);
+    gpio_pin_set_altfunc(GPIOA, 2, GPIO_AF1);                 /* USART2_TX */
+    usart_drv_config_t ucfg = {
+        .baud = 115200, .wordlen = UDRV_WORDLEN_8B, .parity = UDRV_PARITY_NONE,
+        .stopbits = UDRV_STOPBITS_1, .oversample8 = 0,
+        .rx_engine = UDRV_ENGINE_IRQ, .tx_engine = UDRV_ENGINE_DMA, .nvic_prio_usart = 3
+    };
+    usart_init(&U2, USART2, 48000000UL, &ucfg, u_rx, sizeof u_rx, u_tx, sizeof u_tx);
+    uprintf_init(&U2, UPRINTF_BLOCK);
+
+    /* Pinos SPI1 (AF0) */
+    gpio_pin_init(GPIOA,5, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_NONE); gpio_pin_set_altfunc(GPIOA,5, GPIO_AF0);
+    gpio_pin_init(GPIOA,6, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_UP  ); gpio_pin_set_altfunc(GPIOA,6, GPIO_AF0);
+    gpio_pin_init(GPIOA,7, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_NONE); gpio_pin_set_altfunc(GPIOA,7, GPIO_AF0);
+
+    spi_drv_config_t cfg = {
+        .mode=SPI_MODE0, .baud_div=SPI_BR_DIV2, .bit_order=SPI_MSB_FIRST, .datasize=SPI_DS_8BIT,
+        .nss_mode=SPI_NSS_SOFT,
+        .tx_engine=SPI_ENGINE_AUTO, .rx_engine=SPI_ENGINE_AUTO,
+        .nvic_prio_spi=1
+    };
+    spi_init(&SPIx, SPI1, &cfg);
+
+    static const spi_baud_t divs[] = { SPI_BR_DIV2, SPI_BR_DIV8, SPI_BR_DIV32 };
+    spi_calib_t c;
+    for (uint32_t d = 0; d < sizeof divs / sizeof divs[0]; d++) {
+        spi_set_format(&SPIx, SPI_MODE0, divs[d], SPI_MSB_FIRST, SPI_DS_8BIT);
+        spi_calibrate(&SPIx, &c);
+        uprintf("\r\nSPI1 /%u: custo de CPU (ciclos)\r\n  itens   poll    irq    dma\r\n", 2u << divs[d]);
+        for (uint32_t i = 0; i < SPI_CAL_POINTS; i++)
+            uprintf("  %5u %6lu %6lu %6lu\r\n", c.len[i],
+                    (unsigned long)c.poll[i], (unsigned long)c.irq[i], (unsigned long)c.dma[i]);
+        uprintf("  AUTO: poll ate %u, irq ate %u, dma a partir de %u\r\n",
+                c.poll_max, (unsigned)(c.dma_min - 1u), c.dma_min);
+    }
+
+    /* carga mista: cada transação vai pelo engine mais barato para o tamanho */
+    static uint8_t reg[3] = { 0x80 | 0x0F, 0, 0 }, blk[256];
+    for (;;) {
+        spi_transfer_async(&SPIx, reg, reg, sizeof reg);   /* curta: POLL, já terminou */
+        spi_transfer_async(&SPIx, blk, blk, sizeof blk);   /* longa: DMA */
+        spi_wait(&SPIx);
+    }
+}
+#endif
+
+#ifdef __EXEMPLO_SPI_FLASH_BENCH
+/*
+ * Flash SPI NOR no SPI1 (CS em PC4): descoberta por JEDEC/SFDP e vazão de
+ * erase, program e read de 64 KB no fim da flash. O SysTick de 100 us
+ * consulta o WIP e serve de relógio. Saída na USART2 (VCP).
+ * Linkar Drivers/usart/usart_printf/usart_printf.c e
+ * Drivers/spi_flash/spi_flash.c. APAGA o último bloco de 64 KB.
+ */
+#include "usart_printf.h"
+#include "spi_flash.h"
+#include "systick.h"
+
+#define HCLK   48000000UL
+
+static usart_drv_t U2;
+static uint8_t u_rx[16], u_tx[512];
+static spi_drv_t   SPIx;
+static spi_flash_t FL;
+static uint8_t buf[4096];
+static volatile uint32_t g_ticks;
+static volatile uint8_t  g_done, g_ok;
+
+static void cs_low(void) { gpio_write_pin(GPIOC, 4, 0); }
+static void cs_high(void){ gpio_write_pin(GPIOC, 4, 1); }
+static void on_tick(void){ g_ticks++; spi_flash_tick(&FL); }
+static void on_op(bool ok, void *ctx){ (void)ctx; g_ok = ok; g_done = 1; }
+
+/* espera o callback; tempo em unidades de 100 us (0 se falhou) */
+static uint32_t run(bool started)
+{
+    uint32_t t0 = g_ticks;
+    if (!started) return 0;
+    while (!g_done) { __asm volatile ("wfi"); }
+    g_done = 0;
+    return g_ok ? (g_ticks - t0) | 1u : 0u;
+}
+
+static void show(const char *what, uint32_t bytes, uint32_t t)
+{
+    if (!t) { uprintf("  %-8s falhou\r\n", what); return; }
+    uprintf("  %-8s %6lu bytes em %5lu.%lu ms: %5lu KB/s\r\n", what, (unsigned long)bytes,
+            (unsigned long)(t / 10u), (unsigned long)(t % 10u),
+            (unsigned long)((bytes * 10000ull / t) / 1024u));
+}
+
+int main(void)
+{
+    rcc_reset_to_hsi();
+    rcc_set_sysclk_from_hsi(HCLK, RCC_AHB_DIV1, RCC_APB_DIV1);
+    dma_router_init(2);
+
+    gpio_pin_init(GPIOA, 2, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_UP);
+    gpio_pin_set_altfunc(GPIOA, 2, GPIO_AF1);                 /* USART2_TX */
+    usart_drv_config_t ucfg = {
+        .baud = 115200, .wordlen = UDRV_WORDLEN_8B, .parity = UDRV_PARITY_NONE,
+        .stopbits = UDRV_STOPBITS_1, .oversample8 = 0,
+        .rx_engine = UDRV_ENGINE_IRQ, .tx_engine = UDRV_ENGINE_DMA, .nvic_prio_usart = 3
+    };
+    usart_init(&U2, USART2, HCLK, &ucfg, u_rx, sizeof u_rx, u_tx, sizeof u_tx);
+    uprintf_init(&U2, UPRINTF_BLOCK);
+
+    /* Pinos SPI1 (AF0) e CS em PC4 */
+    gpio_pin_init(GPIOA,5, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_NONE); gpio_pin_set_altfunc(GPIOA,5, GPIO_AF0);
+    gpio_pin_init(GPIOA,6, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_UP  ); gpio_pin_set_altfunc(GPIOA,6, GPIO_AF0);
+    gpio_pin_init(GPIOA,7, GPIO_MODE_ALT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_NONE); gpio_pin_set_altfunc(GPIOA,7, GPIO_AF0);
+    gpio_pin_init(GPIOC,4, GPIO_MODE_OUTPUT, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_NONE);
+    cs_high();
+
+    /* AUTO: WREN/RDSR por polling, cabeçalhos por IRQ, páginas e leituras por DMA */
+    spi_drv_config_t cfg = {
+        .mode=SPI_MODE0, .baud_div=SPI_BR_DIV2, .bit_order=SPI_MSB_FIRST, .datasize=SPI_DS_8BIT,
+        .nss_mode=SPI_NSS_SOFT,
+        .tx_engine=SPI_ENGINE_AUTO, .rx_engine=SPI_ENGINE_AUTO,
+        .nvic_prio_spi=1,
+        .cs_assert=cs_low, .cs_release=cs_high
+    };
+    spi_init(&SPIx, SPI1, &cfg);
+    spi_calibrate(&SPIx, NULL);
+
+    /* tick abaixo do SPI/DMA */
+    systick_init_us(HCLK, 100u, true, true, 2);
+    systick_set_callback(on_tick);
+
+    if (!run(spi_flash_probe_async(&FL, &SPIx, on_op, NULL))) { uprintf("\r\nflash nao encontrada\r\n"); for (;;) {} }
+    uprintf("\r\nJEDEC %02X %02X %02X, %lu KB, pagina %u, %u bytes de endereco (%s)\r\n",
+            FL.jedec[0], FL.jedec[1], FL.jedec[2], (unsigned long)(FL.size >> 10), FL.page,
+            FL.addr_bytes, FL.sfdp ? "SFDP" : "so JEDEC");
+    for (uint32_t i = 0; i < FL.n_erase; i++)
+        uprintf("  erase %5lu KB: op %02X\r\n", (unsigned long)(FL.erase[i].size >> 10), FL.erase[i].op);
+
+    const uint32_t base = FL.size - 65536u;
+    for (uint32_t i = 0; i < sizeof buf; i++) buf[i] = (uint8_t)(i * 7u + (i >> 8));
+
+    show("erase", 65536u, run(spi_flash_erase_async(&FL, base, 65536u, on_op, NULL)));
+
+    uint32_t t = 0;
+    for (uint32_t a = 0; a < 65536u; a += sizeof buf) {
+        uint32_t d = run(spi_flash_program_async(&FL, base + a, buf, sizeof buf, on_op, NULL));
+        if (!d) { t = 0; break; }
+        t += d;
+    }
+    show("program", 65536u, t);
+
+    t = 0;
+    bool same = true;
+    for (uint32_t a = 0; a < 65536u; a += sizeof buf) {
+        uint32_t d = run(spi_flash_read_async(&FL, base + a, buf, sizeof buf, on_op, NULL));
+        if (!d) { t = 0; break; }
+        t += d;
+        for (uint32_t i = 0; i < sizeof buf; i++) same &= (buf[i] == (uint8_t)(i * 7u + (i >> 8)));
+    }
+    show("read", 65536u, t);
+    uprintf("  conferencia: %s, %lu paginas, %lu consultas de WIP\r\n", same ? "ok" : "ERRO",
+            (unsigned long)FL.pages, (unsigned long)FL.wip_polls);
+
+    for (;;) { __asm volatile ("wfi"); }
+}
 #endif
 
 
@@ -1284,6 +1805,756 @@ int main(void) {
 }
 #endif
 
+#ifdef __EXEMPLO_ADC_DMA_STREAM
+/* Streaming contínuo de IN0 (trigger TIM/externo ou contínuo) em ping-pong:
+   512 amostras por metade; o loop principal processa uma metade enquanto o DMA enche a outra. */
+#define ADC_RING_LEN 1024
+static uint16_t g_ring[ADC_RING_LEN];
+static dma_stream_t g_adc_stream;
+static volatile uint32_t g_acc = 0;
+
+int main(void) {
+    gpio_pin_init(GPIOA, 0, GPIO_MODE_ANALOG, GPIO_OTYPE_PUSHPULL, GPIO_SPEED_HIGH, GPIO_PUPD_NONE);
+
+	adc_bm_config_t cfg = adc_bm_default();
+	cfg.dma_enable = true;
+	cfg.dma_circular = true;
+	adc_bm_init(&cfg);
+	ADC1->CFGR1 |= ADC_CFGR1_CONT;   /* conversão contínua */
+
+	adc_bm_set_channels_mask(ADC_CHSELR_CH(0));
+
+	/* cb = NULL → consumo pelo loop com dma_stream_get() */
+	(void) adc_bm_dma_start_stream(&g_adc_stream, g_ring, ADC_RING_LEN, /*prio*/2, NULL, NULL);
+
+	while (1) {
+		void *data; uint16_t n;
+		int8_t half = dma_stream_get(&g_adc_stream, &data, &n);
+		if (half < 0) continue;
+
+		const uint16_t *s = (const uint16_t*) data;
+		uint32_t acc = 0;
+		for (uint16_t i = 0; i < n; i++) acc += s[i];
+		g_acc = acc;                                  /* média = g_acc / n */
+
+		dma_stream_release(&g_adc_stream, (uint8_t) half);
+		/* g_adc_stream.overruns / dropped mostram se o loop está atrasando */
+	}
+}
+#endif
+
+#ifdef __EXEMPLO_DMA_MEMCPY
+/* Cópia/preenchimento de blocos grandes em segundo plano (MEM2MEM) enquanto a CPU segue no loop */
+static uint32_t g_src[256];
+static uint32_t g_dst[256];
+static volatile uint32_t g_done = 0;
+
+static void on_copy_done(void *ctx){ (void)ctx; g_done++; }
+
+int main(void) {
+	for (uint32_t i = 0; i < 256; i++) g_src[i] = i;
+
+	dma_router_init(/*prio NVIC*/2);
+	(void) dma_mem_init(/*ch livre*/0, /*prio*/0);
+
+	(void) dma_memset_async(g_dst, 0x00, sizeof(g_dst), NULL, NULL);
+	(void) dma_memcpy_async(g_dst, g_src, sizeof(g_src), on_copy_done, NULL);   /* roda depois do memset */
+
+	while (1) {
+		if (!dma_mem_busy() && g_done) {
+			/* g_dst pronto; repete deslocado de 1 byte → miolo em 8 bits */
+			g_done = 0;
+			(void) dma_memcpy_async((uint8_t*)g_dst + 1, g_src, sizeof(g_src) - 1, on_copy_done, NULL);
+		}
+	}
+}
+#endif
+
+#ifdef __EXEMPLO_SIM_USART_DMA
+/* Build no host (sem placa), sobre o modelo de periféricos de Drivers/sim:
+     gcc -DHOST_SIM -D__EXEMPLO_SIM_USART_DMA -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast \
+         $(find Drivers -type d | sed 's/^/-I/') Src/main.c Drivers/sim/sim_periph.c \
+         Drivers/dma/dma_router.c Drivers/usart/usart_irq_dma/usart_irq_dma.c -o sim_usart
+   USART1 TX e RX por DMA com o TX ligado de volta no RX (loopback); confere os
+   dados recebidos e mede o throughput em ciclos simulados (48 MHz). */
+#include <stdio.h>
+#include "sim_periph.h"
+
+#define SIM_RX_SZ   256
+#define SIM_TX_SZ   1024
+#define SIM_TOTAL   8192u
+
+static usart_drv_t U1;
+static uint8_t  g_rx_dma[SIM_RX_SZ];
+static uint8_t  g_tx_ring[SIM_TX_SZ];
+static uint32_t g_rx_count = 0, g_rx_bad = 0;
+
+static void on_rx_chunk(const uint8_t *data, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++, g_rx_count++)
+        if (data[i] != (uint8_t)g_rx_count) g_rx_bad++;
+}
+
+static void loopback(USART_TypeDef *inst, uint16_t d, void *ctx)
+{
+    (void)ctx;
+    uint8_t b = (uint8_t)d;
+    sim_uart_inject(inst, &b, 1);
+}
+
+int main(void)
+{
+    sim_reset();
+    sim_uart_set_tx_sink(USART1, loopback, NULL);
+
+    dma_router_init(2);
+    usart_drv_config_t cfg = {
+        .baud = 3000000, .wordlen = UDRV_WORDLEN_8B, .parity = UDRV_PARITY_NONE,
+        .stopbits = UDRV_STOPBITS_1, .oversample8 = 0,
+        .rx_engine = UDRV_ENGINE_DMA, .tx_engine = UDRV_ENGINE_DMA, .nvic_prio_usart = 2
+    };
+    usart_init(&U1, USART1, 48000000UL, &cfg, g_rx_dma, SIM_RX_SZ, g_tx_ring, SIM_TX_SZ);
+    usart_set_callbacks(&U1, on_rx_chunk, NULL, NULL);
+
+    uint8_t blk[200];
+    uint32_t sent = 0;
+    while (g_rx_count < SIM_TOTAL && sim_cycles() < 100000000ull) {
+        /* RX por DMA só entrega no IDLE: manda um bloco e espera ele voltar
+           (bloco < buffer RX, senão o DMA circular dá a volta antes do IDLE) */
+        if (g_rx_count == sent && sent < SIM_TOTAL) {
+            uint32_t n = SIM_TOTAL - sent;
+            if (n > sizeof(blk)) n = sizeof(blk);
+            for (uint32_t i = 0; i < n; i++) blk[i] = (uint8_t)(sent + i);
+            usart_write(&U1, blk, n);
+            sent += n;
+        }
+        sim_step(256);
+    }
+
+    uint64_t cyc = sim_cycles();
+    printf("rx %lu/%u bytes, %lu errados, %llu ciclos, %.1f kB/s, DMA beats tx=%lu rx=%lu\n",
+           (unsigned long)g_rx_count, SIM_TOTAL, (unsigned long)g_rx_bad,
+           (unsigned long long)cyc, g_rx_count * 48000.0 / (double)cyc,
+           (unsigned long)sim_dma_stats(U1.tx_ch_idx)->beats,
+           (unsigned long)sim_dma_stats(U1.rx_ch_idx)->beats);
+    return (g_rx_count == SIM_TOTAL && !g_rx_bad) ? 0 : 1;
+}
+#endif
+
+#ifdef __EXEMPLO_SIM_FRAME
+/* Build no host, sobre Drivers/sim (RX e TX por DMA, USART1 em loopback):
+     gcc -O2 -DHOST_SIM -D__EXEMPLO_SIM_FRAME -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast \
+         $(find Drivers -type d | sed 's/^/-I/') Src/main.c Drivers/sim/sim_periph.c \
+         Drivers/dma/dma_router.c Drivers/usart/usart_irq_dma/usart_irq_dma.c \
+         Drivers/usart/usart_frame/usart_frame.c Drivers/crc/crc.c -o sim_frame
+   1) ida e volta de pacotes COBS+CRC-32 e SLIP+CRC-16 pela USART simulada;
+   2) vazão do decodificador (uframe_feed, CRC incluso) em bytes por ciclo do host. */
+#include <stdio.h>
+#include <time.h>
+#include "sim_periph.h"
+#include "usart_frame.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HOST_CYCLES() __rdtsc()
+#else
+#define HOST_CYCLES() 0ull
+#endif
+
+#define SIM_PKTS     200u
+#define SIM_PKT_MAX  300u
+
+static usart_drv_t U1;
+static uframe_t    F;
+static uint8_t g_rx_dma[512], g_tx_ring[256];
+static uint8_t g_pkt[SIM_PKT_MAX + 4], g_tx_pool[4][SIM_PKT_MAX * 2 + 16];
+static uint8_t g_stream[1u << 20];
+static uint32_t g_got = 0, g_bad = 0;
+
+/* pacote i: tamanho e conteúdo deriváveis de i (zeros e bytes de controle SLIP inclusos) */
+static uint32_t make_pkt(uint32_t i, uint8_t *out)
+{
+    uint32_t n = 1u + (i * 37u) % SIM_PKT_MAX;
+    for (uint32_t k = 0; k < n; k++) out[k] = (uint8_t)((k * 7u + i) % 5u == 0u ? 0xC0u : (k + i) & 0xFFu);
+    return n;
+}
+
+static void on_packet(const uint8_t *pkt, uint32_t len, void *ctx)
+{
+    uint8_t exp[SIM_PKT_MAX];
+    uint32_t n = make_pkt(*(uint32_t*)ctx, exp);
+    if (len != n || memcmp(pkt, exp, n)) g_bad++;
+    g_got++; (*(uint32_t*)ctx)++;
+}
+
+static void on_rx_chunk(const uint8_t *data, uint32_t len) { uframe_feed(&F, data, len); }
+
+static void loopback(USART_TypeDef *inst, uint16_t d, void *ctx)
+{
+    (void)ctx;
+    uint8_t b = (uint8_t)d;
+    sim_uart_inject(inst, &b, 1);
+}
+
+static int run(uframe_enc_t enc, uframe_crc_t crc, const char *name)
+{
+    uint32_t next = 0;
+    uframe_config_t fc = { .enc = enc, .crc = crc, .on_packet = on_packet, .ctx = &next };
+
+    sim_reset();
+    sim_uart_set_tx_sink(USART1, loopback, NULL);
+    dma_router_init(2);
+    usart_drv_config_t cfg = {
+        .baud = 3000000, .wordlen = UDRV_WORDLEN_8B, .parity = UDRV_PARITY_NONE,
+        .stopbits = UDRV_STOPBITS_1, .rx_engine = UDRV_ENGINE_DMA, .tx_engine = UDRV_ENGINE_DMA,
+        .nvic_prio_usart = 2,
+        .rx_frame = UDRV_FRAME_IDLE | UDRV_FRAME_CHAR, .match_char = (enc == UFRAME_COBS) ? 0x00 : 0xC0
+    };
+    usart_init(&U1, USART1, 48000000UL, &cfg, g_rx_dma, sizeof g_rx_dma, g_tx_ring, sizeof g_tx_ring);
+    usart_set_callbacks(&U1, on_rx_chunk, NULL, NULL);
+    uframe_init(&F, &U1, &fc, g_pkt, sizeof g_pkt, &g_tx_pool[0][0], sizeof g_tx_pool[0], 4);
+
+    /* 1) ida e volta */
+    g_got = g_bad = 0;
+    uint32_t sent = 0;
+    while (g_got < SIM_PKTS && sim_cycles() < 200000000ull) {
+        if (sent < SIM_PKTS) {
+            uint8_t p[SIM_PKT_MAX];
+            uint32_t n = make_pkt(sent, p);
+            if (uframe_send(&F, p, n)) sent++;
+        }
+        sim_step(512);
+    }
+    printf("%s: %lu/%u pacotes, %lu errados, crc_err %lu, bad %lu, %llu ciclos\n", name,
+           (unsigned long)g_got, SIM_PKTS, (unsigned long)g_bad, (unsigned long)F.rx_crc_err,
+           (unsigned long)F.rx_bad, (unsigned long long)sim_cycles());
+    int ok = (g_got == SIM_PKTS && !g_bad);
+
+    /* 2) vazão do decodificador: fluxo codificado grande, alimentado em fatias de 64 bytes */
+    uint32_t len = 0, npk = 0;
+    for (uint32_t i = 0; ; i++) {
+        uint8_t p[SIM_PKT_MAX];
+        uint32_t n = make_pkt(i, p);
+        if (len + uframe_encoded_max(&F, n) > sizeof g_stream) break;
+        len += uframe_encode(&F, p, n, &g_stream[len], sizeof g_stream - len);
+        npk++;
+    }
+    next = 0; g_got = g_bad = 0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t c0 = HOST_CYCLES();
+    for (uint32_t o = 0; o < len; o += 64u) uframe_feed(&F, &g_stream[o], (len - o < 64u) ? len - o : 64u);
+    uint64_t c1 = HOST_CYCLES();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    printf("%s: decode %lu bytes (%lu pacotes, %lu ok) %.1f MB/s, %.3f bytes/ciclo do host\n", name,
+           (unsigned long)len, (unsigned long)npk, (unsigned long)(g_got - g_bad),
+           len / ns * 1e3, (c1 > c0) ? (double)len / (double)(c1 - c0) : 0.0);
+    return ok && g_got == npk && !g_bad;
+}
+
+int main(void)
+{
+    int ok = run(UFRAME_COBS, UFRAME_CRC32, "COBS+CRC32");
+    ok &= run(UFRAME_SLIP, UFRAME_CRC16, "SLIP+CRC16");
+    return ok ? 0 : 1;
+}
+#endif
+
+#ifdef __EXEMPLO_SIM_MODBUS
+/* Build no host, sobre Drivers/sim (mestre simulado na linha da USART1):
+     gcc -O2 -DHOST_SIM -D__EXEMPLO_SIM_MODBUS -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast \
+         $(find Drivers -type d | sed 's/^/-I/') Src/main.c Drivers/sim/sim_periph.c \
+         Drivers/dma/dma_router.c Drivers/usart/usart_irq_dma/usart_irq_dma.c \
+         Drivers/modbus/modbus_rtu.c Drivers/crc/crc.c -o sim_modbus
+   Escravo 0x11 a 115200 8N1 com RS-485: requisições válidas, exceções, CRC
+   errado, outro endereço e broadcast. Mede a virada: do RTOF (t3,5) ao início
+   do primeiro start bit da resposta, comparada ao tempo de 1 caractere. No
+   modelo o código roda em tempo zero: só entram os atrasos de USART/DMA; no
+   alvo soma-se o tratamento na ISR (CRC por tabela + montagem, poucas
+   centenas de ciclos para leituras curtas). */
+#include <stdio.h>
+#include "sim_periph.h"
+#include "modbus_rtu.h"
+
+#define SLAVE    0x11u
+#define BAUD     115200u
+
+static mb_slave_t MB;
+static uint16_t g_hr[16];
+static uint16_t g_ir[4] = { 100, 101, 102, 103 };
+static uint8_t  g_coils[4];
+static uint8_t  g_di[1] = { 0xA5 };
+static uint32_t g_ir_reads = 0, g_hr_writes = 0;
+
+static uint8_t ir_refresh(uint16_t addr, uint16_t count, void *ctx)
+{
+    (void)addr; (void)count; (void)ctx;
+    g_ir[0]++; g_ir_reads++;
+    return 0;
+}
+
+static uint8_t hr_written(uint16_t addr, uint16_t count, void *ctx)
+{
+    (void)ctx;
+    g_hr_writes++;
+    if (addr <= 15u && addr + count > 15u && g_hr[15] > 1000u) { g_hr[15] = 0; return MB_EX_ILLEGAL_VALUE; }
+    return 0;
+}
+
+static const mb_table_t s_tables[] = {
+    { MB_HOLDING_REGS,    0,  16, g_hr,    NULL,       hr_written, NULL },
+    { MB_INPUT_REGS,      100, 4, g_ir,    ir_refresh, NULL,       NULL },
+    { MB_COILS,           0,  32, g_coils, NULL,       NULL,       NULL },
+    { MB_DISCRETE_INPUTS, 0,   8, g_di,    NULL,       NULL,       NULL },
+};
+
+/* resposta capturada na linha */
+static uint8_t  g_rsp[MB_ADU_MAX];
+static uint32_t g_rsp_len = 0;
+static uint64_t g_rsp_t0 = 0;        /* fim do 1º caractere da resposta */
+
+static void line_sink(USART_TypeDef *inst, uint16_t d, void *ctx)
+{
+    (void)inst; (void)ctx;
+    if (!g_rsp_len) g_rsp_t0 = sim_cycles();
+    if (g_rsp_len < sizeof g_rsp) g_rsp[g_rsp_len++] = (uint8_t)d;
+}
+
+static uint32_t g_frame_cyc, g_rto_cyc, g_deat_cyc;
+static uint64_t g_turn_max = 0;
+
+/* envia um ADU (CRC anexado se crc_ok) e espera a resposta ou o silêncio */
+static uint32_t transact(const uint8_t *pdu, uint32_t n, bool crc_ok)
+{
+    uint8_t adu[MB_ADU_MAX];
+    memcpy(adu, pdu, n);
+    uint16_t crc = crc16_modbus(0xFFFFu, adu, n);
+    if (!crc_ok) crc ^= 0x5555u;
+    adu[n] = (uint8_t)crc; adu[n + 1] = (uint8_t)(crc >> 8);
+    n += 2u;
+
+    g_rsp_len = 0;
+    uint64_t t0 = sim_cycles();
+    sim_uart_inject(USART1, adu, n);
+    uint64_t t_rto = t0 + (uint64_t)n * g_frame_cyc + g_rto_cyc;
+
+    /* espera: resposta completa (linha livre) ou 20 caracteres de silêncio após o t3,5 */
+    while (sim_cycles() < t_rto + 20u * g_frame_cyc || g_rsp_len) {
+        uint32_t before = g_rsp_len;
+        sim_step(g_frame_cyc);
+        if (g_rsp_len && g_rsp_len == before && !sim_uart_de(USART1)) break;
+    }
+    if (g_rsp_len) {
+        uint64_t start = g_rsp_t0 - g_frame_cyc - g_deat_cyc;
+        uint64_t turn = (start > t_rto) ? start - t_rto : 0u;
+        if (turn > g_turn_max) g_turn_max = turn;
+    }
+    return g_rsp_len;
+}
+
+static int check(const char *what, bool cond)
+{
+    printf("%-34s %s\n", what, cond ? "ok" : "FALHOU");
+    return cond ? 1 : 0;
+}
+
+static bool rsp_crc_ok(void)
+{
+    return g_rsp_len >= 4u && crc16_modbus(0xFFFFu, g_rsp, g_rsp_len) == 0u;
+}
+
+int main(void)
+{
+    sim_reset();
+    sim_uart_set_tx_sink(USART1, line_sink, NULL);
+    dma_router_init(2);
+
+    usart_drv_config_t ucfg = {
+        .baud = BAUD, .wordlen = UDRV_WORDLEN_8B, .parity = UDRV_PARITY_NONE,
+        .stopbits = UDRV_STOPBITS_1, .nvic_prio_usart = 1,
+        .rs485 = 1, .de_assert = 8, .de_deassert = 8
+    };
+    mb_config_t cfg = { .addr = SLAVE, .tables = s_tables, .n_tables = 4 };
+    if (!modbus_init(&MB, USART1, 48000000UL, &ucfg, &cfg)) { printf("init falhou\n"); return 1; }
+
+    uint32_t bit = (48000000UL + BAUD / 2u) / BAUD;
+    g_frame_cyc = 10u * bit;
+    g_rto_cyc   = USART1->RTOR * bit;
+    g_deat_cyc  = (8u * bit) / 16u;
+    for (int i = 0; i < 16; i++) g_hr[i] = (uint16_t)(0x0100u + i);
+
+    int ok = 1;
+    { /* 03: lê 10 holding */
+        const uint8_t q[] = { SLAVE, 0x03, 0x00, 0x02, 0x00, 0x0A };
+        uint32_t n = transact(q, sizeof q, true);
+        ok &= check("03 read holding", n == 25u && rsp_crc_ok() && g_rsp[2] == 20u &&
+                    g_rsp[3] == 0x01 && g_rsp[4] == 0x02 && g_rsp[21] == 0x01 && g_rsp[22] == 0x0B);
+    }
+    { /* 06: escreve 1 */
+        const uint8_t q[] = { SLAVE, 0x06, 0x00, 0x05, 0x12, 0x34 };
+        uint32_t n = transact(q, sizeof q, true);
+        ok &= check("06 write single", n == 8u && rsp_crc_ok() && !memcmp(g_rsp, q, 6) && g_hr[5] == 0x1234u);
+    }
+    { /* 16: escreve 3 */
+        const uint8_t q[] = { SLAVE, 0x10, 0x00, 0x08, 0x00, 0x03, 0x06, 0xAA, 0x01, 0xBB, 0x02, 0xCC, 0x03 };
+        uint32_t n = transact(q, sizeof q, true);
+        ok &= check("16 write multiple", n == 8u && rsp_crc_ok() && g_hr[8] == 0xAA01u && g_hr[10] == 0xCC03u);
+    }
+    { /* 16 rejeitado pelo on_write */
+        const uint8_t q[] = { SLAVE, 0x10, 0x00, 0x0F, 0x00, 0x01, 0x02, 0x27, 0x10 };
+        uint32_t n = transact(q, sizeof q, true);
+        ok &= check("16 rejeitado (exceção 03)", n == 5u && rsp_crc_ok() && g_rsp[1] == 0x90 && g_rsp[2] == 0x03 && g_hr[15] == 0u);
+    }
+    { /* 05 + 15 + 01 (desalinhado) */
+        const uint8_t a[] = { SLAVE, 0x05, 0x00, 0x03, 0xFF, 0x00 };
+        const uint8_t b[] = { SLAVE, 0x0F, 0x00, 0x08, 0x00, 0x0A, 0x02, 0xCD, 0x01 };
+        const uint8_t c[] = { SLAVE, 0x01, 0x00, 0x03, 0x00, 0x0C };
+        transact(a, sizeof a, true);
+        transact(b, sizeof b, true);
+        uint32_t n = transact(c, sizeof c, true);
+        /* bits 3..14: b3=1, b8..b17 = 0xCD,0x01 → 1011 0011 1 */
+        ok &= check("05/15/01 coils", n == 7u && rsp_crc_ok() && g_rsp[2] == 2u &&
+                    g_rsp[3] == (uint8_t)(0x01u | (0xCDu << 5)) && g_rsp[4] == (uint8_t)((0xCDu >> 3) & 0x0Fu));
+    }
+    { /* 02 */
+        const uint8_t q[] = { SLAVE, 0x02, 0x00, 0x00, 0x00, 0x08 };
+        uint32_t n = transact(q, sizeof q, true);
+        ok &= check("02 read discrete", n == 6u && rsp_crc_ok() && g_rsp[3] == 0xA5u);
+    }
+    { /* 04 com on_read */
+        const uint8_t q[] = { SLAVE, 0x04, 0x00, 0x64, 0x00, 0x04 };
+        uint32_t n = transact(q, sizeof q, true);
+        ok &= check("04 read input (on_read)", n == 13u && rsp_crc_ok() && g_ir_reads == 1u && g_rsp[4] == 101u);
+    }
+    { /* exceções */
+        const uint8_t a[] = { SLAVE, 0x03, 0x00, 0xC8, 0x00, 0x01 };
+        const uint8_t b[] = { SLAVE, 0x2B, 0x0E, 0x01, 0x00 };
+        uint32_t n = transact(a, sizeof a, true);
+        bool e2 = n == 5u && rsp_crc_ok() && g_rsp[1] == 0x83 && g_rsp[2] == MB_EX_ILLEGAL_ADDRESS;
+        n = transact(b, sizeof b, true);
+        ok &= check("exceções 02 e 01", e2 && n == 5u && g_rsp[1] == 0xAB && g_rsp[2] == MB_EX_ILLEGAL_FUNCTION);
+    }
+    { /* silêncio: CRC errado, outro escravo, broadcast */
+        const uint8_t a[] = { SLAVE, 0x03, 0x00, 0x00, 0x00, 0x01 };
+        const uint8_t b[] = { 0x12,  0x03, 0x00, 0x00, 0x00, 0x01 };
+        const uint8_t c[] = { 0x00,  0x06, 0x00, 0x01, 0xBE, 0xEF };
+        uint32_t n1 = transact(a, sizeof a, false);
+        uint32_t n2 = transact(b, sizeof b, true);
+        uint32_t n3 = transact(c, sizeof c, true);
+        ok &= check("CRC errado/outro/broadcast mudos", !n1 && !n2 && !n3 && g_hr[1] == 0xBEEFu && MB.crc_err == 1u);
+    }
+
+    printf("frames %lu, atendidos %lu, exceções %lu, crc_err %lu, descartados %lu\n",
+           (unsigned long)MB.frames, (unsigned long)MB.handled, (unsigned long)MB.exceptions,
+           (unsigned long)MB.crc_err, (unsigned long)MB.dropped);
+    printf("virada máx: %llu ciclos (%.1f us), 1 caractere = %lu ciclos (%.1f us)\n",
+           (unsigned long long)g_turn_max, g_turn_max / 48.0, (unsigned long)g_frame_cyc, g_frame_cyc / 48.0);
+    ok &= check("virada < 1 caractere", g_turn_max < g_frame_cyc);
+    return ok ? 0 : 1;
+}
+#endif
+
+#ifdef __EXEMPLO_SIM_SPI
+/* Build no host, sobre Drivers/sim (escravo no SPI1 devolve o complemento):
+     gcc -O2 -DHOST_SIM -D__EXEMPLO_SIM_SPI -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast \
+         $(find Drivers -type d | sed 's/^/-I/') Src/main.c Drivers/sim/sim_periph.c \
+         Drivers/dma/dma_router.c Drivers/spi/spi_irq_dma/spi_irq_dma.c -o sim_spi
+   Engines IRQ, POLL, DMA e AUTO em 8 e 16 bits, de 1 a 41 itens (contagens
+   ímpares trocam o FRXTH no fim), com o CS conferido no escravo. Para 40
+   bytes, mostra quantas vezes a ISR do SPI rodou e quantos acessos a CPU
+   fez ao DR: o IRQ move até 2 bytes por acesso e é puxado pelo RXNE (no
+   modelo, cada leitura do SR custa um quantum de CPU).
+   Com CRC (CRC-8, CRC-16 em 8 bits e em 16 bits), o escravo é um dispositivo
+   que confere o CRC do mestre e manda o seu depois dos dados; um CRC
+   corrompido de propósito tem que dar CRCERR só naquela transação. */
+#include <stdio.h>
+#include "sim_periph.h"
+
+static spi_drv_t SPIx;
+static volatile int g_done, g_errs;
+static uint32_t g_err_sr;
+static int g_cs, g_cs_bad;
+
+/* escravo: ~MOSI nos n itens de dados; com CRC, depois deles o CRC do que
+   enviou (byte alto primeiro), conferindo o CRC que chega do mestre */
+static struct {
+    uint32_t n, k;
+    uint8_t  bits, crc_bits;
+    uint16_t poly, crc_in, crc_out, got;
+    int      bad_master, corrupt;
+} g_dev;
+
+static uint16_t dev_crc(uint16_t crc, uint16_t v)
+{
+    uint16_t top = (uint16_t)(1u << (g_dev.crc_bits - 1u));
+    for (uint32_t b = g_dev.bits; b--; ) {
+        bool x = (((v >> b) & 1u) != 0u) ^ ((crc & top) != 0u);
+        crc = (uint16_t)(crc << 1);
+        if (x) crc ^= g_dev.poly;
+    }
+    return (g_dev.crc_bits == 8u) ? (uint16_t)(crc & 0xFFu) : crc;
+}
+
+static void cs_low(void)  { g_cs = 1; g_dev.k = 0; g_dev.crc_in = g_dev.crc_out = g_dev.got = 0; }
+static void cs_high(void) { g_cs = 0; }
+static void on_done(void) { g_done = 1; }
+static void on_err(uint32_t sr, uint32_t f) { (void)f; g_err_sr = sr; g_errs++; }
+
+static uint16_t slave_dev(SPI_TypeDef *inst, uint16_t mosi, void *ctx)
+{
+    (void)inst; (void)ctx;
+    if (!g_cs) g_cs_bad++;
+    uint16_t mask = (uint16_t)((1u << g_dev.bits) - 1u);
+    uint32_t k = g_dev.k++;
+    if (!g_dev.crc_bits || k < g_dev.n) {
+        uint16_t miso = (uint16_t)~mosi & mask;
+        if (g_dev.crc_bits) { g_dev.crc_in = dev_crc(g_dev.crc_in, mosi); g_dev.crc_out = dev_crc(g_dev.crc_out, miso); }
+        return miso;
+    }
+    uint32_t j = k - g_dev.n, frames = g_dev.crc_bits / g_dev.bits;
+    g_dev.got = (uint16_t)((g_dev.got << g_dev.bits) | mosi);
+    if (j + 1u == frames && g_dev.got != g_dev.crc_in) g_dev.bad_master++;
+    uint16_t c = (uint16_t)(g_dev.crc_out >> (g_dev.bits * (frames - 1u - j))) & mask;
+    return g_dev.corrupt ? (uint16_t)(c ^ 1u) : c;
+}
+
+static void setup_crc(spi_engine_t e, spi_datasize_t ds, uint8_t crc_bits, uint16_t poly)
+{
+    sim_reset();
+    dma_router_init(2);
+    sim_spi_set_slave(SPI1, slave_dev, NULL);
+    memset(&g_dev, 0, sizeof g_dev);
+    g_dev.bits = (uint8_t)ds; g_dev.crc_bits = crc_bits; g_dev.poly = poly;
+    g_errs = 0;
+    spi_drv_config_t cfg = {
+        .mode = SPI_MODE0, .baud_div = SPI_BR_DIV2, .bit_order = SPI_MSB_FIRST, .datasize = ds,
+        .nss_mode = SPI_NSS_SOFT, .tx_engine = e, .rx_engine = e, .nvic_prio_spi = 1,
+        .crc = crc_bits != 0u, .crc_16bit = crc_bits == 16u, .crc_poly = poly,
+        .cs_assert = cs_low, .cs_release = cs_high
+    };
+    spi_init(&SPIx, SPI1, &cfg);
+    spi_set_callbacks(&SPIx, on_done, on_err);
+}
+
+static void setup(spi_engine_t e, spi_datasize_t ds) { setup_crc(e, ds, 0u, 0u); }
+
+/* item i recebido == complemento do enviado (em 8 ou 16 bits) */
+static bool rx_is_not_tx(const uint16_t *tx, const uint16_t *rx, uint32_t i, bool w)
+{
+    if (w) return (uint32_t)rx[i] == (~(uint32_t)tx[i] & 0xFFFFu);
+    return (uint32_t)((const uint8_t*)rx)[i] == (~(uint32_t)((const uint8_t*)tx)[i] & 0xFFu);
+}
+
+/* uma transação de n itens, até o callback (POLL já volta com ele) */
+static bool xfer(const void *tx, void *rx, uint32_t n)
+{
+    uint64_t t0 = sim_cycles();
+    g_done = 0;
+    if (!spi_transfer_async(&SPIx, tx, rx, n)) return false;
+    while (!g_done && sim_cycles() - t0 < 1000000u) sim_step(16);
+    return g_done != 0;
+}
+
+int main(void)
+{
+    static const spi_engine_t eng[] = { SPI_ENGINE_IRQ, SPI_ENGINE_POLL, SPI_ENGINE_DMA, SPI_ENGINE_AUTO };
+    static const char *const name[] = { "IRQ", "POLL", "DMA", "AUTO" };
+    static uint16_t tx[64], rx[64];
+    static const struct { spi_datasize_t ds; uint8_t crc_bits; uint16_t poly; } crcs[] = {
+        { SPI_DS_8BIT, 8u, 0x07u }, { SPI_DS_8BIT, 16u, 0x1021u }, { SPI_DS_16BIT, 16u, 0x8005u }
+    };
+    int ok = 1;
+
+    for (uint32_t i = 0; i < 64u; i++) tx[i] = (uint16_t)(i * 0x3B1u + 7u);
+
+    for (int k = 0; k < 4; k++) {
+        for (int w = 0; w < 2; w++) {
+            spi_datasize_t ds = w ? SPI_DS_16BIT : SPI_DS_8BIT;
+            setup(eng[k], ds);
+            bool good = true;
+            for (uint32_t n = 1; n <= 41u && good; n++) {
+                memset(rx, 0xEE, sizeof rx);
+                good = xfer(tx, rx, n);
+                for (uint32_t i = 0; i < n && good; i++) good = rx_is_not_tx(tx, rx, i, w);
+                good = good && ((uint8_t*)rx)[w ? 2u * n : n] == 0xEEu && !SPIx.busy;
+            }
+            const sim_spi_stats_t *st = sim_spi_stats(SPI1);
+            good = good && !g_errs && !g_cs_bad && !g_cs && !st->tx_dropped;
+            printf("%-4s %2d bits, 1..41 itens: %s\n", name[k], w ? 16 : 8, good ? "ok" : "FALHOU");
+            ok &= good;
+        }
+    }
+
+    for (int k = 0; k < 3; k++) {
+        for (int c = 0; c < 3; c++) {
+            bool w = crcs[c].ds == SPI_DS_16BIT;
+            setup_crc(eng[k], crcs[c].ds, crcs[c].crc_bits, crcs[c].poly);
+            bool good = true;
+            for (uint32_t n = 1; n <= 41u && good; n++) {
+                memset(rx, 0xEE, sizeof rx);
+                g_dev.n = n;
+                good = xfer(tx, rx, n) && !SPIx.crc_fail;
+                for (uint32_t i = 0; i < n && good; i++) good = rx_is_not_tx(tx, rx, i, w);
+            }
+            good = good && !g_errs && !g_dev.bad_master && !g_cs_bad;
+
+            /* CRC do escravo corrompido: CRCERR nesta, limpo na seguinte */
+            g_dev.n = 8u; g_dev.corrupt = 1;
+            bool bad = xfer(tx, rx, 8u) && SPIx.crc_fail && g_errs == 1 && (g_err_sr & (1u << 4));
+            g_dev.corrupt = 0;
+            bad = bad && xfer(tx, rx, 8u) && !SPIx.crc_fail && g_errs == 1 && SPIx.crc_errors == 1u;
+
+            printf("%-4s %2d bits, CRC-%-2u: %s, CRCERR forçado: %s\n", name[k], w ? 16 : 8,
+                   crcs[c].crc_bits, good ? "ok" : "FALHOU", bad ? "ok" : "FALHOU");
+            ok &= good && bad;
+        }
+    }
+
+    printf("\n40 bytes, 8 bits, SPI a 24 MHz (13.3 us no fio):\n");
+    for (int k = 0; k < 3; k++) {
+        setup(eng[k], SPI_DS_8BIT);
+        const sim_spi_stats_t *st = sim_spi_stats(SPI1);
+        uint64_t t0 = sim_cycles();
+        ok &= xfer(tx, rx, 40u);
+        printf("  %-4s %5.1f us, %2lu IRQs do SPI, %2lu acessos da CPU ao DR\n", name[k],
+               (sim_cycles() - t0) / 48.0, (unsigned long)st->irqs,
+               (unsigned long)(st->cpu_writes + st->cpu_reads));
+    }
+    return ok ? 0 : 1;
+}
+#endif
+
+#ifdef __EXEMPLO_SIM_SPI_FLASH
+/* Build no host, sobre Drivers/sim (flash NOR simulada no SPI1):
+     gcc -O2 -DHOST_SIM -D__EXEMPLO_SIM_SPI_FLASH -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast \
+         $(find Drivers -type d | sed 's/^/-I/') Src/main.c Drivers/sim/sim_periph.c Drivers/sim/sim_nor.c \
+         Drivers/dma/dma_router.c Drivers/spi/spi_irq_dma/spi_irq_dma.c Drivers/spi_flash/spi_flash.c \
+         Drivers/systick/systick.c -o sim_flash
+   Descoberta (SFDP e só JEDEC), erase/program/read conferidos contra a
+   memória simulada, modo de 4 bytes numa flash de 32 MB, e vazão de cada
+   operação em tempo simulado (SPI a 24 MHz, WIP consultado a cada 100 us
+   pelo SysTick). No programa, o que passa do tPP de cada página é o envio
+   do PP e a espera até o próximo tick: o resto já está preparado. */
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim_nor.h"
+#include "spi_flash.h"
+#include "systick.h"
+
+#define HCLK     48000000UL
+
+static spi_drv_t   SPIx;
+static spi_flash_t FL;
+static sim_nor_t   NOR;
+static volatile int g_done, g_ok;
+
+static void cs_low(void)  { sim_nor_select(&NOR, true);  }
+static void cs_high(void) { sim_nor_select(&NOR, false); }
+static void on_tick(void) { spi_flash_tick(&FL); }
+static void on_op(bool ok, void *ctx) { (void)ctx; g_ok = ok; g_done = 1; }
+
+/* espera o callback; devolve os ciclos gastos (0 se falhou) */
+static uint64_t run(bool started)
+{
+    uint64_t t0 = sim_cycles();
+    if (!started) return 0;
+    while (!g_done && sim_cycles() - t0 < 20ull * HCLK) sim_step(64);
+    bool ok = g_done && g_ok;
+    g_done = 0;
+    return ok ? sim_cycles() - t0 : 0;
+}
+
+static int check(const char *what, bool cond)
+{
+    printf("%-34s %s\n", what, cond ? "ok" : "FALHOU");
+    return cond ? 1 : 0;
+}
+
+static double kbs(uint32_t bytes, uint64_t cyc) { return cyc ? bytes / 1024.0 / ((double)cyc / HCLK) : 0.0; }
+
+static void setup(uint8_t *mem, uint32_t size, bool sfdp)
+{
+    sim_reset();
+    dma_router_init(2);
+    sim_nor_init(&NOR, mem, size, 0xEF, 0x40);
+    NOR.sfdp_off = sfdp ? 0u : 1u;
+    sim_spi_set_slave(SPI1, sim_nor_spi, &NOR);
+
+    spi_drv_config_t cfg = {
+        .mode = SPI_MODE0, .baud_div = SPI_BR_DIV2, .bit_order = SPI_MSB_FIRST, .datasize = SPI_DS_8BIT,
+        .nss_mode = SPI_NSS_SOFT,
+        .tx_engine = SPI_ENGINE_AUTO, .rx_engine = SPI_ENGINE_AUTO,  /* RDSR/WREN por polling */
+        .nvic_prio_spi = 1,
+        .cs_assert = cs_low, .cs_release = cs_high
+    };
+    spi_init(&SPIx, SPI1, &cfg);
+    systick_init_us(HCLK, 100u, true, true, 2);
+    systick_set_callback(on_tick);
+}
+
+int main(void)
+{
+    static uint8_t mem[1u << 20], pat[12288], buf[65536];
+    for (uint32_t i = 0; i < sizeof pat; i++) pat[i] = (uint8_t)(i * 7u + (i >> 8));
+    int ok = 1;
+
+    setup(mem, sizeof mem, true);
+    ok &= check("probe (SFDP)", run(spi_flash_probe_async(&FL, &SPIx, on_op, NULL)) &&
+                FL.sfdp && FL.size == sizeof mem && FL.page == 256u && FL.addr_bytes == 3u &&
+                FL.n_erase == 3u && FL.erase[0].op == 0x20 && FL.erase[2].size == 65536u && FL.jedec[0] == 0xEF);
+
+    /* 4K + 64K + 4K: o maior tipo alinhado em cada passo */
+    memset(mem, 0x00, sizeof mem);
+    uint64_t te = run(spi_flash_erase_async(&FL, 0x0F000u, 0x11000u + 0x1000u, on_op, NULL));
+    bool ff = true;
+    for (uint32_t i = 0x0F000u; i < 0x21000u; i++) ff &= (mem[i] == 0xFFu);
+    ok &= check("erase 72K (4K+64K+4K)", te && ff && NOR.n_erase == 3u && mem[0x0EFFF] == 0u && mem[0x21000] == 0u);
+    ok &= check("erase desalinhado recusado", !spi_flash_erase_async(&FL, 0x10800u, 0x1000u, on_op, NULL));
+
+    /* 12K a partir do meio de uma página: 49 PPs */
+    uint32_t pa = 0x10080u;
+    uint64_t tp = run(spi_flash_program_async(&FL, pa, pat, sizeof pat, on_op, NULL));
+    ok &= check("program 12K desalinhado", tp && !memcmp(&mem[pa], pat, sizeof pat) &&
+                mem[pa - 1u] == 0xFFu && mem[pa + sizeof pat] == 0xFFu && FL.pages == 49u && NOR.n_ignored == 0u);
+
+    memset(buf, 0, sizeof buf);
+    ok &= check("fast read 12K", run(spi_flash_read_async(&FL, pa, buf, sizeof pat, on_op, NULL)) &&
+                !memcmp(buf, pat, sizeof pat));
+    uint64_t tr = run(spi_flash_read_async(&FL, 0x10000u, buf, sizeof buf, on_op, NULL));
+    ok &= check("fast read 64K (2 trechos)", tr && !memcmp(&buf[0x80], pat, sizeof pat));
+
+    /* por página o chip só começa após o PP inteiro: sobra transferência + latência do tick */
+    double extra_us = ((double)tp / FL.pages - SIM_NOR_T_PP) / (HCLK / 1e6);
+    double xfer_us  = (1u + 3u + 256u) * 8u / 24.0;
+    printf("erase  72K: %8.1f KB/s\n", kbs(0x12000u, te));
+    printf("program 12K: %7.1f KB/s (%lu páginas; tPP %.0f us + %.0f us por página)\n",
+           kbs(sizeof pat, tp), (unsigned long)FL.pages, SIM_NOR_T_PP / (HCLK / 1e6), extra_us);
+    printf("read   64K: %8.1f KB/s (SPI a 24 MHz = %.1f KB/s)\n", kbs(sizeof buf, tr), 24e6 / 8.0 / 1024.0);
+    ok &= check("program: sobra < PP + 1 tick", extra_us < xfer_us + 100.0);
+
+    /* sem SFDP: capacidade do JEDEC ID, 4K/64K */
+    setup(mem, sizeof mem, false);
+    ok &= check("probe (só JEDEC)", run(spi_flash_probe_async(&FL, &SPIx, on_op, NULL)) &&
+                !FL.sfdp && FL.size == sizeof mem && FL.n_erase == 2u && FL.erase[1].op == 0xD8);
+
+    /* 32 MB: SFDP pede 4 bytes → B7 */
+    uint32_t big = 32u << 20;
+    uint8_t *bmem = malloc(big);
+    if (!bmem) return 1;
+    setup(bmem, big, true);
+    bool p4 = run(spi_flash_probe_async(&FL, &SPIx, on_op, NULL)) && FL.addr_bytes == 4u && NOR.addr4;
+    uint32_t ha = big - 0x1000u;
+    p4 = p4 && run(spi_flash_erase_async(&FL, ha, 0x1000u, on_op, NULL));
+    p4 = p4 && run(spi_flash_program_async(&FL, ha + 0x10u, pat, 300u, on_op, NULL));
+    memset(buf, 0, 300u);
+    p4 = p4 && run(spi_flash_read_async(&FL, ha + 0x10u, buf, 300u, on_op, NULL));
+    ok &= check("32 MB, endereço de 4 bytes", p4 && !memcmp(buf, pat, 300u) && !memcmp(&bmem[ha + 0x10u], pat, 300u));
+    free(bmem);
+
+    return ok ? 0 : 1;
+}
+#endif
+
 #ifdef __EXEMPLO_WATCHDOG_NORMAL
 int main(void)
 {
@@ -1343,9 +2614,11 @@ int main(void)
 }
 #endif
 
+#ifndef HOST_SIM
 int main(void){
 
 }
+#endif
 
 
 
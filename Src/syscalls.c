@@ -34,6 +34,8 @@
 /* Variables */
 extern int __io_putchar(int ch) __attribute__((weak));
 extern int __io_getchar(void) __attribute__((weak));
+/* Saída em bloco (ex.: usart_printf.c, ring TX por DMA); < 0 = não atendeu, usa __io_putchar */
+extern int __io_write(const char *ptr, int len) __attribute__((weak));
 
 
 char *__env[1] = { 0 };
@@ -82,6 +84,12 @@ __attribute__((weak)) int _write(int file, char *ptr, int len)
   (void)file;
   int DataIdx;
 
+  if (__io_write)
+  {
+    int n = __io_write(ptr, len);
+    if (n >= 0) return n;
+  }
+
   for (DataIdx = 0; DataIdx < len; DataIdx++)
   {
     __io_putchar(*ptr++);
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Decodifica o log binário do Drivers/trace (TRACE()).
+
+Uso:
+    trace_decode.py firmware.elf captura.bin
+    cat /dev/ttyACM0 | trace_decode.py firmware.elf -
+
+Os formatos vêm da seção "trace_fmt" do ELF (o ID é o offset nela); strings
+de %s são lidas das seções carregadas do próprio ELF. Sem dependências além
+da biblioteca padrão.
+
+Fio (palavras little-endian): cabeçalho 0xA<<28 | nargs<<24 | seq<<16 | id,
+seguido de nargs palavras. Bytes que não formam um cabeçalho válido são
+pulados (ressincronização após captura iniciada no meio de um registro).
+"""
+
+import re
+import struct
+import sys
+
+MAGIC = 0xA
+MAX_ARGS = 8
+
+FMT_RE = re.compile(r"%([-0]*)(\*|\d+)?l*([diuxXcps%])")
+
+
+class Elf:
+    """Só o necessário: seções por nome e leitura por endereço."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        d = self.data
+        if d[:4] != b"\x7fELF":
+            raise ValueError("não é ELF: %s" % path)
+        is64 = d[4] == 2
+        if d[5] != 1:
+            raise ValueError("só ELF little-endian")
+        if is64:
+            shoff, = struct.unpack_from("<Q", d, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from("<HHH", d, 0x3A)
+            sh_fmt = "<IIQQQQIIQQ"
+        else:
+            shoff, = struct.unpack_from("<I", d, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from("<HHH", d, 0x2E)
+            sh_fmt = "<IIIIIIIIII"
+        raw = [struct.unpack_from(sh_fmt, d, shoff + i * shentsize) for i in range(shnum)]
+        strtab = raw[shstrndx]
+        self.sections = []
+        for name, typ, flags, addr, off, size, *_ in raw:
+            n = d[strtab[4] + name:].split(b"\0", 1)[0].decode()
+            self.sections.append((n, typ, flags, addr, off, size))
+
+    def section(self, name):
+        for n, typ, _flags, _addr, off, size in self.sections:
+            if n == name:
+                return b"" if typ == 8 else self.data[off:off + size]   # NOBITS
+        return None
+
+    def cstring(self, addr):
+        for _n, typ, flags, a, off, size in self.sections:
+            if (flags & 2) and typ != 8 and a <= addr < a + size:        # SHF_ALLOC
+                s = self.data[off + addr - a:off + size].split(b"\0", 1)[0]
+                return s.decode(errors="replace")
+        return "<%s 0x%08x>" % ("str?", addr)
+
+
+def format_msg(fmt, args, elf):
+    it = iter(args)
+
+    def conv(m):
+        flags, width, c = m.groups()
+        if c == "%":
+            return "%"
+        w = ""
+        if width == "*":
+            w = str(struct.unpack("<i", struct.pack("<I", next(it, 0)))[0])
+        elif width:
+            w = width
+        v = next(it, 0)
+        if c in "di":
+            v = struct.unpack("<i", struct.pack("<I", v))[0]
+            return ("%" + flags + w + "d") % v
+        if c in "uxX":
+            return ("%" + flags + w + c) % v
+        if c == "c":
+            return ("%" + flags + w + "c") % chr(v & 0xFF)
+        if c == "p":
+            return ("%" + flags + w + "s") % ("0x%x" % v)
+        return ("%" + flags + w + "s") % elf.cstring(v)
+
+    return FMT_RE.sub(conv, fmt)
+
+
+def decode(stream, elf, out):
+    fmts = elf.section("trace_fmt")
+    if fmts is None:
+        raise ValueError("ELF sem seção trace_fmt (TRACE não usado ou linker script antigo)")
+
+    buf = b""
+    last_seq = None
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            break
+        buf += chunk
+        pos = 0
+        while len(buf) - pos >= 4:
+            hdr, = struct.unpack_from("<I", buf, pos)
+            nargs = (hdr >> 24) & 0xF
+            fid = hdr & 0xFFFF
+            if (hdr >> 28) != MAGIC or nargs > MAX_ARGS or fid >= len(fmts):
+                pos += 1                                         # ressincroniza
+                continue
+            if len(buf) - pos < 4 + 4 * nargs:
+                break
+            args = struct.unpack_from("<%dI" % nargs, buf, pos + 4)
+            pos += 4 + 4 * nargs
+
+            seq = (hdr >> 16) & 0xFF
+            if last_seq is not None and seq != (last_seq + 1) & 0xFF:
+                out.write("... %d registro(s) perdido(s)\n" % ((seq - last_seq - 1) & 0xFF))
+            last_seq = seq
+
+            fmt = fmts[fid:].split(b"\0", 1)[0].decode(errors="replace")
+            out.write("[%3d] %s" % (seq, format_msg(fmt, args, elf)))
+            if not fmt.endswith("\n"):
+                out.write("\n")
+        buf = buf[pos:]
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write(__doc__)
+        return 2
+    elf = Elf(argv[1])
+    stream = sys.stdin.buffer if argv[2] == "-" else open(argv[2], "rb")
+    try:
+        decode(stream, elf, sys.stdout)
+    finally:
+        if stream is not sys.stdin.buffer:
+            stream.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))